@@ -0,0 +1,260 @@
+/*
+ * Copyright (C) 2025  JCM
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * waydroid-files is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "adb_archive_model.h"
+
+#include <QDebug>
+#include <QSet>
+#include <QtEndian>
+
+#include <sys/stat.h>
+
+#include "adb_folder_model.h"
+
+ADBArchiveModel::ADBArchiveModel() {
+    connect(this, &ADBArchiveModel::pathChanged, this, [this]() {
+        m_folder.clear();
+        emit folderChanged();
+    });
+}
+
+void ADBArchiveModel::setAdbClient(ADBClient* client) {
+    m_adbClient = client;
+    m_blocks.setClient(client);
+}
+
+void ADBArchiveModel::setFolder(const QString& folder) {
+    QString normalized = folder;
+    if(!normalized.isEmpty() && !normalized.endsWith('/')) {
+        normalized += '/';
+    }
+    if(normalized == m_folder) {
+        return;
+    }
+    m_folder = normalized;
+    emit folderChanged();
+    updateRows();
+}
+
+QHash<int, QByteArray> ADBArchiveModel::roleNames() const {
+    QHash<int, QByteArray> roles;
+    roles[Roles::FileNameRole] = "fileName";
+    roles[Roles::FilePathRole] = "filePath";
+    roles[Roles::FileSizeRole] = "fileSize";
+    roles[Roles::CompressedSizeRole] = "compressedSize";
+    roles[Roles::IsBrowsableRole] = "isBrowsable";
+    return roles;
+}
+int ADBArchiveModel::rowCount(const QModelIndex& parent) const {
+    if(parent.isValid()) {
+        return 0;
+    }
+    return static_cast<int>(m_rows.size());
+}
+QVariant ADBArchiveModel::data(const QModelIndex& index, int role) const {
+    if(!index.isValid() || index.row() < 0 || index.row() >= static_cast<int>(m_rows.size())) {
+        return {};
+    }
+
+    const Row& row = m_rows.at(static_cast<size_t>(index.row()));
+    switch(role) {
+        case Roles::FileNameRole:
+            return row.name;
+        case Roles::FilePathRole:
+            return row.path;
+        case Roles::FileSizeRole:
+            return row.isDirectory ? QString{} : ADBFolderModel::fileSize(row.size);
+        case Roles::CompressedSizeRole:
+            return row.isDirectory ? QString{} : ADBFolderModel::fileSize(row.compressedSize);
+        case Roles::IsBrowsableRole:
+            return row.isDirectory;
+        default:
+            return {};
+    }
+}
+
+void ADBArchiveModel::updateRows() {
+    beginResetModel();
+    m_rows.clear();
+
+    QSet<QString> directories{};
+    for(const ADBArchiveEntry& entry : m_entries) {
+        if(!entry.name.startsWith(m_folder) || entry.name.size() == m_folder.size()) {
+            continue;
+        }
+        QString rest = entry.name.mid(m_folder.size());
+        int slash = rest.indexOf('/');
+        if(slash >= 0) {
+            // entries are not required to exist for directories, so they are derived from the paths
+            QString name = rest.left(slash);
+            if(!directories.contains(name)) {
+                directories.insert(name);
+                m_rows.push_back(Row{name, m_folder + name, true, 0, 0});
+            }
+        } else {
+            m_rows.push_back(Row{rest, entry.name, false, entry.size, entry.compressedSize});
+        }
+    }
+    std::sort(m_rows.begin(), m_rows.end(), [](const Row& a, const Row& b) -> bool {
+        if(a.isDirectory != b.isDirectory) {
+            return a.isDirectory > b.isDirectory;
+        }
+        return a.name.toLower() < b.name.toLower();
+    });
+
+    endResetModel();
+}
+
+QCoro::Task<bool> ADBArchiveModel::co_load() {
+    if(!m_adbClient) {
+        co_return false;
+    }
+
+    auto stat = co_await m_adbClient->co_stat(m_path);
+    if(!stat || !S_ISREG(stat->mode)) {
+        co_return false;
+    }
+
+    auto entries = co_await co_readCentralDirectory(m_blocks, m_path, stat->size, stat->time);
+    if(!entries) {
+        co_return false;
+    }
+    m_entries = std::move(*entries);
+    emit entriesChanged();
+
+    updateRows();
+    co_return true;
+}
+
+// Every offset in a central directory comes from the archive itself, anything out of range reads as 0.
+template<typename T>
+static T readLittleEndian(const QByteArray& data, qint64 pos) {
+    if(pos < 0 || pos + static_cast<qint64>(sizeof(T)) > data.size()) {
+        return 0;
+    }
+    return qFromLittleEndian<T>(data.constData() + pos);
+}
+
+QCoro::Task<std::optional<std::vector<ADBArchiveEntry>>> ADBArchiveModel::co_readCentralDirectory(ADBBlockCache& cache, QString path, qint64 size, uint32_t time) {
+    auto u16 = [](const QByteArray& data, qint64 pos) { return readLittleEndian<quint16>(data, pos); };
+    auto u32 = [](const QByteArray& data, qint64 pos) { return readLittleEndian<quint32>(data, pos); };
+    auto u64 = [](const QByteArray& data, qint64 pos) { return readLittleEndian<quint64>(data, pos); };
+
+    // the end of central directory record is at the end of the file, followed only by a comment of up to 64 KiB
+    constexpr qint64 eocdSize = 22;
+    if(size < eocdSize) {
+        co_return std::nullopt;
+    }
+    qint64 tailSize = std::min<qint64>(size, eocdSize + 0xFFFF);
+    auto tail = co_await cache.co_read(path, time, size - tailSize, tailSize);
+    if(!tail || tail->size() != tailSize) {
+        co_return std::nullopt;
+    }
+
+    qint64 eocd = -1;
+    for(qint64 i = tailSize - eocdSize; i >= 0; i--) {
+        if(u32(*tail, i) == 0x06054b50) {
+            eocd = i;
+            break;
+        }
+    }
+    if(eocd < 0) {
+        qWarning() << "No end of central directory record in" << path;
+        co_return std::nullopt;
+    }
+
+    quint64 count = u16(*tail, eocd + 10);
+    quint64 directorySize = u32(*tail, eocd + 12);
+    quint64 directoryOffset = u32(*tail, eocd + 16);
+    if(count == 0xFFFF || directorySize == 0xFFFFFFFF || directoryOffset == 0xFFFFFFFF) {
+        // Zip64, the locator of the real record sits right before the classic one
+        if(eocd < 20 || u32(*tail, eocd - 20) != 0x07064b50) {
+            qWarning() << "Zip64 end of central directory locator missing in" << path;
+            co_return std::nullopt;
+        }
+        auto record = co_await cache.co_read(path, time, static_cast<qint64>(u64(*tail, eocd - 20 + 8)), 56);
+        if(!record || record->size() != 56 || u32(*record, 0) != 0x06064b50) {
+            qWarning() << "Invalid Zip64 end of central directory record in" << path;
+            co_return std::nullopt;
+        }
+        count = u64(*record, 32);
+        directorySize = u64(*record, 40);
+        directoryOffset = u64(*record, 48);
+    }
+    if(directorySize > static_cast<quint64>(size) || directoryOffset > static_cast<quint64>(size) - directorySize) {
+        qWarning() << "Central directory out of bounds in" << path;
+        co_return std::nullopt;
+    }
+
+    // an empty archive, the block cache would take a read of nothing for a failure
+    if(directorySize == 0) {
+        co_return std::vector<ADBArchiveEntry>{};
+    }
+
+    auto directory = co_await cache.co_read(path, time, directoryOffset, directorySize);
+    if(!directory || static_cast<quint64>(directory->size()) != directorySize) {
+        co_return std::nullopt;
+    }
+
+    std::vector<ADBArchiveEntry> entries;
+    // every entry takes at least 46 bytes, a count that claims more is not to be trusted
+    entries.reserve(std::min<quint64>(count, directorySize / 46));
+
+    qint64 pos = 0;
+    while(pos + 46 <= directory->size() && u32(*directory, pos) == 0x02014b50) {
+        quint16 flags = u16(*directory, pos + 8);
+        quint16 nameLength = u16(*directory, pos + 28);
+        quint16 extraLength = u16(*directory, pos + 30);
+        quint16 commentLength = u16(*directory, pos + 32);
+        if(pos + 46 + nameLength + extraLength + commentLength > directory->size()) {
+            qWarning() << "Central directory entry truncated in" << path;
+            co_return std::nullopt;
+        }
+
+        ADBArchiveEntry entry;
+        QByteArray name = directory->mid(pos + 46, nameLength);
+        entry.name = (flags & (1 << 11)) ? QString::fromUtf8(name) : QString::fromLatin1(name);
+        entry.method = u16(*directory, pos + 10);
+        entry.compressedSize = u32(*directory, pos + 20);
+        entry.size = u32(*directory, pos + 24);
+        entry.localHeaderOffset = u32(*directory, pos + 42);
+
+        // Zip64 extended information only contains the fields that overflowed, in this order
+        qint64 extra = pos + 46 + nameLength;
+        qint64 extraEnd = extra + extraLength;
+        while(extra + 4 <= extraEnd) {
+            quint16 id = u16(*directory, extra);
+            quint16 length = u16(*directory, extra + 2);
+            qint64 field = extra + 4;
+            if(field + length > extraEnd) {
+                break;
+            }
+            if(id == 0x0001) {
+                for(quint64* value : {&entry.size, &entry.compressedSize, &entry.localHeaderOffset}) {
+                    if(*value == 0xFFFFFFFF && field + 8 <= extra + 4 + length) {
+                        *value = u64(*directory, field);
+                        field += 8;
+                    }
+                }
+            }
+            extra += 4 + length;
+        }
+
+        entries.push_back(entry);
+        pos += 46 + nameLength + extraLength + commentLength;
+    }
+
+    co_return entries;
+}
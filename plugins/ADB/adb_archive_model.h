@@ -0,0 +1,98 @@
+/*
+ * Copyright (C) 2025  JCM
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * waydroid-files is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ADB_ARCHIVE_MODEL_H
+#define ADB_ARCHIVE_MODEL_H
+
+#include <QAbstractListModel>
+#include <QObject>
+
+#include <QCoro/QCoroQmlTask>
+
+#include "adb_block_cache.h"
+#include "adb_client.h"
+
+struct ADBArchiveEntry {
+    QString name;
+    quint64 compressedSize;
+    quint64 size;
+    quint16 method;
+    quint64 localHeaderOffset;
+};
+
+// Lists the contents of a zip based archive (zip, apk, jar, ...) on the device.
+// Only the end of central directory record and the central directory itself are read, never the whole file.
+class ADBArchiveModel : public QAbstractListModel {
+    Q_OBJECT
+
+    enum Roles {
+        FileNameRole = Qt::UserRole,
+        FilePathRole,
+        FileSizeRole,
+        CompressedSizeRole,
+        IsBrowsableRole,
+    };
+
+public:
+    ADBArchiveModel();
+    ~ADBArchiveModel() = default;
+
+    Q_PROPERTY(ADBClient* adbClient READ adbClient WRITE setAdbClient)
+    Q_PROPERTY(QString path MEMBER m_path NOTIFY pathChanged)
+    Q_PROPERTY(QString folder READ folder WRITE setFolder NOTIFY folderChanged)
+    Q_PROPERTY(int entryCount READ entryCount NOTIFY entriesChanged)
+
+    Q_INVOKABLE QCoro::QmlTask load() {
+        return co_load();
+    }
+    QCoro::Task<bool> co_load();
+
+    static QCoro::Task<std::optional<std::vector<ADBArchiveEntry>>> co_readCentralDirectory(ADBBlockCache& cache, QString path, qint64 size, uint32_t time);
+
+    ADBClient* adbClient() const { return m_adbClient; }
+    void setAdbClient(ADBClient* client);
+    const QString& folder() const { return m_folder; }
+    void setFolder(const QString& folder);
+    int entryCount() const { return static_cast<int>(m_entries.size()); }
+
+    QHash<int, QByteArray> roleNames() const override;
+    int rowCount(const QModelIndex& parent) const override;
+    QVariant data(const QModelIndex& index, int role) const override;
+signals:
+    void pathChanged();
+    void folderChanged();
+    void entriesChanged();
+private:
+    struct Row {
+        QString name;
+        QString path;
+        bool isDirectory;
+        quint64 size;
+        quint64 compressedSize;
+    };
+
+    ADBClient* m_adbClient = nullptr;
+    ADBBlockCache m_blocks{nullptr};
+    QString m_path;
+    QString m_folder;
+
+    std::vector<ADBArchiveEntry> m_entries{};
+    std::vector<Row> m_rows{};
+
+    void updateRows();
+};
+
+#endif
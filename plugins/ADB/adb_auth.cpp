@@ -0,0 +1,175 @@
+/*
+ * Copyright (C) 2025  JCM
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * waydroid-files is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "adb_auth.h"
+
+#ifdef ADB_WITH_OPENSSL
+
+#include <memory>
+
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QStandardPaths>
+#include <QSysInfo>
+
+#include <openssl/bn.h>
+#include <openssl/core_names.h>
+#include <openssl/evp.h>
+#include <openssl/pem.h>
+#include <openssl/rsa.h>
+
+namespace {
+    using PKey = std::unique_ptr<EVP_PKEY, decltype(&EVP_PKEY_free)>;
+
+    constexpr int modulusWords = 2048 / 32;
+
+    // the layout adbd expects in ~/.android/adbkey.pub, before base64
+    struct [[gnu::packed]] RSAPublicKey {
+        uint32_t modulus_size_words;
+        uint32_t n0inv;
+        uint8_t modulus[modulusWords * 4];
+        uint8_t rr[modulusWords * 4];
+        uint32_t exponent;
+    };
+
+    PKey readKey(const QString& path) {
+        QFile file(path);
+        if(!file.open(QIODevice::ReadOnly)) {
+            return PKey{nullptr, EVP_PKEY_free};
+        }
+        QByteArray pem = file.readAll();
+        std::unique_ptr<BIO, decltype(&BIO_free)> bio{BIO_new_mem_buf(pem.constData(), pem.size()), BIO_free};
+        return PKey{PEM_read_bio_PrivateKey(bio.get(), nullptr, nullptr, nullptr), EVP_PKEY_free};
+    }
+
+    PKey generateKey(const QString& path) {
+        PKey key{EVP_RSA_gen(2048), EVP_PKEY_free};
+        if(!key) {
+            qWarning() << "Failed to generate adb key";
+            return key;
+        }
+
+        std::unique_ptr<BIO, decltype(&BIO_free)> bio{BIO_new(BIO_s_mem()), BIO_free};
+        PEM_write_bio_PrivateKey(bio.get(), key.get(), nullptr, nullptr, 0, nullptr, nullptr);
+        char* data = nullptr;
+        long size = BIO_get_mem_data(bio.get(), &data);
+
+        QDir().mkpath(QFileInfo(path).absolutePath());
+        QFile file(path);
+        if(!file.open(QIODevice::WriteOnly) || !file.setPermissions(QFile::ReadOwner | QFile::WriteOwner)) {
+            qWarning() << "Failed to save adb key to" << path;
+            return key;
+        }
+        file.write(data, size);
+        return key;
+    }
+
+    EVP_PKEY* hostKey() {
+        static PKey key = []() {
+            PKey key = readKey(QDir::homePath() + "/.android/adbkey");
+            if(!key) {
+                QString path = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation) + "/adbkey";
+                key = readKey(path);
+                if(!key) {
+                    key = generateKey(path);
+                }
+            }
+            return key;
+        }();
+        return key.get();
+    }
+}
+
+QByteArray ADBAuth::sign(const QByteArray& token) {
+    EVP_PKEY* key = hostKey();
+    if(!key) {
+        return {};
+    }
+
+    // adbd verifies the token as if it was a SHA1 digest, so it must not be hashed again
+    std::unique_ptr<EVP_PKEY_CTX, decltype(&EVP_PKEY_CTX_free)> ctx{EVP_PKEY_CTX_new(key, nullptr), EVP_PKEY_CTX_free};
+    size_t length = 0;
+    if(!ctx || EVP_PKEY_sign_init(ctx.get()) <= 0 ||
+        EVP_PKEY_CTX_set_rsa_padding(ctx.get(), RSA_PKCS1_PADDING) <= 0 ||
+        EVP_PKEY_CTX_set_signature_md(ctx.get(), EVP_sha1()) <= 0 ||
+        EVP_PKEY_sign(ctx.get(), nullptr, &length, reinterpret_cast<const unsigned char*>(token.constData()), token.size()) <= 0) {
+        qWarning() << "Failed to sign adb token";
+        return {};
+    }
+
+    QByteArray signature(static_cast<qsizetype>(length), Qt::Uninitialized);
+    if(EVP_PKEY_sign(ctx.get(), reinterpret_cast<unsigned char*>(signature.data()), &length,
+        reinterpret_cast<const unsigned char*>(token.constData()), token.size()) <= 0) {
+        qWarning() << "Failed to sign adb token";
+        return {};
+    }
+    signature.truncate(static_cast<qsizetype>(length));
+    return signature;
+}
+
+QByteArray ADBAuth::publicKey() {
+    EVP_PKEY* key = hostKey();
+    if(!key) {
+        return {};
+    }
+
+    BIGNUM* n = nullptr;
+    BIGNUM* e = nullptr;
+    if(EVP_PKEY_get_bn_param(key, OSSL_PKEY_PARAM_RSA_N, &n) <= 0 || EVP_PKEY_get_bn_param(key, OSSL_PKEY_PARAM_RSA_E, &e) <= 0) {
+        BN_free(n);
+        BN_free(e);
+        return {};
+    }
+    std::unique_ptr<BIGNUM, decltype(&BN_free)> modulus{n, BN_free}, exponent{e, BN_free};
+    std::unique_ptr<BN_CTX, decltype(&BN_CTX_free)> ctx{BN_CTX_new(), BN_CTX_free};
+    std::unique_ptr<BIGNUM, decltype(&BN_free)> r32{BN_new(), BN_free}, n0inv{BN_new(), BN_free}, rr{BN_new(), BN_free};
+
+    RSAPublicKey pub{};
+    pub.modulus_size_words = modulusWords;
+
+    // n0inv = -1 / n[0] mod 2^32, rr = (2^2048)^2 mod n, both precomputed for adbd's Montgomery multiplication
+    BN_set_bit(r32.get(), 32);
+    BN_mod(n0inv.get(), modulus.get(), r32.get(), ctx.get());
+    BN_mod_inverse(n0inv.get(), n0inv.get(), r32.get(), ctx.get());
+    BN_sub(n0inv.get(), r32.get(), n0inv.get());
+    pub.n0inv = static_cast<uint32_t>(BN_get_word(n0inv.get()));
+
+    BN_set_bit(rr.get(), modulusWords * 32 * 2);
+    BN_mod(rr.get(), rr.get(), modulus.get(), ctx.get());
+
+    BN_bn2lebinpad(modulus.get(), pub.modulus, sizeof(pub.modulus));
+    BN_bn2lebinpad(rr.get(), pub.rr, sizeof(pub.rr));
+    pub.exponent = static_cast<uint32_t>(BN_get_word(exponent.get()));
+
+    QByteArray user = qgetenv("USER");
+    if(user.isEmpty()) {
+        user = "phablet";
+    }
+    return QByteArray(reinterpret_cast<const char*>(&pub), sizeof(pub)).toBase64() + " " + user + "@" + QSysInfo::machineHostName().toUtf8();
+}
+
+#else
+
+QByteArray ADBAuth::sign(const QByteArray&) {
+    return {};
+}
+
+QByteArray ADBAuth::publicKey() {
+    return {};
+}
+
+#endif
@@ -0,0 +1,30 @@
+/*
+ * Copyright (C) 2025  JCM
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * waydroid-files is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ADB_AUTH_H
+#define ADB_AUTH_H
+
+#include <QByteArray>
+
+// The host key adbd authenticates us with. Reuses ~/.android/adbkey if the adb tools already created one.
+// Without OpenSSL support both return empty arrays and only devices with authentication disabled can be used.
+class ADBAuth {
+public:
+    static QByteArray sign(const QByteArray& token);
+    static QByteArray publicKey();
+};
+
+#endif
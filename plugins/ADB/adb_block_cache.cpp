@@ -0,0 +1,121 @@
+/*
+ * Copyright (C) 2025  JCM
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * waydroid-files is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "adb_block_cache.h"
+
+#include <algorithm>
+#include <vector>
+
+#include "adb_client.h"
+
+ADBBlockCache::ADBBlockCache(ADBClient* client, int capacity) : m_client(client), m_capacity(capacity) {
+}
+
+QString ADBBlockCache::blockKey(const QString& path, uint32_t time, qint64 block) {
+    return path + '\n' + QString::number(time) + '\n' + QString::number(block);
+}
+
+const QByteArray* ADBBlockCache::find(const QString& key) {
+    auto it = m_blocks.find(key);
+    if(it == m_blocks.end()) {
+        return nullptr;
+    }
+    m_lru.splice(m_lru.begin(), m_lru, it->lru);
+    return &it->data;
+}
+
+void ADBBlockCache::insert(const QString& key, QByteArray data) {
+    auto it = m_blocks.find(key);
+    if(it != m_blocks.end()) {
+        m_lru.erase(it->lru);
+        m_blocks.erase(it);
+    }
+    m_lru.push_front(key);
+    m_blocks.insert(key, Block{data, m_lru.begin()});
+
+    while(static_cast<int>(m_lru.size()) > m_capacity) {
+        m_blocks.remove(m_lru.back());
+        m_lru.pop_back();
+    }
+}
+
+void ADBBlockCache::clear() {
+    m_blocks.clear();
+    m_lru.clear();
+}
+
+QCoro::Task<std::optional<QByteArray>> ADBBlockCache::co_read(QString path, uint32_t time, qint64 offset, qint64 length) {
+    if(!m_client || offset < 0 || length <= 0) {
+        co_return std::nullopt;
+    }
+
+    qint64 first = offset / blockSize;
+    qint64 last = (offset + length - 1) / blockSize;
+    if(last - first + 1 > m_capacity) {
+        co_return co_await m_client->co_readRange(path, offset, length);
+    }
+
+    // The blocks of this read are kept here as well: other reads may evict them from the cache while this one
+    // waits for the device. A block that stays empty lies past the end of the file.
+    std::vector<std::optional<QByteArray>> pieces(static_cast<size_t>(last - first + 1));
+    for(qint64 block = first; block <= last; block++) {
+        if(const QByteArray* data = find(blockKey(path, time, block))) {
+            pieces[static_cast<size_t>(block - first)] = *data;
+        }
+    }
+
+    // fetch every run of consecutive missing blocks with a single read
+    for(qint64 block = first; block <= last;) {
+        if(pieces[static_cast<size_t>(block - first)]) {
+            block++;
+            continue;
+        }
+        qint64 runEnd = block;
+        while(runEnd + 1 <= last && !pieces[static_cast<size_t>(runEnd + 1 - first)]) {
+            runEnd++;
+        }
+
+        auto data = co_await m_client->co_readRange(path, block * blockSize, (runEnd - block + 1) * blockSize);
+        if(!data) {
+            co_return std::nullopt;
+        }
+        for(qint64 i = block; i <= runEnd; i++) {
+            qint64 start = (i - block) * blockSize;
+            if(start >= data->size()) {
+                break; // end of file
+            }
+            QByteArray piece = data->mid(start, blockSize);
+            insert(blockKey(path, time, i), piece);
+            pieces[static_cast<size_t>(i - first)] = std::move(piece);
+        }
+        block = runEnd + 1;
+    }
+
+    QByteArray result{};
+    for(auto it = pieces.begin(); it != pieces.end(); ++it) {
+        if(!*it) {
+            // a short read in the middle of the file rather than its end
+            if(std::any_of(it, pieces.end(), [](const std::optional<QByteArray>& piece) { return piece.has_value(); })) {
+                co_return std::nullopt;
+            }
+            break;
+        }
+        result += **it;
+        if((*it)->size() < blockSize) {
+            break;
+        }
+    }
+    co_return result.mid(offset - first * blockSize, length);
+}
@@ -0,0 +1,62 @@
+/*
+ * Copyright (C) 2025  JCM
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * waydroid-files is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ADB_BLOCK_CACHE_H
+#define ADB_BLOCK_CACHE_H
+
+#include <list>
+#include <optional>
+
+#include <QByteArray>
+#include <QHash>
+#include <QString>
+
+#include <QCoro/QCoroTask>
+
+class ADBClient;
+
+// Keeps recently read, block aligned pieces of device files in memory, so repeated small ranged reads
+// (file headers, archive directories) cost one device round trip for each run of missing blocks at most.
+class ADBBlockCache {
+public:
+    static constexpr qint64 blockSize = 64 * 1024;
+
+    ADBBlockCache(ADBClient* client, int capacity = 64);
+    ~ADBBlockCache() = default;
+
+    void setClient(ADBClient* client) { m_client = client; }
+
+    // time is the modification time of the file and keeps blocks of older versions from being returned
+    QCoro::Task<std::optional<QByteArray>> co_read(QString path, uint32_t time, qint64 offset, qint64 length);
+    void clear();
+private:
+    struct Block {
+        QByteArray data;
+        std::list<QString>::iterator lru;
+    };
+
+    ADBClient* m_client;
+    int m_capacity;
+
+    QHash<QString, Block> m_blocks{};
+    std::list<QString> m_lru{}; // most recently used first
+
+    static QString blockKey(const QString& path, uint32_t time, qint64 block);
+    const QByteArray* find(const QString& key);
+    void insert(const QString& key, QByteArray data);
+};
+
+#endif
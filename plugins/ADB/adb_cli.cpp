@@ -0,0 +1,253 @@
+/*
+ * Copyright (C) 2025  JCM
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * waydroid-files is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <cstdio>
+#include <optional>
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QRegularExpression>
+
+#include <QCoro/QCoroTask>
+
+#include <sys/stat.h>
+
+#include "adb_client.h"
+#include "adb_sync_engine.h"
+#include "adb_tar_transfer.h"
+#include "adb_trace.h"
+
+// waydroid-files-cli: the same client, session pool and transfer code as the app, for scripts and profiling.
+
+static bool json = false;
+
+static void print(const QString& line) {
+    std::fputs(qPrintable(line + '\n'), stdout);
+}
+
+static QJsonObject entryToJson(const ADBFileEntry& entry) {
+    return QJsonObject{
+        {"name", entry.fileName},
+        {"mode", static_cast<qint64>(entry.mode)},
+        {"size", static_cast<qint64>(entry.size)},
+        {"time", static_cast<qint64>(entry.time)},
+        {"type", S_ISDIR(entry.mode) ? "directory" : S_ISREG(entry.mode) ? "file" : S_ISLNK(entry.mode) ? "symlink" : "other"},
+    };
+}
+
+static QString entryToText(const ADBFileEntry& entry) {
+    return QStringLiteral("%1\t%2\t%3\t%4").arg(QString::number(entry.mode, 8)).arg(entry.size).arg(entry.time).arg(entry.fileName);
+}
+
+static QCoro::Task<std::optional<QJsonValue>> co_run(ADBClient& client, const QString& command, const QStringList& args, const QCommandLineParser& parser) {
+    auto need = [&args](qsizetype n) {
+        if(args.size() < n) {
+            qWarning() << "Not enough arguments";
+            return false;
+        }
+        return true;
+    };
+    ADBClient::TransferMode mode = parser.isSet("if-changed") ? ADBClient::TransferIfChanged : ADBClient::AlwaysTransfer;
+
+    if(command == "ls" && need(1)) {
+        std::vector<ADBFileEntry> entries = co_await client.co_listFiles(args.at(0));
+        if(entries.empty()) {
+            co_return std::nullopt;
+        }
+        QJsonArray result{};
+        for(const ADBFileEntry& entry : entries) {
+            if(entry.fileName == "." || entry.fileName == "..") {
+                continue;
+            }
+            json ? result.append(entryToJson(entry)) : print(entryToText(entry));
+        }
+        co_return result;
+    } else if(command == "stat" && need(1)) {
+        auto entry = co_await client.co_stat(args.at(0));
+        if(!entry || entry->mode == 0) {
+            co_return std::nullopt;
+        }
+        json ? void() : print(entryToText(*entry));
+        co_return entryToJson(*entry);
+    } else if((command == "pull" || command == "push") && parser.isSet("tar") && need(2)) {
+        ADBTarTransfer transfer{};
+        transfer.setProperty("adbClient", QVariant::fromValue(&client));
+        bool ok = command == "pull" ? co_await transfer.co_pull(args.at(0), args.at(1)) : co_await transfer.co_push(args.at(0), args.at(1));
+        if(!ok) {
+            co_return std::nullopt;
+        }
+        json ? void() : print(QStringLiteral("%1 files\t%2 bytes").arg(transfer.files()).arg(transfer.done()));
+        co_return QJsonObject{{"files", transfer.files()}, {"bytes", transfer.done()}};
+    } else if(command == "pull" && need(2)) {
+        if(parser.isSet("verify")) {
+            ADBClient::TransferError error = co_await client.co_pullFileVerified(args.at(0), args.at(1));
+            co_return error == ADBClient::NoError ? std::optional<QJsonValue>{true} : std::nullopt;
+        }
+        if(!(co_await client.co_pullFileTo(args.at(0), args.at(1), mode))) {
+            co_return std::nullopt;
+        }
+        co_return QJsonValue{true};
+    } else if(command == "push" && need(2)) {
+        if(parser.isSet("verify")) {
+            ADBClient::TransferError error = co_await client.co_pushFileVerified(args.at(0), args.at(1));
+            co_return error == ADBClient::NoError ? std::optional<QJsonValue>{true} : std::nullopt;
+        }
+        if(!(co_await client.co_pushFile(args.at(0), args.at(1), 0644, mode))) {
+            co_return std::nullopt;
+        }
+        co_return QJsonValue{true};
+    } else if((command == "du" || command == "find") && need(1)) {
+        ADBSyncManifest manifest = co_await ADBSyncEngine::co_deviceManifest(client, args.at(0), parser.value("parallel").toInt());
+        if(!manifest.valid) {
+            co_return std::nullopt;
+        }
+        for(const QString& folder : manifest.incomplete) {
+            qWarning() << "Could not list" << folder;
+        }
+
+        if(command == "du") {
+            qint64 bytes = 0;
+            for(const ADBSyncEntry& entry : manifest.files) {
+                bytes += entry.size;
+            }
+            json ? void() : print(QStringLiteral("%1\t%2 files\t%3 folders").arg(bytes).arg(manifest.files.size()).arg(manifest.folders.size()));
+            co_return QJsonObject{{"bytes", bytes}, {"files", manifest.files.size()}, {"folders", manifest.folders.size()}};
+        }
+
+        QRegularExpression pattern(parser.isSet("name") ? QRegularExpression::wildcardToRegularExpression(parser.value("name")) : ".*");
+        QStringList paths = parser.value("type") == "f" ? QStringList{} : manifest.folders;
+        if(parser.value("type") != "d") {
+            paths += manifest.files.keys();
+        }
+        paths.sort();
+
+        QJsonArray result{};
+        for(const QString& path : paths) {
+            if(!pattern.match(path.section('/', -1)).hasMatch()) {
+                continue;
+            }
+            json ? result.append(path) : print(path);
+        }
+        co_return result;
+    } else if(command == "sync" && need(2)) {
+        ADBSyncEngine engine{};
+        engine.setProperty("adbClient", QVariant::fromValue(&client));
+        engine.setProperty("hostPath", args.at(0));
+        engine.setProperty("devicePath", args.at(1));
+        if(parser.isSet("prefer")) {
+            QString prefer = parser.value("prefer");
+            engine.setProperty("conflictPolicy", prefer == "host" ? ADBSyncEngine::PreferHost : prefer == "device" ? ADBSyncEngine::PreferDevice : ADBSyncEngine::PreferNewer);
+        }
+        engine.setProperty("propagateDeletions", !parser.isSet("keep-deleted"));
+
+        QVariantMap result = co_await engine.co_sync();
+        if(result.isEmpty()) {
+            co_return std::nullopt;
+        }
+        if(!json) {
+            for(auto it = result.constBegin(); it != result.constEnd(); ++it) {
+                for(const QString& path : it.value().toStringList()) {
+                    print(it.key() + "\t" + path);
+                }
+            }
+        }
+        co_return QJsonObject::fromVariantMap(result);
+    }
+
+    qWarning() << "Unknown command or missing arguments:" << command;
+    co_return std::nullopt;
+}
+
+int main(int argc, char *argv[]) {
+    QCoreApplication app(argc, argv);
+    app.setApplicationName("waydroid-files.jcm");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Browse and transfer files on an Android device over ADB.\n\n"
+        "Commands:\n"
+        "  ls <path>                 list a folder\n"
+        "  stat <path>               show a single entry\n"
+        "  pull <device> <host>      copy a file from the device\n"
+        "  push <host> <device>      copy a file to the device\n"
+        "  du <path>                 total size of all files below a folder\n"
+        "  find <path>               list everything below a folder\n"
+        "  sync <host> <device>      synchronise two folders in both directions");
+    parser.addHelpOption();
+    parser.addPositionalArgument("command", "ls, stat, pull, push, du, find or sync");
+    parser.addOptions({
+        {"json", "Print the result as JSON, together with the time it took."},
+        {"adbd", "Talk to adbd at <host:port> directly instead of the adb server.", "host:port"},
+        {"if-changed", "pull/push: skip files whose content is already in place."},
+        {"verify", "pull/push: compare SHA-256 on both sides and retry on a mismatch."},
+        {"tar", "pull/push: copy a whole folder through one tar stream."},
+        {"name", "find: only entries whose name matches <pattern>.", "pattern"},
+        {"type", "find: only files (f) or folders (d).", "f|d"},
+        {"parallel", "du/find: folders listed at the same time.", "count", "4"},
+        {"prefer", "sync: resolve conflicts in favour of host, device or newer.", "side"},
+        {"keep-deleted", "sync: copy deleted files back instead of deleting them on the other side."},
+        {"trace", "Write a Chrome trace of the command to <file>.", "file"},
+    });
+    parser.process(app);
+
+    QStringList args = parser.positionalArguments();
+    if(args.isEmpty()) {
+        parser.showHelp(1);
+    }
+    QString command = args.takeFirst();
+    json = parser.isSet("json");
+
+    bool parallelOkay = false;
+    int parallel = parser.value("parallel").toInt(&parallelOkay);
+    if(!parallelOkay || parallel < 1) {
+        qWarning() << "Invalid --parallel" << parser.value("parallel") << ", expected a count of at least 1";
+        return 1;
+    }
+
+    if(parser.isSet("trace")) {
+        ADBTrace::setEnabled(true);
+    }
+    ADBClient client;
+    if(parser.isSet("adbd")) {
+        client.setDirectAddress(parser.value("adbd"));
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+    std::optional<QJsonValue> result = QCoro::waitFor(co_run(client, command, args, parser));
+    qint64 elapsed = timer.elapsed();
+    if(parser.isSet("trace")) {
+        ADBTrace::dump(parser.value("trace"));
+    }
+
+    if(json) {
+        QJsonObject output{
+            {"command", command},
+            {"success", result.has_value()},
+            {"elapsedMs", elapsed},
+        };
+        if(result) {
+            output.insert("result", *result);
+        }
+        print(QString::fromUtf8(QJsonDocument(output).toJson(QJsonDocument::Compact)));
+    } else {
+        std::fprintf(stderr, "%s took %lld ms\n", qPrintable(command), static_cast<long long>(elapsed));
+    }
+    return result ? 0 : 1;
+}
@@ -15,24 +15,43 @@
  */
 #include "adb_client.h"
 
-#include <expected>
+#include <cctype>
+#include <cerrno>
+#include <limits>
 
+#include <QCryptographicHash>
 #include <QDateTime>
 #include <QDebug>
 #include <QDir>
 #include <QFile>
-#include <QHostAddress>
+#include <QFileInfo>
+#include <QSaveFile>
 #include <QStandardPaths>
-#include <QTcpSocket>
 #include <QTimer>
 #include <QUrl>
 
-#include <QCoro/QCoroAbstractSocket>
+#include <QtConcurrent>
+
+#include <QCoro/QCoroFuture>
+#include <QCoro/QCoroTimer>
+
+#include "adb_direct_transport.h"
+#include "adb_disk_cache.h"
+#include "adb_hash_cache.h"
+#include "adb_listing_cache.h"
+#include "adb_media_server.h"
+#include "adb_trace.h"
 
 #include <arpa/inet.h>
+#include <fcntl.h>
+#include <linux/fs.h>
+#include <sys/ioctl.h>
 #include <sys/stat.h>
+#include <unistd.h>
+
+ADBClient::ADBClient() : m_listingCache(new ADBListingCache(8 * 1024 * 1024)) {
+    ADBTrace::enableFromEnvironment();
 
-ADBClient::ADBClient() {
     m_probeTimer = new QTimer(this);
     m_probeTimer->setInterval(m_probeInterval);
     connect(m_probeTimer, &QTimer::timeout, this, [this]() {
@@ -40,69 +59,59 @@ ADBClient::ADBClient() {
     });
     m_probeTimer->start();
 
+    setDirectAddress(qEnvironmentVariable("WAYDROID_FILES_ADBD"));
+
     co_probe(); // immediate first probe to reduce wait time
 }
 
-enum class ADBProtolError {
-    InvalidStatus,
-    TruncatedPayload,
-};
-
-using ADBError = std::variant<QByteArray, ADBProtolError>;
-using ADBResult = std::expected<QByteArray, ADBError>;
-
-QCoro::Task<std::expected<QByteArray, ADBError>> sendRequest(QTcpSocket& socket, const QByteArray& req) {
-    QByteArray r = QString::number(req.size(), 16).rightJustified(4, '0').toUtf8() + req;
-
-    auto co_socket = qCoro(socket);
-    co_await co_socket.write(r);
+ADBClient::~ADBClient() = default;
 
-    QByteArray status = co_await co_socket.read(4);
-    if(status != "OKAY" && status != "FAIL") {
-        co_return std::unexpected(ADBProtolError::InvalidStatus);
-    }
+QString shellQuote(const QString& arg) {
+    QString quoted = arg;
+    return "'" + quoted.replace("'", "'\\''") + "'";
+}
 
-    QByteArray len = co_await co_socket.read(4, std::chrono::milliseconds{1});
-    bool okay{};
-    int l = len.toInt(&okay, 16);
-    if(!okay) {
-        if(status == "FAIL") {
-            co_return std::unexpected(QByteArray(""));
-        }
-        co_return QByteArray{};
-    }
+QCoro::Task<void> ADBClient::co_probe() {
+    // keep the transport alive even if it gets replaced while we wait
+    std::shared_ptr<ADBTransport> transport = m_transport;
+    QString state = co_await transport->co_state();
 
-    r = co_await co_socket.read(l);
-    if(r.size() != l) {
-        co_return std::unexpected(ADBProtolError::TruncatedPayload);
+    if(state == "device") {
+        emit deviceFound();
+        m_probeTimer->stop();
     }
 
-    if(status == "FAIL") {
-        co_return std::unexpected(r);
-    }
-    co_return r;
+    co_return;
 }
 
-QCoro::Task<void> ADBClient::co_probe() {
-    QTcpSocket socket;
-    auto co_socket = qCoro(socket);
+QCoro::Task<QString> ADBClient::co_serial() {
+    std::shared_ptr<ADBTransport> transport = m_transport;
+    co_return co_await transport->co_serial();
+}
 
-    bool okay = co_await co_socket.connectToHost(QHostAddress::LocalHost, 5037);
-    if(!okay) {
-        qDebug() << "Failed to connect to ADB server";
-        co_return;
-    }
-    auto res = (co_await sendRequest(socket, "host:get-state"));
-    if(!res) {
-        co_return;
+void ADBClient::setDirectAddress(const QString& address) {
+    if(address == m_directAddress) {
+        return;
     }
 
-    if(*res == "device") {
-        emit deviceFound();
-        m_probeTimer->stop();
+    if(address.isEmpty()) {
+        m_transport = std::make_shared<ADBServerTransport>();
+    } else {
+        int colon = address.lastIndexOf(':');
+        bool okay = colon > 0;
+        quint16 port = okay ? address.mid(colon + 1).toUShort(&okay) : 0;
+        if(!okay) {
+            qWarning() << "Invalid adbd address" << address << ", expected host:port";
+            return;
+        }
+        m_transport = std::make_shared<ADBDirectTransport>(address.left(colon), port);
     }
-
-    co_return;
+    m_directAddress = address;
+    m_syncSessions.setTransport(m_transport);
+    m_bulkSessions.setTransport(m_transport);
+    m_shellSession.setTransport(m_transport);
+    m_probeTimer->start();
+    emit directAddressChanged();
 }
 
 struct [[gnu::packed]] sync_dent_rest {
@@ -120,29 +129,34 @@ struct [[gnu::packed]] sync_data_rest {
     uint32_t size;
 };
 
-QCoro::Task<std::vector<ADBFileEntry>> ADBClient::co_listFiles(QString path) {
+QCoro::Task<std::vector<ADBFileEntry>> ADBClient::co_listFiles(QString path, ADBIOScheduler::Priority priority, ADBCancelToken cancel) {
+    ADBTraceSpan span{"sync", "LIST", path};
     if(!path.endsWith('/')) {
         path += '/';
     }
 
     std::vector<ADBFileEntry> entries;
 
-    QTcpSocket socket;
-    auto co_socket = qCoro(socket);
-
-    bool okay = co_await co_socket.connectToHost(QHostAddress::LocalHost, 5037);
-    if(!okay) {
-        qWarning() << "Failed to connect to ADB server";
+    ADBIOScheduler& scheduler = ADBIOScheduler::instance();
+    ADBIOScheduler::BulkStream bulk{};
+    std::optional<ADBIOScheduler::Interactive> interactive{};
+    if(priority == ADBIOScheduler::Priority::Interactive) {
+        interactive.emplace(&scheduler);
+    } else {
+        co_await scheduler.co_yieldToInteractive(bulk);
+    }
+    if(cancel.cancelled()) {
         co_return entries;
     }
-
-    if(!(co_await sendRequest(socket, "host:transport-any"))) {
+    ADBSession session = co_await (interactive ? m_syncSessions : m_bulkSessions).co_acquire();
+    if(!session) {
         co_return entries;
     }
-
-    if(!(co_await sendRequest(socket, "sync:"))) {
+    if(cancel.cancelled()) {
+        session.done(); // nothing was sent on it yet
         co_return entries;
     }
+    ADBStreamIO co_socket{session.socket()};
 
     QByteArray rawPath = path.toUtf8();
     uint32_t rawPathLen = rawPath.size();
@@ -151,6 +165,13 @@ QCoro::Task<std::vector<ADBFileEntry>> ADBClient::co_listFiles(QString path) {
     co_await co_socket.write(syncRequest);
 
     while(true) {
+        if(!interactive) {
+            co_await scheduler.co_yieldToInteractive(bulk);
+        }
+        // the rest of the listing is never read, so the session is closed instead of going back to the pool
+        if(cancel.cancelled()) {
+            co_return std::vector<ADBFileEntry>{};
+        }
         QByteArray status = co_await co_socket.read(4);
         if(status == "FAIL") {
             QByteArray len = co_await co_socket.read(4);
@@ -164,6 +185,8 @@ QCoro::Task<std::vector<ADBFileEntry>> ADBClient::co_listFiles(QString path) {
             co_return entries;
         } else if(status == "DONE") {
             QByteArray unused = co_await co_socket.read(sizeof(sync_dent_rest));
+            session.done();
+            m_listingCache->insert(path, entries);
             break;
         } else if(status == "DENT") {
             QByteArray dent = co_await co_socket.read(sizeof(sync_dent_rest));
@@ -194,23 +217,21 @@ QCoro::Task<std::vector<ADBFileEntry>> ADBClient::co_listFiles(QString path) {
     co_return entries;
 }
 
-QCoro::Task<std::optional<ADBFileEntry>> ADBClient::co_stat(QString path) {
-    QTcpSocket socket;
-    auto co_socket = qCoro(socket);
-
-    bool okay = co_await co_socket.connectToHost(QHostAddress::LocalHost, 5037);
-    if(!okay) {
-        qWarning() << "Failed to connect to ADB server";
+QCoro::Task<std::optional<ADBFileEntry>> ADBClient::co_stat(QString path, ADBCancelToken cancel) {
+    ADBTraceSpan span{"sync", "STAT", path};
+    ADBIOScheduler::Interactive interactive = ADBIOScheduler::instance().interactive();
+    if(cancel.cancelled()) {
         co_return std::nullopt;
     }
-
-    if(!(co_await sendRequest(socket, "host:transport-any"))) {
+    ADBSession session = co_await m_syncSessions.co_acquire();
+    if(!session) {
         co_return std::nullopt;
     }
-
-    if(!(co_await sendRequest(socket, "sync:"))) {
+    if(cancel.cancelled()) {
+        session.done(); // nothing was sent on it yet
         co_return std::nullopt;
     }
+    ADBStreamIO co_socket{session.socket()};
 
     QByteArray rawPath = path.toUtf8();
     uint32_t rawPathLen = rawPath.size();
@@ -219,6 +240,9 @@ QCoro::Task<std::optional<ADBFileEntry>> ADBClient::co_stat(QString path) {
     co_await co_socket.write(syncRequest);
 
     QByteArray status = co_await co_socket.read(4);
+    if(cancel.cancelled()) {
+        co_return std::nullopt;
+    }
     if(status == "FAIL") {
         QByteArray len = co_await co_socket.read(4);
         if(len.size() != 4) {
@@ -236,6 +260,7 @@ QCoro::Task<std::optional<ADBFileEntry>> ADBClient::co_stat(QString path) {
             co_return std::nullopt;
         }
         const sync_stat_rest* dent_rest = reinterpret_cast<const sync_stat_rest*>(dent.constData());
+        session.done();
 
         ADBFileEntry entry;
         entry.fileName = QString::fromUtf8(path.toUtf8().split('/').last());
@@ -251,140 +276,341 @@ QCoro::Task<std::optional<ADBFileEntry>> ADBClient::co_stat(QString path) {
     co_return std::nullopt;
 }
 
-QCoro::Task<QUrl> ADBClient::co_pullFile(QString path) {
-    QTcpSocket socket;
-    auto co_socket = qCoro(socket);
+static void setHostFileTime(const QString& path, uint32_t time) {
+    QFile file{path};
+    if(file.open(QIODevice::Append)) {
+        file.setFileTime(QDateTime::fromSecsSinceEpoch(time), QFileDevice::FileModificationTime);
+    }
+}
 
-    bool okay = co_await co_socket.connectToHost(QHostAddress::LocalHost, 5037);
-    if(!okay) {
-        qWarning() << "Failed to connect to ADB server";
+// Shared by all clients, so two of them never account for the same directory.
+static ADBDiskCache& pulledFiles() {
+    static ADBDiskCache cache{QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/PulledFiles", 512ll * 1024 * 1024};
+    return cache;
+}
+
+qint64 ADBClient::pulledFilesBudget() const {
+    return pulledFiles().budget();
+}
+void ADBClient::setPulledFilesBudget(qint64 budget) {
+    pulledFiles().setBudget(budget);
+}
+
+QCoro::Task<QUrl> ADBClient::co_pullFile(QString path) {
+    ADBTraceSpan span{"transfer", "pullFile", path};
+    auto entry = co_await co_stat(path);
+    if(!entry || !S_ISREG(entry->mode)) {
+        qWarning() << "Cannot pull" << path << "as it is not a regular file";
         co_return {};
     }
 
-    if(!(co_await sendRequest(socket, "host:transport-any"))) {
+    // the returned file stays acquired until releasePulledFile, so it cannot be evicted while someone reads it
+    QByteArray key = ADBDiskCache::makeKey(path, entry->size, entry->time);
+    if(QString cached = pulledFiles().lookup(key); !cached.isEmpty()) {
+        pulledFiles().acquire(key);
+        co_return QUrl::fromLocalFile(cached);
+    }
+
+    QString fileName = path.split('/').last();
+    QSaveFile file{pulledFiles().pathFor(key, fileName)};
+    if(!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "Failed to open file for writing:" << file.fileName();
         co_return {};
     }
 
-    if(!(co_await sendRequest(socket, "sync:"))) {
+    if(!(co_await co_pullToDevice(path, file))) {
+        file.cancelWriting();
+        co_return {};
+    }
+    if(!file.commit()) {
+        qWarning() << "Failed to write file:" << file.fileName();
         co_return {};
     }
 
-    QByteArray rawPath = path.toUtf8();
-    uint32_t rawPathLen = rawPath.size();
-    QByteArray syncRequest = "RECV" + QByteArray::fromRawData(reinterpret_cast<const char*>(&rawPathLen), sizeof(uint32_t)) + rawPath;
+    pulledFiles().insert(key, fileName, true);
+    co_return QUrl::fromLocalFile(file.fileName());
+}
 
-    co_await co_socket.write(syncRequest);
+// Copies without moving the data through user space where possible: a reflink on filesystems that share
+// extents (btrfs, xfs), otherwise copy_file_range, which also works across filesystems on recent kernels.
+static bool copyFileFast(const QString& from, const QString& to) {
+    ADBTraceSpan span{"file", "copy", to, false};
+    int in = open(QFile::encodeName(from).constData(), O_RDONLY | O_CLOEXEC);
+    if(in == -1) {
+        qWarning() << "Failed to open" << from << "for reading";
+        return false;
+    }
+    int out = open(QFile::encodeName(to).constData(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if(out == -1) {
+        qWarning() << "Failed to open" << to << "for writing";
+        close(in);
+        return false;
+    }
 
-    QString destinationFolder = QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/PulledFiles";
-    if(!QDir{destinationFolder}.mkpath(".")) {
-        qWarning() << "Failed to create destination folder:" << destinationFolder;
-        co_return {};
+    bool okay = ioctl(out, FICLONE, in) == 0;
+    if(!okay) {
+        okay = true;
+        ssize_t copied;
+        while((copied = copy_file_range(in, nullptr, out, nullptr, 1024 * 1024 * 1024, 0)) > 0);
+        if(copied == -1 && (errno == EXDEV || errno == ENOSYS || errno == EINVAL || errno == EOPNOTSUPP)) {
+            // nothing was copied yet, fall back to a plain copy
+            char buffer[64 * 1024];
+            ssize_t n;
+            while((n = read(in, buffer, sizeof(buffer))) > 0) {
+                if(write(out, buffer, n) != n) {
+                    n = -1;
+                    break;
+                }
+            }
+            okay = n == 0;
+        } else {
+            okay = copied == 0;
+        }
+    }
+
+    close(in);
+    if(close(out) != 0) {
+        okay = false;
+    }
+    if(!okay) {
+        qWarning() << "Failed to copy" << from << "to" << to;
+    }
+    return okay;
+}
+
+QCoro::Task<bool> ADBClient::co_pullFileTo(QString path, QString hostPath, TransferMode transferMode) {
+    ADBTraceSpan span{"transfer", "pullFileTo", path};
+    auto entry = co_await co_stat(path);
+    if(!entry || !S_ISREG(entry->mode)) {
+        qWarning() << "Cannot pull" << path << "as it is not a regular file";
+        co_return false;
+    }
+
+    if(transferMode == TransferIfChanged && co_await co_isUnchanged(hostPath, path)) {
+        qDebug() << "Skipping pull of" << path << "as" << hostPath << "is unchanged";
+        setHostFileTime(hostPath, entry->time);
+        co_return true;
+    }
+
+    QByteArray key = ADBDiskCache::makeKey(path, entry->size, entry->time);
+    if(QString cached = pulledFiles().lookup(key); !cached.isEmpty()) {
+        pulledFiles().acquire(key);
+        bool okay = co_await QtConcurrent::run(copyFileFast, cached, hostPath);
+        pulledFiles().release(key);
+        if(okay && transferMode == TransferIfChanged) {
+            setHostFileTime(hostPath, entry->time);
+        }
+        co_return okay;
     }
-    QFile file{destinationFolder + "/" + path.split('/').last()};
+
+    // stream straight into the destination, which may be a document portal file where no temporary file can be created
+    QSaveFile file{hostPath};
+    file.setDirectWriteFallback(true);
     if(!file.open(QIODevice::WriteOnly)) {
-        qWarning() << "Failed to open file for writing:" << file.fileName();
-        co_return {};
+        qWarning() << "Failed to open file for writing:" << hostPath;
+        co_return false;
+    }
+    if(!(co_await co_pullToDevice(path, file))) {
+        file.cancelWriting();
+        co_return false;
+    }
+    if(!file.commit()) {
+        co_return false;
     }
+    // the next comparison can then stop at size and mtime
+    if(transferMode == TransferIfChanged) {
+        setHostFileTime(hostPath, entry->time);
+    }
+    co_return true;
+}
+
+QCoro::Task<bool> ADBClient::co_pullToDevice(QString path, QIODevice& destination, ADBIOScheduler::Priority priority) {
+    co_return co_await co_receive(path, destination, priority, nullptr) == NoError;
+}
+
+QCoro::Task<ADBClient::TransferError> ADBClient::co_receive(QString path, QIODevice& destination, ADBIOScheduler::Priority priority, QCryptographicHash* hash) {
+    ADBTraceSpan span{"sync", "RECV", path};
+    ADBIOScheduler& scheduler = ADBIOScheduler::instance();
+    ADBIOScheduler::BulkStream bulk{};
+    std::optional<ADBIOScheduler::Interactive> interactive{};
+    if(priority == ADBIOScheduler::Priority::Interactive) {
+        interactive.emplace(&scheduler);
+    }
+    ADBSession session = co_await (interactive ? m_syncSessions : m_bulkSessions).co_acquire();
+    if(!session) {
+        co_return ProtocolError;
+    }
+    ADBStreamIO co_socket{session.socket()};
+
+    QByteArray rawPath = path.toUtf8();
+    uint32_t rawPathLen = rawPath.size();
+    QByteArray syncRequest = "RECV" + QByteArray::fromRawData(reinterpret_cast<const char*>(&rawPathLen), sizeof(uint32_t)) + rawPath;
+
+    co_await co_socket.write(syncRequest);
 
     while(true) {
+        if(!interactive) {
+            co_await scheduler.co_yieldToInteractive(bulk);
+        }
         QByteArray status = co_await co_socket.read(4);
         if(status == "FAIL") {
-            file.close();
-            file.remove();
-
             QByteArray len = co_await co_socket.read(4);
             if(len.size() != 4) {
                 qWarning() << "Protocol error, message length truncated";
-                co_return {};
+                co_return ProtocolError;
             }
             uint32_t l = *reinterpret_cast<const uint32_t*>(len.constData());
             QByteArray msg = co_await co_socket.read(l);
             qWarning() << "ADB error:" << QString::fromUtf8(msg);
-            co_return {};
+            co_return DeviceError;
         } else if(status == "DONE") {
             QByteArray unused = co_await co_socket.read(sizeof(sync_data_rest));
+            session.done();
             break;
         } else if(status == "DATA") {
             QByteArray data = co_await co_socket.read(sizeof(sync_data_rest));
             if(data.size() != sizeof(sync_data_rest)) {
                 qWarning() << "Protocol error, DATA truncated";
-
-                file.close();
-                file.remove();
-                co_return {};
+                co_return Truncated;
             }
             const sync_data_rest* data_rest = reinterpret_cast<const sync_data_rest*>(data.constData());
             uint32_t size = data_rest->size;
             QByteArray filedata{};
-            do {
-                filedata += co_await co_socket.read(size - filedata.size());
-            } while(filedata.size() < static_cast<int>(size));
+            while(filedata.size() < static_cast<int>(size)) {
+                QByteArray chunk = co_await co_socket.read(size - filedata.size());
+                if(chunk.isEmpty()) {
+                    break; // the connection ended in the middle of the packet
+                }
+                filedata += chunk;
+            }
             if(filedata.size() != static_cast<int>(size)) {
                 qWarning() << "Protocol error, DATA payload wrong size, expected" << size << "got" << filedata.size();
-
-                file.close();
-                file.remove();
-                co_return {};
+                co_return Truncated;
             }
 
-            file.write(filedata);
+            if(hash) {
+                hash->addData(filedata);
+            }
+            if(destination.write(filedata) != filedata.size()) {
+                qWarning() << "Failed to write pulled data:" << destination.errorString();
+                co_return HostError;
+            }
+        } else if(status.isEmpty()) {
+            qWarning() << "Connection closed before DONE";
+            co_return Truncated;
         } else {
             qWarning() << "Protocol error, invalid status" << status;
+            co_return ProtocolError;
+        }
+    }
+
+    co_return NoError;
+}
 
-            file.close();
-            file.remove();
+QCoro::Task<std::unique_ptr<QIODevice>> ADBClient::co_openShell(QString command) {
+    std::shared_ptr<ADBTransport> transport = m_transport;
+    co_return co_await transport->co_open("shell:" + command.toUtf8());
+}
+
+QCoro::Task<std::optional<QByteArray>> ADBClient::co_shell(QString command) {
+    ADBTraceSpan span{"shell", "shell", command};
+    std::unique_ptr<QIODevice> socket = co_await co_openShell(command);
+    if(!socket) {
+        co_return std::nullopt;
+    }
+    ADBStreamIO co_socket{*socket};
+
+    QByteArray output{};
+    while(true) {
+        QByteArray chunk = co_await co_socket.read(64 * 1024);
+        if(chunk.isEmpty()) {
+            break;
         }
+        output += chunk;
     }
-    file.close();
+    co_return output;
+}
 
-    co_return QUrl::fromLocalFile(file.fileName());
+QCoro::Task<std::optional<QByteArray>> ADBClient::co_readRange(QString path, qint64 offset, qint64 length) {
+    ADBIOScheduler::Interactive interactive = ADBIOScheduler::instance().interactive();
+    if(offset < 0 || length <= 0) {
+        co_return QByteArray{};
+    }
+
+    // The sync protocol can only RECV whole files, so let the device seek for us.
+    // stderr has to go, shell: interleaves it with the data. Old dd builds without byte flags fall back to tail.
+    QString quotedPath = shellQuote(path);
+    QString command = QString("dd if=%1 iflag=skip_bytes,count_bytes skip=%2 count=%3 bs=65536 2>/dev/null || tail -c +%4 %1 2>/dev/null | head -c %3")
+        .arg(quotedPath).arg(offset).arg(length).arg(offset + 1);
+
+    auto data = co_await co_shell(command);
+    if(data && data->size() > length) {
+        data->truncate(length);
+    }
+    co_return data;
 }
 
-QCoro::Task<bool> ADBClient::co_pushFileFromUrl(QUrl hostUrl, QString devicePath, mode_t mode) {
+QCoro::Task<std::optional<qint64>> ADBClient::co_fileSize(QString path) {
+    ADBIOScheduler::Interactive interactive = ADBIOScheduler::instance().interactive();
+    // toybox and busybox both have stat -c
+    auto output = co_await co_shell("stat -c %s " + shellQuote(path) + " 2>/dev/null");
+    if(!output) {
+        co_return std::nullopt;
+    }
+    bool okay = false;
+    qint64 size = output->trimmed().toLongLong(&okay);
+    if(!okay || size < 0) {
+        co_return std::nullopt;
+    }
+    co_return size;
+}
+
+QCoro::Task<bool> ADBClient::co_pushFileFromUrl(QUrl hostUrl, QString devicePath, mode_t mode, TransferMode transferMode) {
     if(!hostUrl.isLocalFile()) {
         qWarning() << "Only local file URLs are supported";
         co_return false;
     }
     QString hostPath = hostUrl.toLocalFile();
-    co_return co_await co_pushFile(hostPath, devicePath, mode);
+    co_return co_await co_pushFile(hostPath, devicePath, mode, transferMode);
 }
 
-QCoro::Task<bool> ADBClient::co_pushFile(QString hostPath, QString devicePath, mode_t mode) {
+QCoro::Task<bool> ADBClient::co_pushFile(QString hostPath, QString devicePath, mode_t mode, TransferMode transferMode) {
+    if(transferMode == TransferIfChanged && co_await co_isUnchanged(hostPath, devicePath)) {
+        qDebug() << "Skipping push of" << hostPath << "as" << devicePath << "is unchanged";
+        co_return true;
+    }
+    co_return co_await co_send(hostPath, devicePath, mode, nullptr) == NoError;
+}
+
+QCoro::Task<ADBClient::TransferError> ADBClient::co_send(QString hostPath, QString devicePath, mode_t mode, QCryptographicHash* hash) {
+    ADBTraceSpan span{"sync", "SEND", devicePath};
     if(hostPath.isEmpty() || devicePath.isEmpty()) {
         qWarning() << "Host path or device path is empty";
-        co_return false;
+        co_return HostError;
     }
     if(devicePath.endsWith('/')) {
         qWarning() << "Device path cannot be a directory";
-        co_return false;
+        co_return DeviceError;
     }
 
     QFile file{hostPath};
     if(!file.exists()) {
         qWarning() << "Host file does not exist:" << hostPath;
-        co_return false;
+        co_return HostError;
     }
     if(!file.open(QIODevice::ReadOnly)) {
         qWarning() << "Failed to open host file for reading:" << hostPath;
-        co_return false;
-    }
-
-    QTcpSocket socket;
-    auto co_socket = qCoro(socket);
-
-    bool okay = co_await co_socket.connectToHost(QHostAddress::LocalHost, 5037);
-    if(!okay) {
-        qWarning() << "Failed to connect to ADB server";
-        co_return {};
+        co_return HostError;
     }
 
-    if(!(co_await sendRequest(socket, "host:transport-any"))) {
-        co_return {};
-    }
-
-    if(!(co_await sendRequest(socket, "sync:"))) {
-        co_return {};
+    ADBIOScheduler& scheduler = ADBIOScheduler::instance();
+    ADBIOScheduler::BulkStream bulk{};
+    co_await scheduler.co_yieldToInteractive(bulk);
+    ADBSession session = co_await m_bulkSessions.co_acquire();
+    if(!session) {
+        co_return ProtocolError;
     }
+    ADBStreamIO co_socket{session.socket()};
 
     QString arg = devicePath + ",0" + QString::number(mode, 8);
     QByteArray rawPath = arg.toUtf8();
@@ -397,19 +623,25 @@ QCoro::Task<bool> ADBClient::co_pushFile(QString hostPath, QString devicePath, m
         QByteArray len = co_await co_socket.read(4);
         if(len.size() != 4) {
             qWarning() << "Protocol error, message length truncated";
-            file.close();
-            co_return false;
+            co_return ProtocolError;
         }
         uint32_t l = *reinterpret_cast<const uint32_t*>(len.constData());
         QByteArray msg = co_await co_socket.read(l);
         qWarning() << "ADB error:" << QString::fromUtf8(msg);
-        file.close();
-        co_return false;
+        co_return DeviceError;
     }
 
     size_t chunkSize = 32 * 1024;
     while(!file.atEnd()) {
+        co_await scheduler.co_yieldToInteractive(bulk);
         QByteArray chunk = file.read(chunkSize);
+        if(chunk.isEmpty()) {
+            qWarning() << "Failed to read host file:" << file.errorString();
+            co_return HostError;
+        }
+        if(hash) {
+            hash->addData(chunk);
+        }
         uint32_t size = chunk.size();
         QByteArray data = "DATA" + QByteArray::fromRawData(reinterpret_cast<const char*>(&size), sizeof(uint32_t)) + chunk;
         co_await co_socket.write(data);
@@ -419,14 +651,12 @@ QCoro::Task<bool> ADBClient::co_pushFile(QString hostPath, QString devicePath, m
             QByteArray len = co_await co_socket.read(4);
             if(len.size() != 4) {
                 qWarning() << "Protocol error, message length truncated";
-                file.close();
-                co_return false;
+                co_return ProtocolError;
             }
             uint32_t l = *reinterpret_cast<const uint32_t*>(len.constData());
             QByteArray msg = co_await co_socket.read(l);
             qWarning() << "ADB error:" << QString::fromUtf8(msg);
-            file.close();
-            co_return false;
+            co_return DeviceError;
         }
     }
     file.close();
@@ -438,30 +668,260 @@ QCoro::Task<bool> ADBClient::co_pushFile(QString hostPath, QString devicePath, m
     status = co_await co_socket.read(4);
     if(status == "OKAY") {
         co_await co_socket.read(4); // unused
+        session.done();
+        m_listingCache->invalidate(devicePath.section('/', 0, -2));
     } else {
         if(status == "FAIL") {
             QByteArray len = co_await co_socket.read(4);
             if(len.size() != 4) {
                 qWarning() << "Protocol error, message length truncated";
-                co_return false;
+                co_return ProtocolError;
             }
             uint32_t l = *reinterpret_cast<const uint32_t*>(len.constData());
             QByteArray msg = co_await co_socket.read(l);
             qWarning() << "ADB error:" << QString::fromUtf8(msg);
-        } else {
-            qWarning() << "Protocol error, invalid status" << status;
+            co_return DeviceError;
+        }
+        qWarning() << "Protocol error, invalid status" << status;
+        co_return status.isEmpty() ? Truncated : ProtocolError;
+    }
+    co_return NoError;
+}
+
+bool ADBClient::retryable(TransferError error) {
+    return error == ProtocolError || error == Truncated || error == ChecksumMismatch;
+}
+
+QCoro::Task<ADBClient::TransferError> ADBClient::co_pullVerifiedOnce(QString path, QString hostPath) {
+    auto entry = co_await co_stat(path);
+    if(!entry || !S_ISREG(entry->mode)) {
+        qWarning() << "Cannot pull" << path << "as it is not a regular file";
+        co_return DeviceError;
+    }
+
+    // the device reads the file for hashing while it sends it, so checking adds next to no time
+    QCoro::Task<QByteArray> deviceHash = co_deviceHash(path);
+
+    QSaveFile file{hostPath};
+    file.setDirectWriteFallback(true);
+    if(!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "Failed to open file for writing:" << hostPath;
+        co_await deviceHash;
+        co_return HostError;
+    }
+    QCryptographicHash hash{QCryptographicHash::Sha256};
+    TransferError error = co_await co_receive(path, file, ADBIOScheduler::Priority::Bulk, &hash);
+    QByteArray expected = co_await deviceHash;
+
+    // sync v1 only has the lower 32 bits of the size
+    if(error == NoError && static_cast<uint32_t>(file.pos()) != entry->size) {
+        qWarning() << "Pulled" << file.pos() << "bytes of" << path << "but expected" << entry->size;
+        error = Truncated;
+    }
+    if(error == NoError && expected.isEmpty()) {
+        error = ChecksumUnavailable;
+    }
+    if(error == NoError && hash.result().toHex() != expected) {
+        qWarning() << "Checksum mismatch for" << path << ": device has" << expected << "but received" << hash.result().toHex();
+        error = ChecksumMismatch;
+    }
+    if(error != NoError) {
+        file.cancelWriting();
+        co_return error;
+    }
+    co_return file.commit() ? NoError : HostError;
+}
+
+QCoro::Task<ADBClient::TransferError> ADBClient::co_pushVerifiedOnce(QString hostPath, QString devicePath, mode_t mode) {
+    // the host side is hashed on its way out, only the device has to read the file again
+    QCryptographicHash hash{QCryptographicHash::Sha256};
+    TransferError error = co_await co_send(hostPath, devicePath, mode, &hash);
+    if(error != NoError) {
+        co_return error;
+    }
+
+    QByteArray actual = co_await co_deviceHash(devicePath);
+    if(actual.isEmpty()) {
+        co_return ChecksumUnavailable;
+    }
+    if(actual != hash.result().toHex()) {
+        qWarning() << "Checksum mismatch for" << devicePath << ": sent" << hash.result().toHex() << "but device has" << actual;
+        co_return ChecksumMismatch;
+    }
+    co_return NoError;
+}
+
+QCoro::Task<ADBClient::TransferError> ADBClient::co_pullFileVerified(QString path, QString hostPath, int retries) {
+    ADBTraceSpan span{"transfer", "pullFileVerified", path};
+    TransferError error = co_await co_pullVerifiedOnce(path, hostPath);
+    for(int attempt = 1; attempt <= retries && retryable(error); attempt++) {
+        qWarning() << "Pull of" << path << "failed with" << error << ", retrying";
+        QTimer delay{};
+        delay.setSingleShot(true);
+        delay.start(retryDelay * attempt);
+        co_await delay;
+        error = co_await co_pullVerifiedOnce(path, hostPath);
+    }
+    co_return error;
+}
+
+QCoro::Task<ADBClient::TransferError> ADBClient::co_pushFileVerified(QString hostPath, QString devicePath, mode_t mode, int retries) {
+    ADBTraceSpan span{"transfer", "pushFileVerified", devicePath};
+    TransferError error = co_await co_pushVerifiedOnce(hostPath, devicePath, mode);
+    for(int attempt = 1; attempt <= retries && retryable(error); attempt++) {
+        qWarning() << "Push of" << hostPath << "failed with" << error << ", retrying";
+        QTimer delay{};
+        delay.setSingleShot(true);
+        delay.start(retryDelay * attempt);
+        co_await delay;
+        error = co_await co_pushVerifiedOnce(hostPath, devicePath, mode);
+    }
+    co_return error;
+}
+
+QCoro::Task<QByteArray> ADBClient::co_deviceHash(QString path) {
+    // older toolboxes only have the standalone applet
+    auto output = co_await co_shell(QStringLiteral("toybox sha256sum %1 2>/dev/null || sha256sum %1 2>/dev/null").arg(shellQuote(path)));
+    if(!output || output->size() < 64) {
+        co_return QByteArray{};
+    }
+    QByteArray hash = output->left(64);
+    for(char c : hash) {
+        if(!std::isxdigit(static_cast<unsigned char>(c))) {
+            co_return QByteArray{};
         }
+    }
+    co_return hash.toLower();
+}
+
+QCoro::Task<bool> ADBClient::co_isUnchanged(QString hostPath, QString devicePath) {
+    QFileInfo info{hostPath};
+    auto entry = co_await co_stat(devicePath);
+    if(!info.isFile() || !entry || !S_ISREG(entry->mode)) {
         co_return false;
     }
-    co_return true;
+    // sync v1 only reports the lower 32 bits of the size, so for huge files it can only rule out a match
+    if(entry->size != static_cast<uint32_t>(info.size())) {
+        co_return false;
+    }
+    if(info.size() <= std::numeric_limits<uint32_t>::max() && entry->time == info.lastModified().toSecsSinceEpoch()) {
+        co_return true;
+    }
+
+    QByteArray deviceHash = co_await co_deviceHash(devicePath);
+    if(deviceHash.isEmpty()) {
+        co_return false;
+    }
+    QByteArray hostHash = co_await ADBHashCache::hostFiles().co_hash(hostPath);
+    co_return hostHash == deviceHash;
 }
 
-void ADBClient::cleanupPulledFiles() {
-    QString destinationFolder = QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/PulledFiles";
-    QDir dir{destinationFolder};
-    if(dir.exists()) {
-        dir.removeRecursively();
+QCoro::Task<std::vector<ADBFileOperationResult>> ADBClient::co_fileOperations(QStringList commands, QStringList statPaths, QStringList changedFolders) {
+    // appending the stat to the command tells the caller what the entry looks like now without another round trip
+    for(int i = 0; i < commands.size(); i++) {
+        if(!statPaths.at(i).isEmpty()) {
+            commands[i] += QStringLiteral(" && stat -c '%f %s %Y' -- %1").arg(shellQuote(statPaths.at(i)));
+        }
     }
+
+    std::vector<ADBShellResult> outputs = co_await m_shellSession.co_run(commands);
+
+    std::vector<ADBFileOperationResult> results{};
+    results.reserve(outputs.size());
+    for(size_t i = 0; i < outputs.size(); i++) {
+        const ADBShellResult& output = outputs.at(i);
+        ADBFileOperationResult result{};
+        result.ok = output.exitStatus == 0;
+        if(!result.ok) {
+            result.error = QString::fromUtf8(output.output).trimmed();
+            if(result.error.isEmpty()) {
+                result.error = output.exitStatus < 0 ? QStringLiteral("Lost the connection to the device")
+                                                     : QStringLiteral("Failed with exit status %1").arg(output.exitStatus);
+            }
+        } else if(const QString& statPath = statPaths.at(static_cast<int>(i)); !statPath.isEmpty()) {
+            QList<QByteArray> fields = output.output.trimmed().split('\n').last().split(' ');
+            bool okay = fields.size() == 3;
+            ADBFileEntry entry{statPath.section('/', -1), 0, 0, 0};
+            entry.mode = okay ? fields.at(0).toUInt(&okay, 16) : 0;
+            entry.size = okay ? fields.at(1).toUInt(&okay) : 0;
+            entry.time = okay ? fields.at(2).toUInt(&okay) : 0;
+            if(okay) {
+                result.entry = entry;
+            }
+        }
+        results.push_back(std::move(result));
+    }
+
+    for(const QString& folder : changedFolders) {
+        m_listingCache->invalidate(folder);
+    }
+    co_return results;
+}
+
+QCoro::Task<std::vector<ADBFileOperationResult>> ADBClient::co_removeFiles(QStringList paths, bool recursive) {
+    QStringList commands{};
+    QStringList statPaths{};
+    QStringList folders{};
+    for(const QString& path : paths) {
+        commands.append(QStringLiteral("rm %1 -- %2").arg(recursive ? "-rf" : "-f", shellQuote(path)));
+        statPaths.append(QString{});
+        folders.append(path.section('/', 0, -2));
+    }
+    co_return co_await co_fileOperations(commands, statPaths, folders);
+}
+
+QCoro::Task<std::vector<ADBFileOperationResult>> ADBClient::co_moveFiles(QStringList paths, QString destinationFolder) {
+    QStringList commands{};
+    QStringList statPaths{};
+    QStringList folders{destinationFolder};
+    for(const QString& path : paths) {
+        QString target = destinationFolder + "/" + path.section('/', -1);
+        commands.append(QStringLiteral("if [ ! -d %2 ]; then echo 'Not a folder'; false; "
+                                       "elif [ -e %3 ] || [ -L %3 ]; then echo 'Already exists'; false; "
+                                       "else mv -- %1 %3; fi")
+            .arg(shellQuote(path), shellQuote(destinationFolder), shellQuote(target)));
+        statPaths.append(QString{});
+        folders.append(path.section('/', 0, -2));
+    }
+    co_return co_await co_fileOperations(commands, statPaths, folders);
+}
+
+QCoro::Task<std::vector<ADBFileOperationResult>> ADBClient::co_setMode(QStringList paths, mode_t mode) {
+    QStringList commands{};
+    QStringList folders{};
+    for(const QString& path : paths) {
+        commands.append(QStringLiteral("chmod %1 -- %2").arg(QString::number(mode & 07777, 8), shellQuote(path)));
+        folders.append(path.section('/', 0, -2));
+    }
+    co_return co_await co_fileOperations(commands, paths, folders);
+}
+
+QCoro::Task<ADBFileOperationResult> ADBClient::co_rename(QString path, QString newPath) {
+    QString command = QStringLiteral("if [ -e %2 ] || [ -L %2 ]; then echo 'Already exists'; false; else mv -- %1 %2; fi")
+        .arg(shellQuote(path), shellQuote(newPath));
+    auto results = co_await co_fileOperations({command}, {newPath}, {path.section('/', 0, -2), newPath.section('/', 0, -2)});
+    co_return results.empty() ? ADBFileOperationResult{} : results.front();
+}
+
+QCoro::Task<ADBFileOperationResult> ADBClient::co_makeDirectory(QString path) {
+    QString command = QStringLiteral("mkdir -- %1").arg(shellQuote(path));
+    auto results = co_await co_fileOperations({command}, {path}, {path.section('/', 0, -2)});
+    co_return results.empty() ? ADBFileOperationResult{} : results.front();
+}
+
+QUrl ADBClient::streamUrl(const QString& path) {
+    if(!m_mediaServer) {
+        m_mediaServer = std::make_unique<ADBMediaServer>(this);
+    }
+    return m_mediaServer->urlFor(path);
+}
+
+bool ADBClient::dumpTrace(const QString& path) {
+    return ADBTrace::dump(path);
+}
+
+void ADBClient::releasePulledFile(const QUrl& url) {
+    pulledFiles().releasePath(url.toLocalFile());
 }
 
 QCoro::Task<QString> ADBClient::co_findFirstAccessible(QStringList paths) {
@@ -17,12 +17,23 @@
 #ifndef ADB_CLIENT_H
 #define ADB_CLIENT_H
 
+#include <chrono>
+#include <memory>
+
 #include <QObject>
 #include <QUrl>
 
 #include <QCoro/QCoroCore>
 #include <QCoro/QCoroQmlTask>
 
+#include "adb_io_scheduler.h"
+#include "adb_session_pool.h"
+#include "adb_shell_session.h"
+
+class ADBListingCache;
+class ADBMediaServer;
+class QCryptographicHash;
+class QIODevice;
 class QTimer;
 
 struct ADBFileEntry {
@@ -32,24 +43,98 @@ struct ADBFileEntry {
     uint32_t time;
 };
 
+// Outcome of one file management operation. Renames, new folders and mode changes also report the entry as it is now.
+struct ADBFileOperationResult {
+    bool ok = false;
+    QString error{};
+    std::optional<ADBFileEntry> entry{};
+};
+
+// Handed to a request so its caller can give up on it later. A cancelled request stops at its next read and
+// closes its connection, or gives the connection back untouched if it had not sent anything yet.
+// Copies share the state, a default constructed token is never cancelled unless cancel() is called on it.
+class ADBCancelToken {
+public:
+    ADBCancelToken() : m_cancelled(std::make_shared<bool>(false)) {}
+
+    void cancel() { *m_cancelled = true; }
+    bool cancelled() const { return *m_cancelled; }
+private:
+    std::shared_ptr<bool> m_cancelled;
+};
+
+QString shellQuote(const QString& arg);
+
 class ADBClient : public QObject {
     Q_OBJECT
 
 public:
     ADBClient();
-    ~ADBClient() = default;
+    ~ADBClient();
 
     Q_PROPERTY(int probeInterval MEMBER m_probeInterval)
+    Q_PROPERTY(qint64 pulledFilesBudget READ pulledFilesBudget WRITE setPulledFilesBudget)
+    // "host:port" of an adbd to talk to directly instead of going through the adb server, empty for the server
+    Q_PROPERTY(QString directAddress READ directAddress WRITE setDirectAddress NOTIFY directAddressChanged)
+
+    enum TransferMode {
+        AlwaysTransfer,
+        // skip the transfer if the destination already has the same content, see co_isUnchanged
+        TransferIfChanged,
+    };
+    Q_ENUM(TransferMode)
+
+    // why a verified transfer failed
+    enum TransferError {
+        NoError,
+        // the device refused, e.g. a missing file or no permission, retrying will not help
+        DeviceError,
+        HostError,
+        // unexpected or cut off packets
+        ProtocolError,
+        // fewer bytes arrived than the file has
+        Truncated,
+        ChecksumMismatch,
+        // the device could not hash the file, so the copy could not be checked
+        ChecksumUnavailable,
+    };
+    Q_ENUM(TransferError)
 
-    QCoro::Task<std::optional<ADBFileEntry>> co_stat(QString path);
-    QCoro::Task<std::vector<ADBFileEntry>> co_listFiles(QString path);
+    QCoro::Task<QString> co_serial();
+    // cancelled requests return nothing, just like failed ones
+    QCoro::Task<std::optional<ADBFileEntry>> co_stat(QString path, ADBCancelToken cancel = {});
+    QCoro::Task<std::vector<ADBFileEntry>> co_listFiles(QString path, ADBIOScheduler::Priority priority = ADBIOScheduler::Priority::Interactive, ADBCancelToken cancel = {});
 
     QCoro::Task<QString> co_findFirstAccessible(QStringList paths);
     QCoro::Task<QString> co_findFirstAccessibleFolder(QStringList paths);
     QCoro::Task<QString> co_findFirstAccessibleRegularFile(QStringList paths);
     QCoro::Task<QUrl> co_pullFile(QString path);
-    QCoro::Task<bool> co_pushFile(QString hostPath, QString devicePath, mode_t mode = 0644);
-    QCoro::Task<bool> co_pushFileFromUrl(QUrl hostUrl, QString devicePath, mode_t mode = 0644);
+    QCoro::Task<bool> co_pullToDevice(QString path, QIODevice& destination, ADBIOScheduler::Priority priority = ADBIOScheduler::Priority::Bulk);
+    QCoro::Task<bool> co_pullFileTo(QString path, QString hostPath, TransferMode transferMode = AlwaysTransfer);
+    QCoro::Task<bool> co_pushFile(QString hostPath, QString devicePath, mode_t mode = 0644, TransferMode transferMode = AlwaysTransfer);
+    QCoro::Task<bool> co_pushFileFromUrl(QUrl hostUrl, QString devicePath, mode_t mode = 0644, TransferMode transferMode = AlwaysTransfer);
+    // Hash the data on its way through and compare it against sha256sum on the device. Failed attempts that
+    // may succeed the next time (mismatches, broken connections) are retried up to the given number of times.
+    QCoro::Task<TransferError> co_pullFileVerified(QString path, QString hostPath, int retries = 2);
+    QCoro::Task<TransferError> co_pushFileVerified(QString hostPath, QString devicePath, mode_t mode = 0644, int retries = 2);
+    // Same size and mtime, or failing that the same SHA-256 on both sides.
+    QCoro::Task<bool> co_isUnchanged(QString hostPath, QString devicePath);
+    // hex encoded, empty if the device cannot hash the file
+    QCoro::Task<QByteArray> co_deviceHash(QString path);
+    // The raw output stream of a running command, it ends when the command exits and destroying it ends the command.
+    QCoro::Task<std::unique_ptr<QIODevice>> co_openShell(QString command);
+    QCoro::Task<std::optional<QByteArray>> co_shell(QString command);
+    QCoro::Task<std::optional<QByteArray>> co_readRange(QString path, qint64 offset, qint64 length);
+    // exact past 4 GiB unlike the sizes from sync STAT and LIST, nullopt if the device cannot tell
+    QCoro::Task<std::optional<qint64>> co_fileSize(QString path);
+
+    // File management. Each call is a single batch on the shared shell session, with the results in the order of the paths.
+    // Moves and renames never replace an existing file. Removal takes whole folders unless recursive is false.
+    QCoro::Task<std::vector<ADBFileOperationResult>> co_removeFiles(QStringList paths, bool recursive = true);
+    QCoro::Task<std::vector<ADBFileOperationResult>> co_moveFiles(QStringList paths, QString destinationFolder);
+    QCoro::Task<std::vector<ADBFileOperationResult>> co_setMode(QStringList paths, mode_t mode);
+    QCoro::Task<ADBFileOperationResult> co_rename(QString path, QString newPath);
+    QCoro::Task<ADBFileOperationResult> co_makeDirectory(QString path);
 
     // Q_INVOKABLE QCoro::QmlTask stat(const QString& path) {
     //     return co_stat(path);
@@ -57,6 +142,9 @@ public:
     // Q_INVOKABLE QCoro::QmlTask listFiles(const QString& path) {
     //     return co_listFiles(path);
     // }
+    Q_INVOKABLE QCoro::QmlTask serial() {
+        return co_serial();
+    }
     Q_INVOKABLE QCoro::QmlTask findFirstAccessible(const QStringList& paths) {
         return co_findFirstAccessible(paths);
     }
@@ -69,20 +157,63 @@ public:
     Q_INVOKABLE QCoro::QmlTask pullFile(const QString& path) {
         return co_pullFile(path);
     }
-    Q_INVOKABLE QCoro::QmlTask pushFile(const QString& hostPath, const QString& devicePath, int mode = 0644) {
-        return co_pushFile(hostPath, devicePath, mode);
+    Q_INVOKABLE QCoro::QmlTask pullFileTo(const QString& path, const QString& hostPath, TransferMode transferMode = AlwaysTransfer) {
+        return co_pullFileTo(path, hostPath, transferMode);
+    }
+    Q_INVOKABLE QCoro::QmlTask pushFile(const QString& hostPath, const QString& devicePath, int mode = 0644, TransferMode transferMode = AlwaysTransfer) {
+        return co_pushFile(hostPath, devicePath, mode, transferMode);
     }
-    Q_INVOKABLE QCoro::QmlTask pushFileFromUrl(const QUrl& hostUrl, const QString& devicePath, int mode = 0644) {
-        return co_pushFileFromUrl(hostUrl, devicePath, mode);
+    Q_INVOKABLE QCoro::QmlTask pushFileFromUrl(const QUrl& hostUrl, const QString& devicePath, int mode = 0644, TransferMode transferMode = AlwaysTransfer) {
+        return co_pushFileFromUrl(hostUrl, devicePath, mode, transferMode);
     }
-    Q_INVOKABLE void cleanupPulledFiles();
+    Q_INVOKABLE QCoro::QmlTask pullFileVerified(const QString& path, const QString& hostPath, int retries = 2) {
+        return co_pullFileVerified(path, hostPath, retries);
+    }
+    Q_INVOKABLE QCoro::QmlTask pushFileVerified(const QString& hostPath, const QString& devicePath, int mode = 0644, int retries = 2) {
+        return co_pushFileVerified(hostPath, devicePath, mode, retries);
+    }
+    Q_INVOKABLE void releasePulledFile(const QUrl& url);
+    // http://127.0.0.1 URL a player can stream the file from without pulling it first, see ADBMediaServer
+    Q_INVOKABLE QUrl streamUrl(const QString& path);
+    // writes what the tracing ring buffer holds as Chrome trace JSON, see ADBTrace
+    Q_INVOKABLE bool dumpTrace(const QString& path);
+
+    ADBListingCache& listingCache() { return *m_listingCache; }
+    std::shared_ptr<ADBTransport> transport() const { return m_transport; }
+
+    qint64 pulledFilesBudget() const;
+    void setPulledFilesBudget(qint64 budget);
+
+    QString directAddress() const { return m_directAddress; }
+    void setDirectAddress(const QString& address);
 signals:
     void deviceFound();
+    void directAddressChanged();
 private:
     QTimer* m_probeTimer = nullptr;
     int m_probeInterval = 1000;
 
+    QString m_directAddress{};
+    std::shared_ptr<ADBTransport> m_transport = std::make_shared<ADBServerTransport>();
+
+    // interactive requests have their own sessions, so they never queue behind a transfer on the same socket
+    ADBSessionPool m_syncSessions{"sync:"};
+    ADBSessionPool m_bulkSessions{"sync:", 2};
+    ADBShellSession m_shellSession{};
+    std::unique_ptr<ADBListingCache> m_listingCache;
+    std::unique_ptr<ADBMediaServer> m_mediaServer;
+
     QCoro::Task<void> co_probe();
+
+    static constexpr std::chrono::milliseconds retryDelay{500};
+    static bool retryable(TransferError error);
+    // The transfer loops behind the public pull and push calls, feeding the data into hash if one is given.
+    QCoro::Task<TransferError> co_receive(QString path, QIODevice& destination, ADBIOScheduler::Priority priority, QCryptographicHash* hash);
+    QCoro::Task<TransferError> co_send(QString hostPath, QString devicePath, mode_t mode, QCryptographicHash* hash);
+    QCoro::Task<TransferError> co_pullVerifiedOnce(QString path, QString hostPath);
+    QCoro::Task<TransferError> co_pushVerifiedOnce(QString hostPath, QString devicePath, mode_t mode);
+    // statPaths holds the path to report the entry of for each command, or an empty string
+    QCoro::Task<std::vector<ADBFileOperationResult>> co_fileOperations(QStringList commands, QStringList statPaths, QStringList changedFolders);
 };
 
 #endif
@@ -0,0 +1,323 @@
+/*
+ * Copyright (C) 2025  JCM
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * waydroid-files is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "adb_direct_transport.h"
+
+#include <cstring>
+#include <utility>
+
+#include <QDebug>
+
+#include <QCoro/QCoroSignal>
+
+#include "adb_auth.h"
+#include "adb_trace.h"
+
+namespace {
+    constexpr uint32_t A_CNXN = 0x4e584e43;
+    constexpr uint32_t A_AUTH = 0x48545541;
+    constexpr uint32_t A_OPEN = 0x4e45504f;
+    constexpr uint32_t A_OKAY = 0x59414b4f;
+    constexpr uint32_t A_CLSE = 0x45534c43;
+    constexpr uint32_t A_WRTE = 0x45545257;
+
+    constexpr uint32_t AUTH_TOKEN = 1;
+    constexpr uint32_t AUTH_SIGNATURE = 2;
+    constexpr uint32_t AUTH_RSAPUBLICKEY = 3;
+
+    struct [[gnu::packed]] amessage {
+        uint32_t command;
+        uint32_t arg0;
+        uint32_t arg1;
+        uint32_t data_length;
+        uint32_t data_check;
+        uint32_t magic;
+    };
+
+    uint32_t checksum(const QByteArray& payload) {
+        uint32_t sum = 0;
+        for(char c : payload) {
+            sum += static_cast<uint8_t>(c);
+        }
+        return sum;
+    }
+}
+
+ADBDirectStream::ADBDirectStream(ADBDirectTransport* transport, uint32_t localId) : m_transport(transport), m_localId(localId) {
+}
+
+ADBDirectStream::~ADBDirectStream() {
+    if(!m_transport) {
+        return;
+    }
+    if(m_remoteId != 0 && !m_remoteClosed) {
+        m_transport->sendMessage(A_CLSE, m_localId, m_remoteId);
+    }
+    m_transport->m_streams.remove(m_localId);
+}
+
+qint64 ADBDirectStream::readData(char* data, qint64 maxSize) {
+    if(m_buffer.isEmpty()) {
+        return m_remoteClosed ? -1 : 0;
+    }
+
+    qint64 n = std::min<qint64>(maxSize, m_buffer.size());
+    std::memcpy(data, m_buffer.constData(), n);
+    m_buffer.remove(0, n);
+
+    if(m_ackDeferred && m_buffer.size() < maxBuffered && m_transport && !m_remoteClosed) {
+        m_ackDeferred = false;
+        m_transport->sendMessage(A_OKAY, m_localId, m_remoteId);
+    }
+    return n;
+}
+
+qint64 ADBDirectStream::writeData(const char* data, qint64 maxSize) {
+    if(!m_transport || m_remoteClosed) {
+        return -1;
+    }
+    m_pending.append(data, maxSize);
+    flush();
+    return maxSize;
+}
+
+void ADBDirectStream::flush() {
+    // the device only takes one WRTE per stream until it answered with OKAY
+    if(m_inFlight > 0 || m_pending.isEmpty() || !m_transport) {
+        return;
+    }
+    QByteArray chunk = m_pending.left(m_transport->m_maxData);
+    m_pending.remove(0, chunk.size());
+    m_inFlight = chunk.size();
+    m_transport->sendMessage(A_WRTE, m_localId, m_remoteId, chunk);
+}
+
+void ADBDirectStream::received(const QByteArray& data) {
+    m_buffer += data;
+    if(m_buffer.size() < maxBuffered) {
+        m_transport->sendMessage(A_OKAY, m_localId, m_remoteId);
+    } else {
+        m_ackDeferred = true;
+    }
+    emit readyRead();
+}
+
+void ADBDirectStream::acknowledged() {
+    qint64 written = m_inFlight;
+    m_inFlight = 0;
+    if(written > 0) {
+        emit bytesWritten(written);
+    }
+    flush();
+}
+
+void ADBDirectStream::remoteClosed() {
+    bool wasOpen = isOpen();
+    m_remoteClosed = true;
+    m_transport = nullptr;
+    m_pending.clear();
+    m_inFlight = 0;
+    if(!wasOpen) {
+        emit opened(false);
+        return;
+    }
+    // wake up anyone waiting for data, they will find the stream at its end
+    emit readChannelFinished();
+    emit readyRead();
+}
+
+ADBDirectTransport::ADBDirectTransport(QString host, quint16 port) : m_host(host), m_port(port) {
+    connect(&m_socket, &QTcpSocket::connected, this, [this]() {
+        sendMessage(A_CNXN, version, maxPayload, "host::features=shell_v2,cmd,fixed_push_mkdir");
+    });
+    connect(&m_socket, &QTcpSocket::readyRead, this, &ADBDirectTransport::readMessages);
+    connect(&m_socket, &QTcpSocket::disconnected, this, &ADBDirectTransport::disconnectAll);
+    connect(&m_socket, QOverload<QAbstractSocket::SocketError>::of(&QAbstractSocket::error), this, [this](QAbstractSocket::SocketError) {
+        qDebug() << "adbd connection to" << m_host << m_port << "failed:" << m_socket.errorString();
+        m_socket.abort();
+        disconnectAll();
+    });
+}
+
+ADBDirectTransport::~ADBDirectTransport() {
+    m_socket.disconnect(this);
+    for(ADBDirectStream* stream : std::as_const(m_streams)) {
+        stream->remoteClosed();
+    }
+}
+
+QCoro::Task<bool> ADBDirectTransport::co_connect() {
+    if(m_state == State::Connected) {
+        co_return true;
+    }
+    ADBTraceSpan span{"transport", "adbd handshake", m_host};
+    if(m_state == State::Disconnected) {
+        m_state = State::Connecting;
+        m_authAttempt = 0;
+        m_rx.clear();
+        m_socket.connectToHost(m_host, m_port);
+    }
+
+    // while the device shows its authorization prompt this times out, the next attempt keeps waiting on the same connection
+    co_await qCoro(this, &ADBDirectTransport::handshakeFinished, std::chrono::seconds{5});
+    co_return m_state == State::Connected;
+}
+
+QCoro::Task<std::unique_ptr<QIODevice>> ADBDirectTransport::co_open(QByteArray service) {
+    if(!(co_await co_connect())) {
+        co_return nullptr;
+    }
+
+    ADBTraceSpan span{"transport", "adbd open", QString::fromUtf8(service)};
+    uint32_t localId = m_nextId++;
+    std::unique_ptr<ADBDirectStream> stream{new ADBDirectStream(this, localId)};
+    m_streams.insert(localId, stream.get());
+    sendMessage(A_OPEN, localId, 0, service + '\0');
+
+    auto result = co_await qCoro(stream.get(), &ADBDirectStream::opened, std::chrono::seconds{10});
+    if(!result || !*result) {
+        qWarning() << "adbd refused to open" << service;
+        co_return nullptr;
+    }
+    co_return stream;
+}
+
+QCoro::Task<QString> ADBDirectTransport::co_state() {
+    if(co_await co_connect()) {
+        co_return QStringLiteral("device");
+    }
+    co_return m_state == State::Authorizing ? QStringLiteral("unauthorized") : QString();
+}
+
+QCoro::Task<QString> ADBDirectTransport::co_serial() {
+    // the adb server names TCP devices the same way
+    co_return QStringLiteral("%1:%2").arg(m_host).arg(m_port);
+}
+
+void ADBDirectTransport::sendMessage(uint32_t command, uint32_t arg0, uint32_t arg1, const QByteArray& payload) {
+    amessage msg{command, arg0, arg1, static_cast<uint32_t>(payload.size()), checksum(payload), command ^ 0xffffffff};
+    m_socket.write(reinterpret_cast<const char*>(&msg), sizeof(msg));
+    if(!payload.isEmpty()) {
+        m_socket.write(payload);
+    }
+}
+
+void ADBDirectTransport::readMessages() {
+    m_rx += m_socket.readAll();
+    while(m_rx.size() >= static_cast<qsizetype>(sizeof(amessage))) {
+        amessage msg;
+        std::memcpy(&msg, m_rx.constData(), sizeof(msg));
+        if(msg.magic != (msg.command ^ 0xffffffff) || msg.data_length > maxPayload * 4) {
+            qWarning() << "Protocol error, invalid adbd message" << QString::number(msg.command, 16);
+            m_socket.abort();
+            disconnectAll();
+            return;
+        }
+        if(m_rx.size() < static_cast<qsizetype>(sizeof(msg) + msg.data_length)) {
+            return;
+        }
+        QByteArray payload = m_rx.mid(sizeof(msg), msg.data_length);
+        m_rx.remove(0, sizeof(msg) + msg.data_length);
+        handleMessage(msg.command, msg.arg0, msg.arg1, payload);
+    }
+}
+
+void ADBDirectTransport::handleMessage(uint32_t command, uint32_t arg0, uint32_t arg1, const QByteArray& payload) {
+    switch(command) {
+        case A_CNXN:
+            m_maxData = std::min(arg1, maxPayload);
+            m_state = State::Connected;
+            qDebug() << "Connected to adbd:" << payload;
+            emit handshakeFinished(true);
+            break;
+        case A_AUTH:
+            handleAuth(arg0, payload);
+            break;
+        case A_OPEN:
+            // nothing on our side accepts streams opened by the device
+            sendMessage(A_CLSE, 0, arg0);
+            break;
+        case A_OKAY:
+            if(ADBDirectStream* stream = m_streams.value(arg1)) {
+                if(stream->m_remoteId == 0) {
+                    stream->m_remoteId = arg0;
+                    stream->open(QIODevice::ReadWrite | QIODevice::Unbuffered);
+                    emit stream->opened(true);
+                } else {
+                    stream->acknowledged();
+                }
+            }
+            break;
+        case A_WRTE:
+            if(ADBDirectStream* stream = m_streams.value(arg1)) {
+                stream->received(payload);
+            } else {
+                sendMessage(A_CLSE, arg1, arg0);
+            }
+            break;
+        case A_CLSE:
+            if(ADBDirectStream* stream = m_streams.take(arg1)) {
+                stream->remoteClosed();
+            }
+            break;
+        default:
+            qDebug() << "Ignoring adbd message" << QString::number(command, 16);
+            break;
+    }
+}
+
+void ADBDirectTransport::handleAuth(uint32_t type, const QByteArray& payload) {
+    if(type != AUTH_TOKEN) {
+        return;
+    }
+    m_state = State::Authorizing;
+
+    // First try to sign the token with our key, if the device does not know it yet, offer the public key.
+    // The device then asks its user and answers with CNXN once they accepted.
+    if(m_authAttempt == 0) {
+        QByteArray signature = ADBAuth::sign(payload);
+        if(!signature.isEmpty()) {
+            m_authAttempt++;
+            sendMessage(A_AUTH, AUTH_SIGNATURE, 0, signature);
+            return;
+        }
+    }
+    if(m_authAttempt <= 1) {
+        QByteArray key = ADBAuth::publicKey();
+        if(key.isEmpty()) {
+            qWarning() << "adbd requires authentication, but no key is available";
+            m_socket.abort();
+            disconnectAll();
+            return;
+        }
+        m_authAttempt = 2;
+        sendMessage(A_AUTH, AUTH_RSAPUBLICKEY, 0, key + '\0');
+        emit handshakeFinished(false);
+    }
+}
+
+void ADBDirectTransport::disconnectAll() {
+    if(m_state == State::Disconnected) {
+        return;
+    }
+    m_state = State::Disconnected;
+    m_rx.clear();
+
+    auto streams = std::exchange(m_streams, {});
+    for(ADBDirectStream* stream : std::as_const(streams)) {
+        stream->remoteClosed();
+    }
+    emit handshakeFinished(false);
+}
@@ -0,0 +1,115 @@
+/*
+ * Copyright (C) 2025  JCM
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * waydroid-files is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ADB_DIRECT_TRANSPORT_H
+#define ADB_DIRECT_TRANSPORT_H
+
+#include <QByteArray>
+#include <QHash>
+#include <QIODevice>
+#include <QObject>
+#include <QTcpSocket>
+
+#include "adb_transport.h"
+
+class ADBDirectTransport;
+
+// One service stream multiplexed over an ADBDirectTransport connection.
+class ADBDirectStream : public QIODevice {
+    Q_OBJECT
+
+public:
+    ~ADBDirectStream();
+
+    bool isSequential() const override { return true; }
+    bool atEnd() const override { return m_remoteClosed && m_buffer.isEmpty(); }
+    qint64 bytesAvailable() const override { return m_buffer.size() + QIODevice::bytesAvailable(); }
+    qint64 bytesToWrite() const override { return m_pending.size() + m_inFlight; }
+signals:
+    void opened(bool success);
+protected:
+    qint64 readData(char* data, qint64 maxSize) override;
+    qint64 writeData(const char* data, qint64 maxSize) override;
+private:
+    friend class ADBDirectTransport;
+
+    ADBDirectStream(ADBDirectTransport* transport, uint32_t localId);
+
+    void received(const QByteArray& data);
+    void acknowledged();
+    void remoteClosed();
+    void flush();
+
+    // stop acknowledging the device's writes while this much is waiting to be read
+    static constexpr qint64 maxBuffered = 1024 * 1024;
+
+    ADBDirectTransport* m_transport;
+    uint32_t m_localId;
+    uint32_t m_remoteId = 0;
+    QByteArray m_buffer{};
+    QByteArray m_pending{};
+    qint64 m_inFlight = 0;
+    bool m_ackDeferred = false;
+    bool m_remoteClosed = false;
+};
+
+// Talks the adbd wire protocol (CNXN/AUTH/OPEN/WRTE/OKAY/CLSE) to a device listening on TCP,
+// without needing an adb server on the host. All streams share the one connection.
+class ADBDirectTransport : public QObject, public ADBTransport {
+    Q_OBJECT
+
+public:
+    ADBDirectTransport(QString host, quint16 port);
+    ~ADBDirectTransport();
+
+    QCoro::Task<std::unique_ptr<QIODevice>> co_open(QByteArray service) override;
+    QCoro::Task<QString> co_state() override;
+    QCoro::Task<QString> co_serial() override;
+signals:
+    void handshakeFinished(bool success);
+private:
+    friend class ADBDirectStream;
+
+    enum class State {
+        Disconnected,
+        Connecting,
+        Authorizing,
+        Connected,
+    };
+
+    QCoro::Task<bool> co_connect();
+
+    void sendMessage(uint32_t command, uint32_t arg0, uint32_t arg1, const QByteArray& payload = {});
+    void handleMessage(uint32_t command, uint32_t arg0, uint32_t arg1, const QByteArray& payload);
+    void handleAuth(uint32_t type, const QByteArray& payload);
+    void readMessages();
+    void disconnectAll();
+
+    static constexpr uint32_t version = 0x01000001;
+    static constexpr uint32_t maxPayload = 256 * 1024;
+
+    QString m_host;
+    quint16 m_port;
+    QTcpSocket m_socket{};
+    State m_state = State::Disconnected;
+    int m_authAttempt = 0;
+    uint32_t m_maxData = maxPayload;
+    uint32_t m_nextId = 1;
+    QByteArray m_rx{};
+    QHash<uint32_t, ADBDirectStream*> m_streams{};
+};
+
+#endif
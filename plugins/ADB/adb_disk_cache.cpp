@@ -0,0 +1,166 @@
+/*
+ * Copyright (C) 2025  JCM
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * waydroid-files is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "adb_disk_cache.h"
+
+#include <QCryptographicHash>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+
+ADBDiskCache::ADBDiskCache(QString directory, qint64 budget) : m_directory(directory), m_budget(budget) {
+    if(!QDir{m_directory}.mkpath(".")) {
+        qWarning() << "Failed to create cache folder:" << m_directory;
+    }
+    load();
+}
+
+QByteArray ADBDiskCache::makeKey(const QString& path, uint32_t size, uint32_t time, const QByteArray& variant) {
+    QCryptographicHash hash{QCryptographicHash::Sha1};
+    hash.addData(path.toUtf8());
+    hash.addData(QByteArray::fromRawData(reinterpret_cast<const char*>(&size), sizeof(size)));
+    hash.addData(QByteArray::fromRawData(reinterpret_cast<const char*>(&time), sizeof(time)));
+    hash.addData(variant);
+    return hash.result().toHex();
+}
+
+void ADBDiskCache::load() {
+    QFileInfoList files = QDir{m_directory}.entryInfoList(QDir::Files | QDir::Dirs | QDir::NoDotAndDotDot, QDir::Time); // newest first
+    for(const QFileInfo& info : files) {
+        QByteArray key = info.fileName().toUtf8();
+        QFileInfo file = info;
+        if(info.isDir()) {
+            QFileInfoList contents = QDir{info.filePath()}.entryInfoList(QDir::Files);
+            if(contents.isEmpty()) {
+                QDir{info.filePath()}.removeRecursively(); // left behind by an interrupted write
+                continue;
+            }
+            file = contents.first();
+        }
+        m_lru.push_back(key);
+        m_entries.insert(key, Entry{file.filePath(), file.size(), 0, std::prev(m_lru.end())});
+        m_usage += file.size();
+    }
+    evict();
+}
+
+QString ADBDiskCache::pathFor(const QByteArray& key, const QString& fileName) const {
+    QString path = m_directory + "/" + QString::fromUtf8(key);
+    if(fileName.isEmpty()) {
+        return path;
+    }
+    QDir{path}.mkpath(".");
+    return path + "/" + fileName;
+}
+
+QString ADBDiskCache::lookup(const QByteArray& key) {
+    auto it = m_entries.find(key);
+    if(it == m_entries.end()) {
+        return {};
+    }
+    if(!QFileInfo::exists(it->path)) {
+        remove(key);
+        return {};
+    }
+    m_lru.splice(m_lru.begin(), m_lru, it->lru);
+
+    QString root = m_directory + "/" + QString::fromUtf8(key);
+    utimensat(AT_FDCWD, QFile::encodeName(root).constData(), nullptr, 0);
+    return it->path;
+}
+
+void ADBDiskCache::insert(const QByteArray& key, const QString& fileName, bool acquire) {
+    int references = 0;
+    if(auto it = m_entries.find(key); it != m_entries.end()) {
+        references = it->references;
+        remove(key);
+    }
+
+    QFileInfo info{pathFor(key, fileName)};
+    if(!info.exists()) {
+        return;
+    }
+    m_lru.push_front(key);
+    m_entries.insert(key, Entry{info.filePath(), info.size(), references + (acquire ? 1 : 0), m_lru.begin()});
+    m_usage += info.size();
+    evict();
+}
+
+void ADBDiskCache::remove(const QByteArray& key) {
+    auto it = m_entries.find(key);
+    if(it == m_entries.end()) {
+        return;
+    }
+    m_usage -= it->size;
+    m_lru.erase(it->lru);
+    m_entries.erase(it);
+}
+
+bool ADBDiskCache::acquire(const QByteArray& key) {
+    auto it = m_entries.find(key);
+    if(it == m_entries.end()) {
+        return false;
+    }
+    it->references++;
+    return true;
+}
+
+void ADBDiskCache::release(const QByteArray& key) {
+    auto it = m_entries.find(key);
+    if(it == m_entries.end() || it->references == 0) {
+        return;
+    }
+    it->references--;
+    evict();
+}
+
+void ADBDiskCache::releasePath(const QString& path) {
+    for(auto it = m_entries.begin(); it != m_entries.end(); ++it) {
+        if(it->path == path) {
+            release(it.key());
+            return;
+        }
+    }
+}
+
+void ADBDiskCache::setBudget(qint64 budget) {
+    m_budget = budget;
+    evict();
+}
+
+void ADBDiskCache::evict() {
+    auto it = m_lru.end();
+    while(m_usage > m_budget && it != m_lru.begin()) {
+        auto candidate = std::prev(it);
+        QByteArray key = *candidate;
+        auto entry = m_entries.find(key);
+        if(entry->references > 0) {
+            it = candidate;
+            continue;
+        }
+
+        QString root = m_directory + "/" + QString::fromUtf8(key);
+        if(entry->path == root) {
+            QFile::remove(root);
+        } else {
+            QDir{root}.removeRecursively();
+        }
+        remove(key);
+    }
+}
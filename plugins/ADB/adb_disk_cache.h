@@ -0,0 +1,68 @@
+/*
+ * Copyright (C) 2025  JCM
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * waydroid-files is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ADB_DISK_CACHE_H
+#define ADB_DISK_CACHE_H
+
+#include <list>
+
+#include <QByteArray>
+#include <QHash>
+#include <QString>
+
+// A directory of files named by key, trimmed to a byte budget by evicting the least recently used ones.
+// The order survives restarts through the file modification times, which are bumped on every hit.
+// Entries that need to keep a file name are stored as <key>/<name> instead.
+// Acquired entries are never evicted until every reference was released again.
+class ADBDiskCache {
+public:
+    ADBDiskCache(QString directory, qint64 budget);
+    ~ADBDiskCache() = default;
+
+    static QByteArray makeKey(const QString& path, uint32_t size, uint32_t time, const QByteArray& variant = {});
+
+    QString lookup(const QByteArray& key);
+    QString pathFor(const QByteArray& key, const QString& fileName = {}) const;
+    void insert(const QByteArray& key, const QString& fileName = {}, bool acquire = false);
+    void remove(const QByteArray& key);
+
+    bool acquire(const QByteArray& key);
+    void release(const QByteArray& key);
+    void releasePath(const QString& path);
+
+    qint64 budget() const { return m_budget; }
+    void setBudget(qint64 budget);
+    qint64 usage() const { return m_usage; }
+private:
+    struct Entry {
+        QString path;
+        qint64 size;
+        int references;
+        std::list<QByteArray>::iterator lru;
+    };
+
+    QString m_directory;
+    qint64 m_budget;
+    qint64 m_usage = 0;
+
+    QHash<QByteArray, Entry> m_entries{};
+    std::list<QByteArray> m_lru{}; // most recently used first
+
+    void load();
+    void evict();
+};
+
+#endif
@@ -0,0 +1,307 @@
+/*
+ * Copyright (C) 2025  JCM
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * waydroid-files is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "adb_duplicate_model.h"
+
+#include <algorithm>
+
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QHash>
+
+#include "adb_folder_model.h"
+#include "adb_shell_session.h"
+#include "adb_sync_engine.h"
+
+ADBDuplicateModel::~ADBDuplicateModel() = default;
+
+QHash<int, QByteArray> ADBDuplicateModel::roleNames() const {
+    QHash<int, QByteArray> roles;
+    roles[Roles::FileNameRole] = "fileName";
+    roles[Roles::FilePathRole] = "filePath";
+    roles[Roles::FolderRole] = "folder";
+    roles[Roles::FileSizeRole] = "fileSize";
+    roles[Roles::ModifiedRole] = "modified";
+    roles[Roles::GroupRole] = "group";
+    roles[Roles::IsSelectedRole] = "isSelected";
+    return roles;
+}
+int ADBDuplicateModel::rowCount(const QModelIndex& parent) const {
+    if(parent.isValid()) {
+        return 0;
+    }
+    return static_cast<int>(m_rows.size());
+}
+QVariant ADBDuplicateModel::data(const QModelIndex& index, int role) const {
+    if(!index.isValid() || index.row() < 0 || index.row() >= static_cast<int>(m_rows.size())) {
+        return {};
+    }
+
+    auto [group, member] = m_rows.at(static_cast<size_t>(index.row()));
+    const File& file = m_groups.at(group).at(member);
+    switch(role) {
+        case Roles::FileNameRole:
+            return file.path.section('/', -1);
+        case Roles::FilePathRole:
+            return file.path;
+        case Roles::FolderRole:
+            return file.path.section('/', 0, -2);
+        case Roles::FileSizeRole:
+            return ADBFolderModel::fileSize(file.size);
+        case Roles::ModifiedRole:
+            return QDateTime::fromSecsSinceEpoch(file.time);
+        case Roles::GroupRole:
+            return group;
+        case Roles::IsSelectedRole:
+            return file.selected;
+        default:
+            return {};
+    }
+}
+
+int ADBDuplicateModel::selectionCount() const {
+    int count = 0;
+    for(const Group& group : m_groups) {
+        count += std::count_if(group.begin(), group.end(), [](const File& file) { return file.selected; });
+    }
+    return count;
+}
+
+QString ADBDuplicateModel::selectedSize() const {
+    qint64 bytes = 0;
+    for(const Group& group : m_groups) {
+        for(const File& file : group) {
+            bytes += file.selected ? file.size : 0;
+        }
+    }
+    return ADBFolderModel::fileSize(bytes);
+}
+
+void ADBDuplicateModel::setSelected(int row, bool selected) {
+    if(row < 0 || row >= static_cast<int>(m_rows.size())) {
+        return;
+    }
+    auto [group, member] = m_rows.at(static_cast<size_t>(row));
+    File& file = m_groups.at(group).at(member);
+    if(file.selected == selected) {
+        return;
+    }
+    file.selected = selected;
+    emit dataChanged(index(row), index(row), {Roles::IsSelectedRole});
+    emit resultsChanged();
+}
+
+void ADBDuplicateModel::setStage(Stage stage, int total) {
+    m_stage = stage;
+    m_done = 0;
+    m_total = total;
+    emit progressChanged();
+}
+
+void ADBDuplicateModel::setGroups(std::vector<Group> groups, bool preselect) {
+    // most space to gain first, and in each group the oldest copy first, which is also the one that is kept
+    for(Group& group : groups) {
+        std::sort(group.begin(), group.end(), [](const File& a, const File& b) {
+            return a.time != b.time ? a.time < b.time : a.path < b.path;
+        });
+        for(size_t i = 0; preselect && i < group.size(); i++) {
+            group[i].selected = i != 0;
+        }
+    }
+    std::sort(groups.begin(), groups.end(), [](const Group& a, const Group& b) {
+        return a.front().size * static_cast<qint64>(a.size() - 1) > b.front().size * static_cast<qint64>(b.size() - 1);
+    });
+
+    beginResetModel();
+    m_groups = std::move(groups);
+    m_rows.clear();
+    for(size_t group = 0; group < m_groups.size(); group++) {
+        for(size_t member = 0; member < m_groups[group].size(); member++) {
+            m_rows.emplace_back(static_cast<int>(group), static_cast<int>(member));
+        }
+    }
+    endResetModel();
+    emit resultsChanged();
+}
+
+QCoro::Task<bool> ADBDuplicateModel::co_scan() {
+    if(m_running || !m_adbClient) {
+        co_return false;
+    }
+    m_running = true;
+    emit runningChanged();
+    setGroups({});
+
+    setStage(Listing, 0);
+    ADBSyncManifest manifest = co_await ADBSyncEngine::co_deviceManifest(*m_adbClient, m_path);
+    if(!manifest.valid) {
+        qWarning() << "Failed to list" << m_path << "on the device";
+        setStage(Idle, 0);
+        m_running = false;
+        emit runningChanged();
+        co_return false;
+    }
+    for(const QString& folder : std::as_const(manifest.incomplete)) {
+        qWarning() << "Could not list" << folder << ", not looking for duplicates in it";
+    }
+
+    // nearly all files have a size nobody else has, they are done without ever being read
+    QString root = QDir::cleanPath(m_path);
+    QHash<qint64, Group> bySize{};
+    for(auto it = manifest.files.constBegin(); it != manifest.files.constEnd(); ++it) {
+        if(it->size >= m_minimumSize) {
+            bySize[it->size].push_back(File{root + "/" + it.key(), it->size, it->time});
+        }
+    }
+    std::vector<Group> groups{};
+    for(Group& group : bySize) {
+        if(group.size() > 1) {
+            groups.push_back(std::move(group));
+        }
+    }
+
+    m_sessions.clear();
+    for(int i = 0; i < std::max(m_parallelShells, 1); i++) {
+        m_sessions.push_back(std::make_unique<ADBShellSession>());
+        m_sessions.back()->setTransport(m_adbClient->transport());
+    }
+    co_await co_refine(groups, true);
+    co_await co_refine(groups, false);
+    m_sessions.clear();
+
+    setGroups(std::move(groups));
+    setStage(Idle, 0);
+    m_running = false;
+    emit runningChanged();
+    co_return true;
+}
+
+QCoro::Task<void> ADBDuplicateModel::co_refine(std::vector<Group>& groups, bool partial) {
+    HashJob job{};
+    std::vector<bool> hashed(groups.size(), false);
+    for(size_t i = 0; i < groups.size(); i++) {
+        if(partial && groups[i].front().size <= 2 * partialLength) {
+            continue;
+        }
+        hashed[i] = true;
+        for(const File& file : groups[i]) {
+            QString quoted = shellQuote(file.path);
+            job.commands.append(partial
+                ? QStringLiteral("{ head -c %2 %1 && tail -c %2 %1; } | sha256sum").arg(quoted, QString::number(partialLength))
+                : QStringLiteral("sha256sum < %1").arg(quoted));
+        }
+    }
+    job.hashes.resize(static_cast<size_t>(job.commands.size()));
+
+    setStage(partial ? Prefiltering : Hashing, static_cast<int>(job.commands.size()));
+    std::vector<QCoro::Task<void>> workers{};
+    for(auto& session : m_sessions) {
+        workers.push_back(co_hashWorker(job, *session));
+    }
+    for(auto& worker : workers) {
+        co_await worker;
+    }
+
+    // files that could not be read drop out, everything else is split into groups of the same hash
+    std::vector<Group> refined{};
+    size_t next = 0;
+    for(size_t i = 0; i < groups.size(); i++) {
+        if(!hashed[i]) {
+            refined.push_back(std::move(groups[i]));
+            continue;
+        }
+        QHash<QByteArray, Group> byHash{};
+        for(File& file : groups[i]) {
+            const QByteArray& hash = job.hashes[next++];
+            if(!hash.isEmpty()) {
+                byHash[hash].push_back(std::move(file));
+            }
+        }
+        for(Group& group : byHash) {
+            if(group.size() > 1) {
+                refined.push_back(std::move(group));
+            }
+        }
+    }
+    groups = std::move(refined);
+}
+
+QCoro::Task<void> ADBDuplicateModel::co_hashWorker(HashJob& job, ADBShellSession& session) {
+    while(job.next < job.commands.size()) {
+        qsizetype first = job.next;
+        qsizetype count = std::min<qsizetype>(hashBatch, job.commands.size() - first);
+        job.next += count;
+
+        std::vector<ADBShellResult> results = co_await session.co_run(job.commands.mid(first, count));
+        for(qsizetype i = 0; i < count; i++) {
+            const ADBShellResult& result = results.at(static_cast<size_t>(i));
+            // "<64 hex digits>  -"
+            QByteArray hash = result.output.left(64);
+            if(result.exitStatus == 0 && hash.size() == 64 && QByteArray::fromHex(hash).size() == 32) {
+                job.hashes[static_cast<size_t>(first + i)] = hash;
+            }
+        }
+        m_done += static_cast<int>(count);
+        emit progressChanged();
+    }
+}
+
+QCoro::Task<QVariantMap> ADBDuplicateModel::co_removeSelected() {
+    if(m_running || !m_adbClient) {
+        co_return QVariantMap{};
+    }
+    QStringList paths{};
+    for(const Group& group : m_groups) {
+        for(const File& file : group) {
+            if(file.selected) {
+                paths.append(file.path);
+            }
+        }
+    }
+    if(paths.isEmpty()) {
+        co_return QVariantMap{{"failed", QStringList{}}, {"errors", QStringList{}}};
+    }
+
+    m_running = true;
+    emit runningChanged();
+    std::vector<ADBFileOperationResult> results = co_await m_adbClient->co_removeFiles(paths);
+
+    QHash<QString, QString> failures{};
+    for(qsizetype i = 0; i < paths.size(); i++) {
+        if(static_cast<size_t>(i) >= results.size() || !results[static_cast<size_t>(i)].ok) {
+            failures.insert(paths.at(i), static_cast<size_t>(i) < results.size() ? results[static_cast<size_t>(i)].error : QString{});
+        }
+    }
+
+    // removed files leave their group, and a group with a single file left has no duplicates anymore
+    std::vector<Group> remaining{};
+    for(Group& group : m_groups) {
+        Group kept{};
+        for(File& file : group) {
+            if(!file.selected || failures.contains(file.path)) {
+                kept.push_back(std::move(file));
+            }
+        }
+        if(kept.size() > 1) {
+            remaining.push_back(std::move(kept));
+        }
+    }
+    setGroups(std::move(remaining), false);
+
+    m_running = false;
+    emit runningChanged();
+    co_return QVariantMap{{"failed", QStringList(failures.keys())}, {"errors", QStringList(failures.values())}};
+}
@@ -0,0 +1,150 @@
+/*
+ * Copyright (C) 2025  JCM
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * waydroid-files is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ADB_DUPLICATE_MODEL_H
+#define ADB_DUPLICATE_MODEL_H
+
+#include <memory>
+#include <vector>
+
+#include <QAbstractListModel>
+#include <QObject>
+#include <QVariantMap>
+
+#include <QCoro/QCoroQmlTask>
+
+#include "adb_client.h"
+
+class ADBShellSession;
+
+// Finds files with the same content below a folder without pulling any of them.
+// Files are bucketed by size first, only sizes that occur more than once are hashed at all, large ones by their
+// first and last bytes before the whole file, and the hashing runs as sha256sum batches on a few shells at once.
+// Rows are grouped by content, every copy but the oldest one of a group starts out selected for removeSelected.
+class ADBDuplicateModel : public QAbstractListModel {
+    Q_OBJECT
+
+    enum Roles {
+        FileNameRole = Qt::UserRole,
+        FilePathRole,
+        FolderRole,
+        FileSizeRole,
+        ModifiedRole,
+        GroupRole,
+        IsSelectedRole,
+    };
+
+public:
+    enum Stage {
+        Idle,
+        Listing,
+        Prefiltering,
+        Hashing,
+    };
+    Q_ENUM(Stage)
+
+    ADBDuplicateModel() = default;
+    ~ADBDuplicateModel();
+
+    Q_PROPERTY(ADBClient* adbClient MEMBER m_adbClient)
+    Q_PROPERTY(QString path MEMBER m_path NOTIFY pathChanged)
+    // files below this size are left out, empty files are all alike and not worth listing
+    Q_PROPERTY(qint64 minimumSize MEMBER m_minimumSize)
+    Q_PROPERTY(int parallelShells MEMBER m_parallelShells)
+
+    Q_PROPERTY(bool running READ running NOTIFY runningChanged)
+    Q_PROPERTY(Stage stage READ stage NOTIFY progressChanged)
+    // files hashed in the current stage
+    Q_PROPERTY(int done READ done NOTIFY progressChanged)
+    Q_PROPERTY(int total READ total NOTIFY progressChanged)
+    Q_PROPERTY(int groupCount READ groupCount NOTIFY resultsChanged)
+    Q_PROPERTY(int selectionCount READ selectionCount NOTIFY resultsChanged)
+    // what removing the selected files frees
+    Q_PROPERTY(QString selectedSize READ selectedSize NOTIFY resultsChanged)
+
+    // resolves to false if the folder could not be listed
+    Q_INVOKABLE QCoro::QmlTask scan() {
+        return co_scan();
+    }
+    QCoro::Task<bool> co_scan();
+
+    Q_INVOKABLE void setSelected(int row, bool selected);
+    // resolves to a map with the failed paths and their errors
+    Q_INVOKABLE QCoro::QmlTask removeSelected() {
+        return co_removeSelected();
+    }
+    QCoro::Task<QVariantMap> co_removeSelected();
+
+    bool running() const { return m_running; }
+    Stage stage() const { return m_stage; }
+    int done() const { return m_done; }
+    int total() const { return m_total; }
+    int groupCount() const { return static_cast<int>(m_groups.size()); }
+    int selectionCount() const;
+    QString selectedSize() const;
+
+    QHash<int, QByteArray> roleNames() const override;
+    int rowCount(const QModelIndex& parent) const override;
+    QVariant data(const QModelIndex& index, int role) const override;
+signals:
+    void pathChanged();
+    void runningChanged();
+    void progressChanged();
+    void resultsChanged();
+private:
+    struct File {
+        QString path;
+        qint64 size;
+        qint64 time;
+        bool selected = false;
+    };
+    using Group = std::vector<File>;
+
+    struct HashJob {
+        QStringList commands;
+        std::vector<QByteArray> hashes;
+        qsizetype next = 0;
+    };
+
+    // the prefilter hashes this much from each end, files up to twice the size go straight to the full hash
+    static constexpr qint64 partialLength = 64 * 1024;
+    static constexpr int hashBatch = 32;
+
+    ADBClient* m_adbClient = nullptr;
+    QString m_path;
+    qint64 m_minimumSize = 1;
+    int m_parallelShells = 3;
+
+    bool m_running = false;
+    Stage m_stage = Idle;
+    int m_done = 0;
+    int m_total = 0;
+
+    std::vector<Group> m_groups{};
+    // group and index in it for every row
+    std::vector<std::pair<int, int>> m_rows{};
+
+    std::vector<std::unique_ptr<ADBShellSession>> m_sessions{};
+
+    void setStage(Stage stage, int total);
+    // splits every group by the hashes of its files, for partial only the groups of large files
+    QCoro::Task<void> co_refine(std::vector<Group>& groups, bool partial);
+    QCoro::Task<void> co_hashWorker(HashJob& job, ADBShellSession& session);
+    // preselect: select every file but the one that is kept in each group
+    void setGroups(std::vector<Group> groups, bool preselect = true);
+};
+
+#endif
@@ -0,0 +1,513 @@
+/*
+ * Copyright (C) 2025  JCM
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * waydroid-files is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "adb_file_types.h"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <iterator>
+
+#include <QMetaEnum>
+
+namespace {
+
+using namespace std::literals;
+using ContentHubType = ADBFileTypes::ContentHubType;
+
+// Started out as the extension list of the old contenttyperesolver.js, with the MIME types taken from
+// shared-mime-info. Extensions are lower case, a duplicate fails the build below.
+constexpr ADBFileTypes::Type types[] = {
+    // pictures
+    {"art", "image/x-jg", "image-x-generic", ContentHubType::Pictures},
+    {"bmp", "image/bmp", "image-x-generic", ContentHubType::Pictures},
+    {"cdr", "image/x-coreldraw", "image-x-generic", ContentHubType::Pictures},
+    {"cdt", "image/x-coreldrawtemplate", "image-x-generic", ContentHubType::Pictures},
+    {"cpt", "image/x-corelphotopaint", "image-x-generic", ContentHubType::Pictures},
+    {"cr2", "image/x-canon-cr2", "image-x-generic", ContentHubType::Pictures},
+    {"crw", "image/x-canon-crw", "image-x-generic", ContentHubType::Pictures},
+    {"djv", "image/vnd.djvu", "image-x-generic", ContentHubType::Pictures},
+    {"djvu", "image/vnd.djvu", "image-x-generic", ContentHubType::Pictures},
+    {"erf", "image/x-epson-erf", "image-x-generic", ContentHubType::Pictures},
+    {"gif", "image/gif", "image-x-generic", ContentHubType::Pictures},
+    {"ico", "image/vnd.microsoft.icon", "image-x-generic", ContentHubType::Pictures},
+    {"ief", "image/ief", "image-x-generic", ContentHubType::Pictures},
+    {"jng", "image/x-jng", "image-x-generic", ContentHubType::Pictures},
+    {"jp2", "image/jp2", "image-x-generic", ContentHubType::Pictures},
+    {"jpe", "image/jpeg", "image-x-generic", ContentHubType::Pictures},
+    {"jpeg", "image/jpeg", "image-x-generic", ContentHubType::Pictures},
+    {"jpf", "image/jpx", "image-x-generic", ContentHubType::Pictures},
+    {"jpg", "image/jpeg", "image-x-generic", ContentHubType::Pictures},
+    {"jpg2", "image/jp2", "image-x-generic", ContentHubType::Pictures},
+    {"jpm", "image/jpm", "image-x-generic", ContentHubType::Pictures},
+    {"jpx", "image/jpx", "image-x-generic", ContentHubType::Pictures},
+    {"nef", "image/x-nikon-nef", "image-x-generic", ContentHubType::Pictures},
+    {"orf", "image/x-olympus-orf", "image-x-generic", ContentHubType::Pictures},
+    {"pat", "image/x-gimp-pat", "image-x-generic", ContentHubType::Pictures},
+    {"pbm", "image/x-portable-bitmap", "image-x-generic", ContentHubType::Pictures},
+    {"pcx", "image/vnd.zbrush.pcx", "image-x-generic", ContentHubType::Pictures},
+    {"pgm", "image/x-portable-graymap", "image-x-generic", ContentHubType::Pictures},
+    {"png", "image/png", "image-x-generic", ContentHubType::Pictures},
+    {"pnm", "image/x-portable-anymap", "image-x-generic", ContentHubType::Pictures},
+    {"ppm", "image/x-portable-pixmap", "image-x-generic", ContentHubType::Pictures},
+    {"psd", "image/vnd.adobe.photoshop", "image-x-generic", ContentHubType::Pictures},
+    {"ras", "image/x-cmu-raster", "image-x-generic", ContentHubType::Pictures},
+    {"rgb", "image/x-rgb", "image-x-generic", ContentHubType::Pictures},
+    {"svg", "image/svg+xml", "image-x-generic", ContentHubType::Pictures},
+    {"svgz", "image/svg+xml-compressed", "image-x-generic", ContentHubType::Pictures},
+    {"tif", "image/tiff", "image-x-generic", ContentHubType::Pictures},
+    {"tiff", "image/tiff", "image-x-generic", ContentHubType::Pictures},
+    {"wbmp", "image/vnd.wap.wbmp", "image-x-generic", ContentHubType::Pictures},
+    {"xbm", "image/x-xbitmap", "image-x-generic", ContentHubType::Pictures},
+    {"xpm", "image/x-xpixmap", "image-x-generic", ContentHubType::Pictures},
+    {"xwd", "image/x-xwindowdump", "image-x-generic", ContentHubType::Pictures},
+    {"webp", "image/webp", "image-x-generic", ContentHubType::Pictures},
+    {"heic", "image/heif", "image-x-generic", ContentHubType::Pictures},
+    {"heif", "image/heif", "image-x-generic", ContentHubType::Pictures},
+    {"avif", "image/avif", "image-x-generic", ContentHubType::Pictures},
+
+    // videos
+    {"3gp", "video/3gpp", "video-x-generic", ContentHubType::Videos},
+    {"asf", "application/vnd.ms-asf", "video-x-generic", ContentHubType::Videos},
+    {"asx", "audio/x-ms-asx", "video-x-generic", ContentHubType::Videos},
+    {"avi", "video/x-msvideo", "video-x-generic", ContentHubType::Videos},
+    {"axv", "video/annodex", "video-x-generic", ContentHubType::Videos},
+    {"dif", "video/dv", "video-x-generic", ContentHubType::Videos},
+    {"dl", "application/vnd.datalog", "video-x-generic", ContentHubType::Videos},
+    {"dv", "video/dv", "video-x-generic", ContentHubType::Videos},
+    {"fli", "video/x-flic", "video-x-generic", ContentHubType::Videos},
+    {"flv", "video/x-flv", "video-x-generic", ContentHubType::Videos},
+    {"gl", "video/gl", "video-x-generic", ContentHubType::Videos},
+    {"lsf", "video/x-la-asf", "video-x-generic", ContentHubType::Videos},
+    {"lsx", "video/x-la-asf", "video-x-generic", ContentHubType::Videos},
+    {"m4v", "video/mp4", "video-x-generic", ContentHubType::Videos},
+    {"mkv", "video/x-matroska", "video-x-generic", ContentHubType::Videos},
+    {"mng", "video/x-mng", "video-x-generic", ContentHubType::Videos},
+    {"mov", "video/quicktime", "video-x-generic", ContentHubType::Videos},
+    {"movie", "video/x-sgi-movie", "video-x-generic", ContentHubType::Videos},
+    {"mp4", "video/mp4", "video-x-generic", ContentHubType::Videos},
+    {"mpe", "video/mpeg", "video-x-generic", ContentHubType::Videos},
+    {"mpeg", "video/mpeg", "video-x-generic", ContentHubType::Videos},
+    {"mpg", "video/mpeg", "video-x-generic", ContentHubType::Videos},
+    {"mpv", "video/x-matroska", "video-x-generic", ContentHubType::Videos},
+    {"mxu", "video/vnd.mpegurl", "video-x-generic", ContentHubType::Videos},
+    {"ogv", "video/ogg", "video-x-generic", ContentHubType::Videos},
+    {"qt", "video/quicktime", "video-x-generic", ContentHubType::Videos},
+    {"ts", "video/mp2t", "video-x-generic", ContentHubType::Videos},
+    {"webm", "video/webm", "video-x-generic", ContentHubType::Videos},
+    {"wm", "video/x-ms-wm", "video-x-generic", ContentHubType::Videos},
+    {"wmv", "video/x-ms-wmv", "video-x-generic", ContentHubType::Videos},
+    {"wmx", "video/x-ms-wmx", "video-x-generic", ContentHubType::Videos},
+    {"wvx", "video/x-ms-wvx", "video-x-generic", ContentHubType::Videos},
+
+    // music
+    {"aif", "audio/x-aiff", "audio-x-generic", ContentHubType::Music},
+    {"aifc", "audio/x-aifc", "audio-x-generic", ContentHubType::Music},
+    {"aiff", "audio/x-aiff", "audio-x-generic", ContentHubType::Music},
+    {"amr", "audio/amr", "audio-x-generic", ContentHubType::Music},
+    {"au", "audio/basic", "audio-x-generic", ContentHubType::Music},
+    {"awb", "audio/amr-wb", "audio-x-generic", ContentHubType::Music},
+    {"axa", "audio/annodex", "audio-x-generic", ContentHubType::Music},
+    {"csd", "audio/csound", "audio-x-generic", ContentHubType::Music},
+    {"flac", "audio/flac", "audio-x-generic", ContentHubType::Music},
+    {"gsm", "audio/x-gsm", "audio-x-generic", ContentHubType::Music},
+    {"kar", "audio/midi", "audio-x-generic", ContentHubType::Music},
+    {"m3u", "audio/x-mpegurl", "audio-x-generic", ContentHubType::Music},
+    {"m4a", "audio/mp4", "audio-x-generic", ContentHubType::Music},
+    {"mid", "audio/midi", "audio-x-generic", ContentHubType::Music},
+    {"midi", "audio/midi", "audio-x-generic", ContentHubType::Music},
+    {"mp2", "audio/mp2", "audio-x-generic", ContentHubType::Music},
+    {"mp3", "audio/mpeg", "audio-x-generic", ContentHubType::Music},
+    {"mpega", "audio/mpeg", "audio-x-generic", ContentHubType::Music},
+    {"mpga", "audio/mpeg", "audio-x-generic", ContentHubType::Music},
+    {"oga", "audio/ogg", "audio-x-generic", ContentHubType::Music},
+    {"ogg", "audio/ogg", "audio-x-generic", ContentHubType::Music},
+    {"opus", "audio/x-opus+ogg", "audio-x-generic", ContentHubType::Music},
+    {"orc", "audio/csound", "audio-x-generic", ContentHubType::Music},
+    {"pls", "audio/x-scpls", "audio-x-generic", ContentHubType::Music},
+    {"ra", "audio/vnd.rn-realaudio", "audio-x-generic", ContentHubType::Music},
+    {"ram", "audio/x-pn-realaudio", "audio-x-generic", ContentHubType::Music},
+    {"rm", "audio/x-pn-realaudio", "audio-x-generic", ContentHubType::Music},
+    {"sco", "audio/csound", "audio-x-generic", ContentHubType::Music},
+    {"sd2", "audio/x-sd2", "audio-x-generic", ContentHubType::Music},
+    {"sid", "audio/prs.sid", "audio-x-generic", ContentHubType::Music},
+    {"snd", "audio/basic", "audio-x-generic", ContentHubType::Music},
+    {"spx", "audio/x-speex", "audio-x-generic", ContentHubType::Music},
+    {"wav", "audio/x-wav", "audio-x-generic", ContentHubType::Music},
+    {"wax", "audio/x-ms-asx", "audio-x-generic", ContentHubType::Music},
+    {"wma", "audio/x-ms-wma", "audio-x-generic", ContentHubType::Music},
+    {"aac", "audio/aac", "audio-x-generic", ContentHubType::Music},
+    {"m4b", "audio/x-m4b", "audio-x-generic", ContentHubType::Music},
+
+    // contacts
+    {"vcard", "text/vcard", "x-office-address-book", ContentHubType::Contacts},
+    {"vcf", "text/vcard", "x-office-address-book", ContentHubType::Contacts},
+
+    // documents
+    {"323", "text/plain", "text-x-generic", ContentHubType::Documents},
+    {"appcache", "text/cache-manifest", "text-x-generic", ContentHubType::Documents},
+    {"asc", "application/pgp-signature", "text-x-generic", ContentHubType::Documents},
+    {"bib", "text/x-bibtex", "text-x-generic", ContentHubType::Documents},
+    {"boo", "text/x-boo", "text-x-generic", ContentHubType::Documents},
+    {"brf", "text/plain", "text-x-generic", ContentHubType::Documents},
+    {"c", "text/x-csrc", "text-x-generic", ContentHubType::Documents},
+    {"c++", "text/x-c++src", "text-x-generic", ContentHubType::Documents},
+    {"cc", "text/x-c++src", "text-x-generic", ContentHubType::Documents},
+    {"cls", "text/x-tex", "text-x-generic", ContentHubType::Documents},
+    {"cpp", "text/x-c++src", "text-x-generic", ContentHubType::Documents},
+    {"csh", "application/x-csh", "text-x-generic", ContentHubType::Documents},
+    {"css", "text/css", "text-x-generic", ContentHubType::Documents},
+    {"csv", "text/csv", "x-office-spreadsheet", ContentHubType::Documents},
+    {"cxx", "text/x-c++src", "text-x-generic", ContentHubType::Documents},
+    {"d", "text/x-dsrc", "text-x-generic", ContentHubType::Documents},
+    {"diff", "text/x-patch", "text-x-generic", ContentHubType::Documents},
+    {"doc", "application/msword", "x-office-document", ContentHubType::Documents},
+    {"docx", "application/vnd.openxmlformats-officedocument.wordprocessingml.document", "x-office-document", ContentHubType::Documents},
+    {"etx", "text/x-setext", "text-x-generic", ContentHubType::Documents},
+    {"gcd", "text/x-pcs-gcd", "text-x-generic", ContentHubType::Documents},
+    {"h", "text/x-chdr", "text-x-generic", ContentHubType::Documents},
+    {"hh", "text/x-c++hdr", "text-x-generic", ContentHubType::Documents},
+    {"h++", "text/x-c++hdr", "text-x-generic", ContentHubType::Documents},
+    {"hpp", "text/x-c++hdr", "text-x-generic", ContentHubType::Documents},
+    {"hs", "text/x-haskell", "text-x-generic", ContentHubType::Documents},
+    {"htc", "text/x-component", "text-x-generic", ContentHubType::Documents},
+    {"htm", "text/html", "text-html", ContentHubType::Documents},
+    {"html", "text/html", "text-html", ContentHubType::Documents},
+    {"hxx", "text/x-c++hdr", "text-x-generic", ContentHubType::Documents},
+    {"ics", "text/calendar", "x-office-calendar", ContentHubType::Documents},
+    {"icz", "text/plain", "x-office-calendar", ContentHubType::Documents},
+    {"jad", "text/vnd.sun.j2me.app-descriptor", "text-x-generic", ContentHubType::Documents},
+    {"java", "text/x-java", "text-x-generic", ContentHubType::Documents},
+    {"lhs", "text/x-literate-haskell", "text-x-generic", ContentHubType::Documents},
+    {"ltx", "text/x-tex", "text-x-generic", ContentHubType::Documents},
+    {"ly", "text/x-lilypond", "text-x-generic", ContentHubType::Documents},
+    {"mml", "application/mathml+xml", "text-x-generic", ContentHubType::Documents},
+    {"moc", "text/x-moc", "text-x-generic", ContentHubType::Documents},
+    {"odp", "application/vnd.oasis.opendocument.presentation", "x-office-presentation", ContentHubType::Documents},
+    {"ods", "application/vnd.oasis.opendocument.spreadsheet", "x-office-spreadsheet", ContentHubType::Documents},
+    {"odt", "application/vnd.oasis.opendocument.text", "x-office-document", ContentHubType::Documents},
+    {"p", "text/x-pascal", "text-x-generic", ContentHubType::Documents},
+    {"pas", "text/x-pascal", "text-x-generic", ContentHubType::Documents},
+    {"patch", "text/x-patch", "text-x-generic", ContentHubType::Documents},
+    {"pdf", "application/pdf", "application-pdf", ContentHubType::Documents},
+    {"pl", "application/x-perl", "text-x-generic", ContentHubType::Documents},
+    {"pm", "application/x-pagemaker", "text-x-generic", ContentHubType::Documents},
+    {"pot", "text/x-gettext-translation-template", "text-x-generic", ContentHubType::Documents},
+    {"ppt", "application/vnd.ms-powerpoint", "x-office-presentation", ContentHubType::Documents},
+    {"pptx", "application/vnd.openxmlformats-officedocument.presentationml.presentation", "x-office-presentation", ContentHubType::Documents},
+    {"py", "text/x-python3", "text-x-generic", ContentHubType::Documents},
+    {"rtx", "text/richtext", "text-x-generic", ContentHubType::Documents},
+    {"scala", "text/x-scala", "text-x-generic", ContentHubType::Documents},
+    {"sct", "text/plain", "text-x-generic", ContentHubType::Documents},
+    {"sfv", "text/x-sfv", "text-x-generic", ContentHubType::Documents},
+    {"sh", "application/x-shellscript", "text-x-generic", ContentHubType::Documents},
+    {"shtml", "text/html", "text-html", ContentHubType::Documents},
+    {"srt", "application/x-subrip", "text-x-generic", ContentHubType::Documents},
+    {"sty", "text/x-tex", "text-x-generic", ContentHubType::Documents},
+    {"tcl", "text/tcl", "text-x-generic", ContentHubType::Documents},
+    {"tex", "text/x-tex", "text-x-generic", ContentHubType::Documents},
+    {"text", "text/plain", "text-x-generic", ContentHubType::Documents},
+    {"tk", "text/tcl", "text-x-generic", ContentHubType::Documents},
+    {"tm", "text/texmacs", "text-x-generic", ContentHubType::Documents},
+    {"tsv", "text/tab-separated-values", "x-office-spreadsheet", ContentHubType::Documents},
+    {"ttl", "text/turtle", "text-x-generic", ContentHubType::Documents},
+    {"txt", "text/plain", "text-x-generic", ContentHubType::Documents},
+    {"uls", "text/plain", "text-x-generic", ContentHubType::Documents},
+    {"vcs", "text/calendar", "x-office-calendar", ContentHubType::Documents},
+    {"wml", "text/vnd.wap.wml", "text-x-generic", ContentHubType::Documents},
+    {"wmls", "text/vnd.wap.wmlscript", "text-x-generic", ContentHubType::Documents},
+    {"wsc", "application/x-wonderswan-color-rom", "text-x-generic", ContentHubType::Documents},
+    {"xls", "application/vnd.ms-excel", "x-office-spreadsheet", ContentHubType::Documents},
+    {"xlsx", "application/vnd.openxmlformats-officedocument.spreadsheetml.sheet", "x-office-spreadsheet", ContentHubType::Documents},
+    {"json", "application/json", "text-x-generic", ContentHubType::Documents},
+    {"xml", "application/xml", "text-x-generic", ContentHubType::Documents},
+    {"md", "text/markdown", "text-x-generic", ContentHubType::Documents},
+    {"log", "text/x-log", "text-x-generic", ContentHubType::Documents},
+    {"ini", "text/plain", "text-x-generic", ContentHubType::Documents},
+    {"conf", "text/plain", "text-x-generic", ContentHubType::Documents},
+    {"yaml", "application/x-yaml", "text-x-generic", ContentHubType::Documents},
+    {"yml", "application/x-yaml", "text-x-generic", ContentHubType::Documents},
+    {"rtf", "application/rtf", "x-office-document", ContentHubType::Documents},
+    {"odg", "application/vnd.oasis.opendocument.graphics", "x-office-drawing", ContentHubType::Documents},
+
+    // e-books
+    {"epub", "application/epub+zip", "x-office-document", ContentHubType::EBooks},
+    {"mobi", "application/x-mobipocket-ebook", "x-office-document", ContentHubType::EBooks},
+    {"lit", "application/x-lit", "x-office-document", ContentHubType::EBooks},
+    {"fb2", "application/x-fictionbook+xml", "x-office-document", ContentHubType::EBooks},
+    {"azw", "application/x-azw", "x-office-document", ContentHubType::EBooks},
+    {"tpz", "application/x-tpz", "x-office-document", ContentHubType::EBooks},
+
+    // archives and packages, nothing the Content Hub takes
+    {"zip", "application/zip", "package-x-generic", ContentHubType::Unknown},
+    {"apk", "application/vnd.android.package-archive", "package-x-generic", ContentHubType::Unknown},
+    {"jar", "application/x-java-archive", "package-x-generic", ContentHubType::Unknown},
+    {"aar", "application/x-aar", "package-x-generic", ContentHubType::Unknown},
+    {"cbz", "application/vnd.comicbook+zip", "package-x-generic", ContentHubType::Unknown},
+    {"tar", "application/x-tar", "package-x-generic", ContentHubType::Unknown},
+    {"gz", "application/gzip", "package-x-generic", ContentHubType::Unknown},
+    {"tgz", "application/x-compressed-tar", "package-x-generic", ContentHubType::Unknown},
+    {"bz2", "application/x-bzip", "package-x-generic", ContentHubType::Unknown},
+    {"xz", "application/x-xz", "package-x-generic", ContentHubType::Unknown},
+    {"7z", "application/x-7z-compressed", "package-x-generic", ContentHubType::Unknown},
+    {"rar", "application/vnd.rar", "package-x-generic", ContentHubType::Unknown},
+    {"zst", "application/zstd", "package-x-generic", ContentHubType::Unknown},
+};
+constexpr size_t typeCount = std::size(types);
+
+constexpr size_t maxExtensionLength = [] {
+    size_t length = 0;
+    for(const auto& type : types) {
+        length = std::max(length, type.extension.size());
+    }
+    return length;
+}();
+
+constexpr uint32_t fnv1a(std::string_view s) {
+    uint32_t hash = 2166136261u;
+    for(char c : s) {
+        hash ^= static_cast<uint8_t>(c);
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+// murmur3's finalizer, spreads the displaced hash over all slots
+constexpr uint32_t mix(uint32_t hash) {
+    hash ^= hash >> 16;
+    hash *= 0x85ebca6bu;
+    hash ^= hash >> 13;
+    hash *= 0xc2b2ae35u;
+    hash ^= hash >> 16;
+    return hash;
+}
+
+// Hash-and-displace: every key falls into a bucket by its hash, and each bucket gets its own displacement,
+// chosen so that its keys land in slots nobody else uses. About twice as many slots as keys keeps the search short.
+constexpr size_t bucketCount = 64;
+constexpr size_t slotCount = 512;
+constexpr uint8_t emptySlot = 0xff;
+static_assert(typeCount < emptySlot, "slot indices are stored in a byte");
+
+struct PerfectHash {
+    std::array<uint16_t, bucketCount> displacement{};
+    std::array<uint8_t, slotCount> slots{};
+};
+
+constexpr size_t slotFor(uint32_t hash, uint16_t displacement) {
+    return mix(hash ^ (uint32_t{displacement} * 0x9e3779b9u)) % slotCount;
+}
+
+constexpr PerfectHash buildPerfectHash() {
+    PerfectHash result{};
+    result.slots.fill(emptySlot);
+
+    std::array<uint32_t, typeCount> hashes{};
+    std::array<size_t, bucketCount> bucketSizes{};
+    for(size_t i = 0; i < typeCount; i++) {
+        hashes[i] = fnv1a(types[i].extension);
+        bucketSizes[hashes[i] % bucketCount]++;
+    }
+
+    // the biggest buckets are the hardest to place, so they go first while the table is still empty
+    std::array<size_t, bucketCount> order{};
+    for(size_t i = 0; i < bucketCount; i++) {
+        order[i] = i;
+    }
+    std::sort(order.begin(), order.end(), [&](size_t a, size_t b) { return bucketSizes[a] > bucketSizes[b]; });
+
+    for(size_t bucket : order) {
+        if(bucketSizes[bucket] == 0) {
+            break;
+        }
+        for(uint32_t displacement = 0;; displacement++) {
+            if(displacement > 0xffff) {
+                throw "no displacement found, is an extension in the table twice?";
+            }
+
+            std::array<size_t, typeCount> taken{};
+            size_t takenCount = 0;
+            bool fits = true;
+            for(size_t i = 0; i < typeCount && fits; i++) {
+                if(hashes[i] % bucketCount != bucket) {
+                    continue;
+                }
+                size_t slot = slotFor(hashes[i], static_cast<uint16_t>(displacement));
+                fits = result.slots[slot] == emptySlot && std::find(taken.begin(), taken.begin() + takenCount, slot) == taken.begin() + takenCount;
+                taken[takenCount++] = slot;
+            }
+            if(!fits) {
+                continue;
+            }
+
+            result.displacement[bucket] = static_cast<uint16_t>(displacement);
+            for(size_t i = 0; i < typeCount; i++) {
+                if(hashes[i] % bucketCount == bucket) {
+                    result.slots[slotFor(hashes[i], result.displacement[bucket])] = static_cast<uint8_t>(i);
+                }
+            }
+            break;
+        }
+    }
+    return result;
+}
+
+constexpr PerfectHash perfectHash = buildPerfectHash();
+
+constexpr const ADBFileTypes::Type* lookup(std::string_view extension) {
+    uint32_t hash = fnv1a(extension);
+    uint8_t index = perfectHash.slots[slotFor(hash, perfectHash.displacement[hash % bucketCount])];
+    return index != emptySlot && types[index].extension == extension ? &types[index] : nullptr;
+}
+
+static_assert([] {
+    for(const auto& type : types) {
+        if(lookup(type.extension) != &type) {
+            return false;
+        }
+    }
+    return true;
+}(), "every extension must be found in the perfect hash");
+
+struct Signature {
+    std::string_view extension;
+    size_t offset;
+    std::string_view magic;
+    // some formats are only told apart by a second field, like the RIFF containers
+    size_t secondOffset = 0;
+    std::string_view secondMagic{};
+};
+
+// the more specific signatures come first, they share prefixes with the generic ones after them
+constexpr Signature signatures[] = {
+    {"png", 0, "\x89PNG\r\n\x1a\n"sv},
+    {"jpg", 0, "\xff\xd8\xff"sv},
+    {"gif", 0, "GIF87a"sv},
+    {"gif", 0, "GIF89a"sv},
+    {"webp", 0, "RIFF"sv, 8, "WEBP"sv},
+    {"wav", 0, "RIFF"sv, 8, "WAVE"sv},
+    {"avi", 0, "RIFF"sv, 8, "AVI "sv},
+    {"tif", 0, "II*\0"sv},
+    {"tif", 0, "MM\0*"sv},
+    {"heic", 4, "ftypheic"sv},
+    {"heic", 4, "ftypheix"sv},
+    {"heif", 4, "ftypmif1"sv},
+    {"avif", 4, "ftypavif"sv},
+    {"m4a", 4, "ftypM4A "sv},
+    {"mov", 4, "ftypqt  "sv},
+    {"3gp", 4, "ftyp3gp"sv},
+    {"mp4", 4, "ftyp"sv},
+    {"mkv", 0, "\x1a\x45\xdf\xa3"sv},
+    {"ogg", 0, "OggS"sv},
+    {"flac", 0, "fLaC"sv},
+    {"mp3", 0, "ID3"sv},
+    {"mp3", 0, "\xff\xfb"sv},
+    {"mp3", 0, "\xff\xf3"sv},
+    {"mp3", 0, "\xff\xf2"sv},
+    {"mid", 0, "MThd"sv},
+    {"pdf", 0, "%PDF-"sv},
+    {"rtf", 0, "{\\rtf"sv},
+    {"vcf", 0, "BEGIN:VCARD"sv},
+    {"ics", 0, "BEGIN:VCALENDAR"sv},
+    {"html", 0, "<!DOCTYPE html"sv},
+    {"svg", 0, "<svg"sv},
+    {"xml", 0, "<?xml"sv},
+    {"sh", 0, "#!"sv},
+    {"epub", 0, "PK\x03\x04"sv, 30, "mimetypeapplication/epub+zip"sv},
+    {"zip", 0, "PK\x03\x04"sv},
+    {"7z", 0, "7z\xbc\xaf\x27\x1c"sv},
+    {"rar", 0, "Rar!\x1a\x07"sv},
+    {"gz", 0, "\x1f\x8b"sv},
+    {"bz2", 0, "BZh"sv},
+    {"xz", 0, "\xfd" "7zXZ\0"sv},
+    {"zst", 0, "\x28\xb5\x2f\xfd"sv},
+    {"tar", 257, "ustar"sv},
+    {"bmp", 0, "BM"sv},
+};
+
+static_assert([] {
+    for(const auto& signature : signatures) {
+        if(!lookup(signature.extension) || signature.offset + signature.magic.size() > ADBFileTypes::sniffLength ||
+            signature.secondOffset + signature.secondMagic.size() > ADBFileTypes::sniffLength) {
+            return false;
+        }
+    }
+    return true;
+}(), "every signature must name an extension from the table and fit into sniffLength");
+
+bool matches(const QByteArray& header, size_t offset, std::string_view magic) {
+    if(static_cast<size_t>(header.size()) < offset + magic.size()) {
+        return false;
+    }
+    return std::string_view{header.constData() + offset, magic.size()} == magic;
+}
+
+QString fromView(std::string_view s) {
+    return QString::fromLatin1(s.data(), static_cast<int>(s.size()));
+}
+
+}
+
+const ADBFileTypes::Type* ADBFileTypes::forExtension(QStringView extension) {
+    if(extension.isEmpty() || static_cast<size_t>(extension.size()) > maxExtensionLength) {
+        return nullptr;
+    }
+
+    char lower[maxExtensionLength];
+    for(qsizetype i = 0; i < extension.size(); i++) {
+        char16_t c = extension[i].unicode();
+        if(c >= 0x80) {
+            return nullptr;
+        }
+        lower[i] = static_cast<char>(c >= 'A' && c <= 'Z' ? c - 'A' + 'a' : c);
+    }
+    return lookup({lower, static_cast<size_t>(extension.size())});
+}
+
+const ADBFileTypes::Type* ADBFileTypes::forFileName(const QString& fileName) {
+    int dot = fileName.lastIndexOf('.');
+    return dot < 0 ? nullptr : forExtension(QStringView{fileName}.mid(dot + 1));
+}
+
+const ADBFileTypes::Type* ADBFileTypes::sniff(const QByteArray& header) {
+    for(const auto& signature : signatures) {
+        if(matches(header, signature.offset, signature.magic) &&
+            (signature.secondMagic.empty() || matches(header, signature.secondOffset, signature.secondMagic))) {
+            return lookup(signature.extension);
+        }
+    }
+    return nullptr;
+}
+
+QString ADBFileTypes::mimeTypeName(const Type* type) {
+    return type ? fromView(type->mimeType) : QString{};
+}
+
+QString ADBFileTypes::iconName(const Type* type) {
+    return type ? fromView(type->iconName) : QString{};
+}
+
+QString ADBFileTypes::mimeType(const QString& fileName) const {
+    return mimeTypeName(forFileName(fileName));
+}
+
+QString ADBFileTypes::iconNameForFile(const QString& fileName) const {
+    return iconName(forFileName(fileName));
+}
+
+QString ADBFileTypes::contentType(const QString& fileName) const {
+    const Type* type = forFileName(fileName);
+    return QMetaEnum::fromType<ContentHubType>().valueToKey(type ? type->contentType : ContentHubType::Unknown);
+}
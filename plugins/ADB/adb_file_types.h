@@ -0,0 +1,70 @@
+/*
+ * Copyright (C) 2025  JCM
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * waydroid-files is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ADB_FILE_TYPES_H
+#define ADB_FILE_TYPES_H
+
+#include <string_view>
+
+#include <QByteArray>
+#include <QObject>
+#include <QString>
+
+// Classifies files by extension, and by their first bytes when the extension says nothing.
+// The extension table is turned into a perfect hash at compile time, so a lookup is one hash, one probe and one
+// compare, and the folder model, the thumbnails and the Content Hub export all agree on what a file is.
+class ADBFileTypes : public QObject {
+    Q_OBJECT
+
+public:
+    // same names as Lomiri.Content's ContentType, so QML can map them with CH.ContentType[name]
+    enum ContentHubType {
+        Unknown,
+        Documents,
+        Pictures,
+        Music,
+        Contacts,
+        Videos,
+        EBooks,
+    };
+    Q_ENUM(ContentHubType)
+
+    struct Type {
+        std::string_view extension;
+        std::string_view mimeType;
+        std::string_view iconName;
+        ContentHubType contentType;
+    };
+
+    // enough for every signature in the sniffing table, the furthest one is the tar magic at 257
+    static constexpr int sniffLength = 264;
+
+    // nullptr if the extension is not in the table
+    static const Type* forExtension(QStringView extension);
+    static const Type* forFileName(const QString& fileName);
+    // looks at the start of a file, nullptr if nothing matches
+    static const Type* sniff(const QByteArray& header);
+
+    static QString mimeTypeName(const Type* type);
+    static QString iconName(const Type* type);
+
+    Q_INVOKABLE QString mimeType(const QString& fileName) const;
+    Q_INVOKABLE QString iconNameForFile(const QString& fileName) const;
+    // name of the ContentType, "Unknown" for anything not in the table
+    Q_INVOKABLE QString contentType(const QString& fileName) const;
+};
+
+#endif
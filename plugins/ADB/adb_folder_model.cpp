@@ -16,15 +16,37 @@
 #include "adb_folder_model.h"
 
 #include <filesystem>
+#include <utility>
 
 #include <QDateTime>
 #include <QDebug>
-#include <QMimeDatabase>
-#include <QMimeType>
+#include <QDir>
+#include <QSet>
+#include <QTimer>
 
 #include <sys/stat.h>
 
+#include "adb_folder_watcher.h"
+#include "adb_listing_cache.h"
+#include "adb_snapshot.h"
+#include "adb_thumbnail_provider.h"
+#include "adb_trace.h"
+
 ADBFolderModel::ADBFolderModel() {
+    // writing the snapshot after every navigation would be wasted work when tapping through folders
+    m_snapshotTimer = new QTimer(this);
+    m_snapshotTimer->setSingleShot(true);
+    m_snapshotTimer->setInterval(1000);
+    connect(m_snapshotTimer, &QTimer::timeout, this, &ADBFolderModel::saveSnapshot);
+
+    // changes tend to come in bursts (a download being written, a batch of screenshots), patch them together
+    m_patchTimer = new QTimer(this);
+    m_patchTimer->setSingleShot(true);
+    m_patchTimer->setInterval(250);
+    connect(m_patchTimer, &QTimer::timeout, this, [this]() {
+        applyChanges();
+    });
+
     connect(this, &ADBFolderModel::basePathChanged, this, [this]() {
         m_history.clear();
         m_historyIndex = -1;
@@ -33,15 +55,12 @@ ADBFolderModel::ADBFolderModel() {
         emit currentPathChanged();
     });
     connect(this, &ADBFolderModel::currentPathChanged, this, [this]() {
-        m_selectedFile.clear();
-        emit selectedFileChanged();
-    });
-    connect(this, &ADBFolderModel::selectedFileChanged, this, [this]() {
-        qDebug() << "Selected file changed to" << m_selectedFile;
-        emit dataChanged(index(0, 0), index(rowCount({}) - 1, 0), {Roles::IsSelectedRole});
+        clearSelection();
     });
 }
 
+ADBFolderModel::~ADBFolderModel() = default;
+
 QHash<int, QByteArray> ADBFolderModel::roleNames() const {
     QHash<int, QByteArray> roles;
     roles[Roles::FileNameRole] = "fileName";
@@ -87,7 +106,7 @@ QVariant ADBFolderModel::data(const QModelIndex& index, int role) const {
         case Roles::IconNameRole:
             return iconName(entry);
         case Roles::FilePathRole:
-            return (m_currentPath.isEmpty() || m_currentPath.endsWith("/")) ? m_currentPath + entry.fileName : m_currentPath + "/" + entry.fileName;
+            return filePath(entry);
         case Roles::FilePathFullRole: {
             std::filesystem::path p = m_basePath.toStdString();
             p /= m_currentPath.toStdString();
@@ -95,10 +114,8 @@ QVariant ADBFolderModel::data(const QModelIndex& index, int role) const {
             p = std::filesystem::weakly_canonical(p);
             return QString::fromStdString(p.string());
         }
-        case Roles::MimeTypeRole: {
-            auto type = mimeType(entry);
-            return type.isValid() ? type.name() : QString{};
-        }
+        case Roles::MimeTypeRole:
+            return ADBFileTypes::mimeTypeName(fileType(entry));
         case Roles::ModifiedDateRole:
             return QDateTime::fromSecsSinceEpoch(entry.time);
         case Roles::FileSizeRole:
@@ -122,22 +139,25 @@ QVariant ADBFolderModel::data(const QModelIndex& index, int role) const {
                 return "other";
             }
         case Roles::IsSelectedRole:
-            return m_selectedFile == data(index, Roles::FilePathFullRole).toString();
+            return static_cast<size_t>(index.row()) < m_selection.size() && m_selection[static_cast<size_t>(index.row())];
         default:
             return {};
     }
 }
 
-QMimeType ADBFolderModel::mimeType(const ADBFileEntry& entry) const {
-    static QMimeDatabase mimeDb;
+QString ADBFolderModel::filePath(const ADBFileEntry& entry) const {
+    return (m_currentPath.isEmpty() || m_currentPath.endsWith("/")) ? m_currentPath + entry.fileName : m_currentPath + "/" + entry.fileName;
+}
 
-    auto types = mimeDb.mimeTypesForFileName(entry.fileName);
+QString ADBFolderModel::devicePath(const QString& name) const {
+    return m_basePath + "/" + filePath(ADBFileEntry{name, 0, 0, 0});
+}
 
-    if(!types.isEmpty()) {
-        return types.first();
-    } else {
-        return QMimeType{};
+const ADBFileTypes::Type* ADBFolderModel::fileType(const ADBFileEntry& entry) const {
+    if(const ADBFileTypes::Type* type = ADBFileTypes::forFileName(entry.fileName)) {
+        return type;
     }
+    return m_sniffedTypes.value(entry.fileName, nullptr);
 }
 
 QString ADBFolderModel::iconName(const ADBFileEntry& entry) const {
@@ -145,13 +165,13 @@ QString ADBFolderModel::iconName(const ADBFileEntry& entry) const {
     bool is_link = S_ISLNK(entry.mode);
     bool is_regular = S_ISREG(entry.mode);
 
-    auto type = mimeType(entry);
+    auto type = fileType(entry);
     if(is_dir) {
         return "folder";
     } else if(is_link) {
         return "emblem-symbolic-link";
-    } else if(type.isValid()) {
-        return type.iconName();
+    } else if(type) {
+        return ADBFileTypes::iconName(type);
     } else if(is_regular) {
         return "text-x-generic";
     } else {
@@ -159,7 +179,7 @@ QString ADBFolderModel::iconName(const ADBFileEntry& entry) const {
     }
 }
 
-QString ADBFolderModel::fileSize(qint64 size) const
+QString ADBFolderModel::fileSize(qint64 size)
 {
     struct UnitSizes {
         qint64      bytes;
@@ -190,7 +210,8 @@ QString ADBFolderModel::fileSize(qint64 size) const
 }
 
 QCoro::QmlTask ADBFolderModel::goTo(const QString& path) {
-    if(path != m_currentPath) {
+    bool refresh = path == m_currentPath;
+    if(!refresh) {
         if(m_historyIndex < (int)m_history.size() - 1) {
             m_history.erase(m_history.begin() + m_historyIndex + 1, m_history.end());
         }
@@ -200,7 +221,37 @@ QCoro::QmlTask ADBFolderModel::goTo(const QString& path) {
         m_currentPath = path;
         emit currentPathChanged();
     }
-    return updateFolder();
+    return updateFolder(!refresh);
+}
+
+void ADBFolderModel::setVisibleRange(int first, int last) {
+    first = std::max(first, 0);
+    last = last < 0 ? rowCount({}) - 1 : std::min(last, rowCount({}) - 1);
+
+    QSet<QString> paths{};
+    for(int row = first; row <= last; row++) {
+        paths.insert(filePath(m_entries.at(static_cast<size_t>(row))));
+    }
+    ADBThumbnailScheduler::instance()->setVisiblePaths(paths);
+
+    QStringList folders{};
+    for(int row = first; row <= last && folders.size() < maxPrefetchedFolders; row++) {
+        const ADBFileEntry& entry = m_entries.at(static_cast<size_t>(row));
+        if(S_ISDIR(entry.mode)) {
+            folders.append(m_basePath + "/" + filePath(entry));
+        }
+    }
+    prefetch(folders);
+
+    QStringList unknown{};
+    for(int row = first; row <= last && unknown.size() < maxSniffQueue; row++) {
+        const ADBFileEntry& entry = m_entries.at(static_cast<size_t>(row));
+        if(S_ISREG(entry.mode) && entry.size > 0 && !m_sniffedTypes.contains(entry.fileName) &&
+            !ADBFileTypes::forFileName(entry.fileName)) {
+            unknown.append(entry.fileName);
+        }
+    }
+    sniff(unknown);
 }
 
 QCoro::Task<void> nothing() {
@@ -213,7 +264,9 @@ QCoro::QmlTask ADBFolderModel::goBack() {
         m_currentPath = m_history.at(m_historyIndex);
         emit currentPathChanged();
 
-        return updateFolder();
+        // going back once makes going back further likely
+        QString parent = QDir::cleanPath(m_basePath + "/" + m_currentPath + "/..");
+        return updateFolder(true, {parent});
     }
     return nothing();
 }
@@ -228,30 +281,597 @@ QCoro::QmlTask ADBFolderModel::goForward() {
     return nothing();
 }
 
-QCoro::Task<void> ADBFolderModel::updateFolder() {
+QCoro::Task<void> ADBFolderModel::updateFolder(bool useCache, QStringList prefetchFirst) {
     if(!m_adbClient) {
         co_return;
     }
+    // latest wins: whatever an earlier navigation still has in flight is given up, and it will not touch the model
+    m_navigation.cancel();
+    m_navigation = ADBCancelToken{};
+    ADBCancelToken token = m_navigation;
 
-    beginResetModel();
-    m_entries = co_await m_adbClient->co_listFiles(m_basePath + "/" + m_currentPath);
-    m_entries.erase(std::remove_if(m_entries.begin(), m_entries.end(), [](const ADBFileEntry& entry) -> bool {
+    m_prefetchQueue.clear();
+    m_sniffQueue.clear();
+    m_sniffedTypes.clear();
+    m_watcher.reset();
+
+    QString path = m_basePath + "/" + m_currentPath;
+    auto cached = useCache ? m_adbClient->listingCache().lookup(path, maxListingAge) : std::nullopt;
+
+    // rows of the previous folder would show up under the new path while the listing is underway
+    if(!cached && path != m_listedPath) {
+        beginResetModel();
+        m_entries.clear();
+        resetSelection({});
+        m_listedPath = path;
+        endResetModel();
+    }
+
+    bool fromCache = cached.has_value();
+    std::vector<ADBFileEntry> entries = cached ? std::move(*cached) : co_await m_adbClient->co_listFiles(path, ADBIOScheduler::Priority::Interactive, token);
+    if(token.cancelled()) {
+        co_return;
+    }
+    m_listedPath = path;
+    setListing(std::move(entries));
+    m_snapshotTimer->start();
+    watchCurrentFolder();
+
+    // The watcher only sees what changes from now on, a cached listing can already be missing a photo saved since.
+    // It stays on screen for instant display until the device answered.
+    if(fromCache) {
+        revalidate(path, token);
+    }
+
+    // the top of the list is what is visible right after a reset, and folders are sorted first
+    QStringList folders = prefetchFirst;
+    for(const ADBFileEntry& entry : m_entries) {
+        if(!S_ISDIR(entry.mode) || folders.size() >= prefetchFirst.size() + maxPrefetchedFolders) {
+            break;
+        }
+        folders.append(m_basePath + "/" + filePath(entry));
+    }
+    prefetch(folders);
+    co_return;
+}
+
+QCoro::Task<void> ADBFolderModel::revalidate(QString path, ADBCancelToken token) {
+    std::vector<ADBFileEntry> entries = co_await m_adbClient->co_listFiles(path, ADBIOScheduler::Priority::Interactive, token);
+    // a folder always lists at least . and .., nothing at all means the listing failed
+    if(token.cancelled() || entries.empty() || path != m_listedPath) {
+        co_return;
+    }
+
+    // only reset the model if something changed, a reset loses the scroll position
+    QHash<QString, const ADBFileEntry*> shown{};
+    for(const ADBFileEntry& entry : m_entries) {
+        shown.insert(entry.fileName, &entry);
+    }
+    qsizetype listed = 0;
+    bool changed = false;
+    for(const ADBFileEntry& entry : entries) {
+        if(entry.fileName == "." || entry.fileName == "..") {
+            continue;
+        }
+        listed++;
+        const ADBFileEntry* old = shown.value(entry.fileName);
+        if(!old || old->mode != entry.mode || old->size != entry.size || old->time != entry.time) {
+            changed = true;
+            break;
+        }
+    }
+    if(changed || listed != shown.size()) {
+        setListing(std::move(entries));
+    }
+}
+
+void ADBFolderModel::setListing(std::vector<ADBFileEntry> entries) {
+    entries.erase(std::remove_if(entries.begin(), entries.end(), [](const ADBFileEntry& entry) -> bool {
         return entry.fileName == "." || entry.fileName == "..";
-    }), m_entries.end());
-    std::sort(m_entries.begin(), m_entries.end(), [](const ADBFileEntry& a, const ADBFileEntry& b) -> bool {
-        bool a_is_dir = S_ISDIR(a.mode);
-        bool b_is_dir = S_ISDIR(b.mode);
-        if(a_is_dir != b_is_dir) {
-            return a_is_dir > b_is_dir;
+    }), entries.end());
+    {
+        ADBTraceSpan sortSpan{"model", "sort", QString::number(entries.size()), false};
+        std::sort(entries.begin(), entries.end(), &ADBFolderModel::entryLessThan);
+    }
+
+    // reloading the same folder keeps what was selected, navigating cleared it already
+    QSet<QString> selected{};
+    for(const QString& name : selectedNames()) {
+        selected.insert(name);
+    }
+
+    ADBTraceSpan resetSpan{"model", "reset", m_currentPath};
+    beginResetModel();
+    m_entries = std::move(entries);
+    resetSelection(selected);
+    endResetModel();
+}
+
+bool ADBFolderModel::entryLessThan(const ADBFileEntry& a, const ADBFileEntry& b) {
+    bool a_is_dir = S_ISDIR(a.mode);
+    bool b_is_dir = S_ISDIR(b.mode);
+    if(a_is_dir != b_is_dir) {
+        return a_is_dir > b_is_dir;
+    }
+    bool a_is_regular = S_ISREG(a.mode);
+    bool b_is_regular = S_ISREG(b.mode);
+    if(a_is_regular != b_is_regular) {
+        return a_is_regular > b_is_regular;
+    }
+    return a.fileName.toLower() < b.fileName.toLower();
+}
+
+void ADBFolderModel::setWatching(bool watching) {
+    if(watching == m_watching) {
+        return;
+    }
+    m_watching = watching;
+    emit watchingChanged();
+    watchCurrentFolder();
+}
+
+void ADBFolderModel::watchCurrentFolder() {
+    m_watcher.reset();
+    m_pendingChanges.clear();
+    m_pendingRelist = false;
+    if(!m_watching || !m_adbClient || m_history.isEmpty()) {
+        return;
+    }
+
+    m_watcher = std::make_unique<ADBFolderWatcher>(m_adbClient, m_basePath + "/" + m_currentPath);
+    connect(m_watcher.get(), &ADBFolderWatcher::changed, this, &ADBFolderModel::folderChanged);
+}
+
+void ADBFolderModel::folderChanged(const QStringList& names) {
+    if(names.isEmpty()) {
+        m_pendingRelist = true;
+    }
+    for(const QString& name : names) {
+        m_pendingChanges.insert(name);
+    }
+    if(!m_patching) {
+        m_patchTimer->start();
+    }
+}
+
+QCoro::Task<void> ADBFolderModel::applyChanges() {
+    if(m_patching || !m_adbClient) {
+        co_return;
+    }
+    m_patching = true;
+
+    QString folder = m_basePath + "/" + m_currentPath;
+    // stop as soon as the user navigated away, the watcher of the new folder starts from a fresh listing anyway
+    while(m_watcher && m_watcher->path() == folder && (m_pendingRelist || !m_pendingChanges.isEmpty())) {
+        bool relist = m_pendingRelist || m_pendingChanges.size() > maxPatchedEntries;
+        QSet<QString> names = std::exchange(m_pendingChanges, {});
+        m_pendingRelist = false;
+
+        if(relist) {
+            std::vector<ADBFileEntry> entries = co_await m_adbClient->co_listFiles(folder);
+            // even an empty folder lists "." and "..", so nothing at all means the listing failed
+            if(entries.empty() || !m_watcher || m_watcher->path() != folder) {
+                continue;
+            }
+
+            QSet<QString> present{};
+            for(const ADBFileEntry& entry : entries) {
+                present.insert(entry.fileName);
+            }
+            for(int row = static_cast<int>(m_entries.size()) - 1; row >= 0; row--) {
+                if(!present.contains(m_entries.at(static_cast<size_t>(row)).fileName)) {
+                    removeEntry(row);
+                }
+            }
+            for(const ADBFileEntry& entry : entries) {
+                if(entry.fileName != "." && entry.fileName != "..") {
+                    patchEntry(entry.fileName, entry);
+                }
+            }
+        } else {
+            for(const QString& name : names) {
+                auto entry = co_await m_adbClient->co_stat(folder + "/" + name);
+                if(!m_watcher || m_watcher->path() != folder) {
+                    break;
+                }
+                // STAT does not fail for missing files, it reports them with mode 0
+                if(entry && entry->mode != 0) {
+                    entry->fileName = name;
+                    patchEntry(name, entry);
+                } else {
+                    patchEntry(name, std::nullopt);
+                }
+            }
+            m_adbClient->listingCache().invalidate(folder);
         }
-        bool a_is_regular = S_ISREG(a.mode);
-        bool b_is_regular = S_ISREG(b.mode);
-        if(a_is_regular != b_is_regular) {
-            return a_is_regular > b_is_regular;
+        m_snapshotTimer->start();
+    }
+
+    m_patching = false;
+}
+
+void ADBFolderModel::patchEntry(const QString& name, std::optional<ADBFileEntry> entry) {
+    m_sniffedTypes.remove(name);
+
+    int row = -1;
+    if(entry) {
+        auto it = std::lower_bound(m_entries.begin(), m_entries.end(), *entry, &ADBFolderModel::entryLessThan);
+        if(it != m_entries.end() && it->fileName == name) {
+            row = static_cast<int>(it - m_entries.begin());
         }
-        return a.fileName.toLower() < b.fileName.toLower();
-    });
+    }
+    if(row < 0) {
+        // the entry changed its type or only differs in case from a neighbour, so it is not where the new one would go
+        auto it = std::find_if(m_entries.begin(), m_entries.end(), [&name](const ADBFileEntry& e) {
+            return e.fileName == name;
+        });
+        if(it != m_entries.end()) {
+            row = static_cast<int>(it - m_entries.begin());
+        }
+    }
+
+    if(row >= 0) {
+        ADBFileEntry& existing = m_entries.at(static_cast<size_t>(row));
+        if(entry && (existing.mode & S_IFMT) == (entry->mode & S_IFMT)) {
+            if(existing.mode != entry->mode || existing.size != entry->size || existing.time != entry->time) {
+                existing = *entry;
+                emit dataChanged(index(row, 0), index(row, 0));
+            }
+            return;
+        }
+        removeEntry(row);
+    }
+
+    if(entry) {
+        insertEntry(std::lower_bound(m_entries.begin(), m_entries.end(), *entry, &ADBFolderModel::entryLessThan), *entry);
+    }
+}
+
+void ADBFolderModel::insertEntry(std::vector<ADBFileEntry>::iterator it, const ADBFileEntry& entry) {
+    int row = static_cast<int>(it - m_entries.begin());
+    beginInsertRows({}, row, row);
+    m_entries.insert(it, entry);
+    m_selection.insert(m_selection.begin() + row, false);
+    endInsertRows();
+}
+
+void ADBFolderModel::removeEntry(int row) {
+    bool selected = m_selection.at(static_cast<size_t>(row));
+    beginRemoveRows({}, row, row);
+    m_entries.erase(m_entries.begin() + row);
+    m_selection.erase(m_selection.begin() + row);
+    endRemoveRows();
+    if(selected) {
+        m_selectionCount--;
+        emit selectionChanged();
+    }
+}
 
+bool ADBFolderModel::restoreSnapshot() {
+    auto snapshot = ADBSnapshot::load(ADBSnapshot::defaultLocation());
+    if(!snapshot) {
+        return false;
+    }
+
+    m_deviceSerial = snapshot->deviceSerial;
+    emit deviceSerialChanged();
+    m_homePath = snapshot->homePath;
+    emit homePathChanged();
+
+    m_history = {snapshot->currentPath};
+    m_historyIndex = 0;
+    m_currentPath = snapshot->currentPath;
+
+    beginResetModel();
+    m_entries = std::move(snapshot->entries);
+    m_listedPath = m_basePath + "/" + m_currentPath; // stays on screen until the first listing replaces it
+    resetSelection();
     endResetModel();
-    co_return;
+
+    emit currentPathChanged();
+    return true;
+}
+
+void ADBFolderModel::saveSnapshot() {
+    ADBSnapshot snapshot{m_deviceSerial, m_homePath, m_currentPath, m_entries};
+    snapshot.save(ADBSnapshot::defaultLocation());
+}
+
+void ADBFolderModel::prefetch(QStringList paths) {
+    for(const QString& path : m_prefetchQueue) {
+        if(!paths.contains(path)) {
+            paths.append(path);
+        }
+    }
+    m_prefetchQueue = paths.mid(0, maxPrefetchQueue);
+
+    if(!m_prefetching) {
+        runPrefetch();
+    }
+}
+
+QCoro::Task<void> ADBFolderModel::runPrefetch() {
+    // one listing at a time, so prefetching never takes more than a single pooled session away from the user
+    m_prefetching = true;
+    while(m_adbClient && !m_prefetchQueue.isEmpty()) {
+        QString path = m_prefetchQueue.takeFirst();
+        if(m_adbClient->listingCache().contains(path, maxListingAge / 2)) {
+            continue;
+        }
+        // stores the result in the listing cache, and gives up once the user navigates elsewhere
+        co_await m_adbClient->co_listFiles(path, ADBIOScheduler::Priority::Bulk, m_navigation);
+    }
+    m_prefetching = false;
+}
+
+void ADBFolderModel::sniff(QStringList names) {
+    m_sniffQueue = names.mid(0, maxSniffQueue);
+    if(!m_sniffing) {
+        runSniff();
+    }
+}
+
+QCoro::Task<void> ADBFolderModel::runSniff() {
+    m_sniffing = true;
+    while(m_adbClient && !m_sniffQueue.isEmpty()) {
+        QString name = m_sniffQueue.takeFirst();
+        if(m_sniffedTypes.contains(name)) {
+            continue;
+        }
+
+        QString folder = m_currentPath;
+        auto header = co_await m_adbClient->co_readRange(devicePath(name), 0, ADBFileTypes::sniffLength);
+        if(folder != m_currentPath) {
+            continue; // the queue now holds the files of the new folder
+        }
+
+        const ADBFileTypes::Type* type = header ? ADBFileTypes::sniff(*header) : nullptr;
+        m_sniffedTypes.insert(name, type);
+        auto it = std::find_if(m_entries.begin(), m_entries.end(), [&name](const ADBFileEntry& e) {
+            return e.fileName == name;
+        });
+        if(type && it != m_entries.end()) {
+            int row = static_cast<int>(it - m_entries.begin());
+            emit dataChanged(index(row, 0), index(row, 0), {Roles::IconNameRole, Roles::MimeTypeRole});
+        }
+    }
+    m_sniffing = false;
+}
+
+QCoro::QmlTask ADBFolderModel::removeFiles(const QStringList& names) {
+    return co_removeFiles(names);
+}
+QCoro::QmlTask ADBFolderModel::moveFiles(const QStringList& names, const QString& destination) {
+    return co_moveFiles(names, destination);
+}
+QCoro::QmlTask ADBFolderModel::renameFile(const QString& name, const QString& newName) {
+    return co_renameFile(name, newName);
+}
+QCoro::QmlTask ADBFolderModel::makeDirectory(const QString& name) {
+    return co_makeDirectory(name);
+}
+QCoro::QmlTask ADBFolderModel::setPermissions(const QStringList& names, int mode) {
+    return co_setPermissions(names, mode);
+}
+
+QVariantMap ADBFolderModel::applyResults(const QString& folder, const QStringList& names, const std::vector<ADBFileOperationResult>& results, bool removed) {
+    QStringList failed{};
+    QStringList errors{};
+    for(size_t i = 0; i < results.size(); i++) {
+        const ADBFileOperationResult& result = results.at(i);
+        const QString& name = names.at(static_cast<int>(i));
+        if(!result.ok) {
+            failed.append(name);
+            errors.append(result.error);
+        } else if(folder != m_currentPath) {
+            // navigated away in the meantime, the listing cache was invalidated for the next visit
+        } else if(removed) {
+            patchEntry(name, std::nullopt);
+        } else if(result.entry) {
+            patchEntry(result.entry->fileName, result.entry);
+        }
+    }
+    return QVariantMap{{"failed", failed}, {"errors", errors}};
+}
+
+QCoro::Task<QVariantMap> ADBFolderModel::co_removeFiles(QStringList names) {
+    if(!m_adbClient) {
+        co_return QVariantMap{};
+    }
+    QString folder = m_currentPath;
+    QStringList paths{};
+    for(const QString& name : names) {
+        paths.append(devicePath(name));
+    }
+    auto results = co_await m_adbClient->co_removeFiles(paths);
+    co_return applyResults(folder, names, results, true);
+}
+
+QCoro::Task<QVariantMap> ADBFolderModel::co_moveFiles(QStringList names, QString destination) {
+    if(!m_adbClient) {
+        co_return QVariantMap{};
+    }
+    QString folder = m_currentPath;
+    QStringList paths{};
+    for(const QString& name : names) {
+        paths.append(devicePath(name));
+    }
+    auto results = co_await m_adbClient->co_moveFiles(paths, m_basePath + "/" + destination);
+    co_return applyResults(folder, names, results, true);
+}
+
+QCoro::Task<QVariantMap> ADBFolderModel::co_renameFile(QString name, QString newName) {
+    if(!m_adbClient) {
+        co_return QVariantMap{};
+    }
+    QString folder = m_currentPath;
+    auto result = co_await m_adbClient->co_rename(devicePath(name), devicePath(newName));
+    if(result.ok && folder == m_currentPath) {
+        patchEntry(name, std::nullopt);
+    }
+    co_return applyResults(folder, {newName}, {result}, false);
+}
+
+QCoro::Task<QVariantMap> ADBFolderModel::co_makeDirectory(QString name) {
+    if(!m_adbClient) {
+        co_return QVariantMap{};
+    }
+    QString folder = m_currentPath;
+    auto result = co_await m_adbClient->co_makeDirectory(devicePath(name));
+    co_return applyResults(folder, {name}, {result}, false);
+}
+
+QCoro::Task<QVariantMap> ADBFolderModel::co_setPermissions(QStringList names, int mode) {
+    if(!m_adbClient) {
+        co_return QVariantMap{};
+    }
+    QString folder = m_currentPath;
+    QStringList paths{};
+    for(const QString& name : names) {
+        paths.append(devicePath(name));
+    }
+    auto results = co_await m_adbClient->co_setMode(paths, static_cast<mode_t>(mode));
+    co_return applyResults(folder, names, results, false);
+}
+
+void ADBFolderModel::resetSelection(const QSet<QString>& keep) {
+    int before = m_selectionCount;
+    m_selection.assign(m_entries.size(), false);
+    m_selectionCount = 0;
+    if(!keep.isEmpty()) {
+        for(size_t row = 0; row < m_entries.size(); row++) {
+            if(keep.contains(m_entries.at(row).fileName)) {
+                m_selection[row] = true;
+                m_selectionCount++;
+            }
+        }
+    }
+    if(before != 0 || m_selectionCount != 0) {
+        emit selectionChanged();
+    }
+}
+
+void ADBFolderModel::emitSelectionChanged(int first, int last) {
+    emit dataChanged(index(first, 0), index(last, 0), {Roles::IsSelectedRole});
+}
+
+void ADBFolderModel::setSelected(int row, bool selected) {
+    selectRange(row, row, selected);
+}
+
+void ADBFolderModel::toggleSelected(int row) {
+    if(row >= 0 && row < rowCount({})) {
+        setSelected(row, !m_selection[static_cast<size_t>(row)]);
+    }
+}
+
+void ADBFolderModel::selectRange(int first, int last, bool selected) {
+    first = std::max(first, 0);
+    last = std::min(last, rowCount({}) - 1);
+
+    // signal each run of rows that actually changed, not the whole range
+    int runStart = -1;
+    int before = m_selectionCount;
+    for(int row = first; row <= last; row++) {
+        bool changed = m_selection[static_cast<size_t>(row)] != selected;
+        if(changed) {
+            m_selection[static_cast<size_t>(row)] = selected;
+            m_selectionCount += selected ? 1 : -1;
+            if(runStart < 0) {
+                runStart = row;
+            }
+        } else if(runStart >= 0) {
+            emitSelectionChanged(runStart, row - 1);
+            runStart = -1;
+        }
+    }
+    if(runStart >= 0) {
+        emitSelectionChanged(runStart, last);
+    }
+    if(m_selectionCount != before) {
+        emit selectionChanged();
+    }
+}
+
+void ADBFolderModel::selectAll() {
+    // whole words at a time, views only update the delegates that exist
+    if(m_selectionCount == rowCount({})) {
+        return;
+    }
+    m_selection.assign(m_entries.size(), true);
+    m_selectionCount = rowCount({});
+    emitSelectionChanged(0, rowCount({}) - 1);
+    emit selectionChanged();
+}
+
+void ADBFolderModel::clearSelection() {
+    if(m_selectionCount == 0) {
+        return;
+    }
+    m_selection.assign(m_entries.size(), false);
+    m_selectionCount = 0;
+    emitSelectionChanged(0, rowCount({}) - 1);
+    emit selectionChanged();
+}
+
+void ADBFolderModel::invertSelection() {
+    if(m_entries.empty()) {
+        return;
+    }
+    m_selection.flip();
+    m_selectionCount = rowCount({}) - m_selectionCount;
+    emitSelectionChanged(0, rowCount({}) - 1);
+    emit selectionChanged();
+}
+
+QStringList ADBFolderModel::selectedNames() const {
+    QStringList names{};
+    if(m_selectionCount == 0) {
+        return names;
+    }
+    names.reserve(m_selectionCount);
+    for(size_t row = 0; row < m_selection.size() && row < m_entries.size(); row++) {
+        if(m_selection[row]) {
+            names.append(m_entries.at(row).fileName);
+        }
+    }
+    return names;
+}
+
+QString ADBFolderModel::selectedFile() const {
+    if(m_selectionCount != 1) {
+        return QString{};
+    }
+    auto it = std::find(m_selection.begin(), m_selection.end(), true);
+    int row = static_cast<int>(it - m_selection.begin());
+    return data(index(row, 0), Roles::FilePathFullRole).toString();
+}
+
+void ADBFolderModel::setSelectedFile(const QString& path) {
+    int row = -1;
+    if(!path.isEmpty()) {
+        for(int i = 0; i < rowCount({}); i++) {
+            if(data(index(i, 0), Roles::FilePathFullRole).toString() == path) {
+                row = i;
+                break;
+            }
+        }
+    }
+    if(row >= 0 && m_selectionCount == 1 && m_selection[static_cast<size_t>(row)]) {
+        return;
+    }
+    clearSelection();
+    if(row >= 0) {
+        setSelected(row, true);
+    }
+}
+
+QCoro::QmlTask ADBFolderModel::removeSelected() {
+    return co_removeFiles(selectedNames());
+}
+QCoro::QmlTask ADBFolderModel::moveSelected(const QString& destination) {
+    return co_moveFiles(selectedNames(), destination);
+}
+QCoro::QmlTask ADBFolderModel::setSelectedPermissions(int mode) {
+    return co_setPermissions(selectedNames(), mode);
 }
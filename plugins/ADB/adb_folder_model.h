@@ -17,13 +17,20 @@
 #ifndef ADB_FOLDER_MODEL_H
 #define ADB_FOLDER_MODEL_H
 
+#include <memory>
+
 #include <QAbstractListModel>
-#include <QMimeType>
+#include <QHash>
 #include <QObject>
+#include <QSet>
 
 #include <QCoro/QCoroQmlTask>
 
 #include "adb_client.h"
+#include "adb_file_types.h"
+
+class ADBFolderWatcher;
+class QTimer;
 
 class ADBFolderModel : public QAbstractListModel {
     Q_OBJECT
@@ -48,7 +55,7 @@ class ADBFolderModel : public QAbstractListModel {
 
 public:
     ADBFolderModel();
-    ~ADBFolderModel() = default;
+    ~ADBFolderModel();
 
     Q_PROPERTY(ADBClient* adbClient MEMBER m_adbClient)
     Q_PROPERTY(QString basePath MEMBER m_basePath NOTIFY basePathChanged)
@@ -57,11 +64,44 @@ public:
     Q_PROPERTY(bool canGoBack READ canGoBack NOTIFY currentPathChanged)
     Q_PROPERTY(bool canGoForward READ canGoForward NOTIFY currentPathChanged)
 
-    Q_PROPERTY(QString selectedFile MEMBER m_selectedFile NOTIFY selectedFileChanged)
+    // full path of the only selected entry, empty unless exactly one is selected; setting it selects just that entry
+    Q_PROPERTY(QString selectedFile READ selectedFile WRITE setSelectedFile NOTIFY selectionChanged)
+    Q_PROPERTY(int selectionCount READ selectionCount NOTIFY selectionChanged)
+
+    Q_PROPERTY(QString deviceSerial MEMBER m_deviceSerial NOTIFY deviceSerialChanged)
+    Q_PROPERTY(QString homePath MEMBER m_homePath NOTIFY homePathChanged)
+
+    // keep the current folder up to date with changes made on the device
+    Q_PROPERTY(bool watching READ watching WRITE setWatching NOTIFY watchingChanged)
 
     Q_INVOKABLE QCoro::QmlTask goTo(const QString& path);
     Q_INVOKABLE QCoro::QmlTask goBack();
     Q_INVOKABLE QCoro::QmlTask goForward();
+    Q_INVOKABLE void setVisibleRange(int first, int last);
+    Q_INVOKABLE bool restoreSnapshot();
+
+    // File management on entries of the current folder, by name. The rows are patched with the results instead of
+    // listing the folder again. Each resolves to a map with the "failed" names and their "errors".
+    Q_INVOKABLE QCoro::QmlTask removeFiles(const QStringList& names);
+    // destination is a folder relative to basePath, like currentPath
+    Q_INVOKABLE QCoro::QmlTask moveFiles(const QStringList& names, const QString& destination);
+    Q_INVOKABLE QCoro::QmlTask renameFile(const QString& name, const QString& newName);
+    Q_INVOKABLE QCoro::QmlTask makeDirectory(const QString& name);
+    Q_INVOKABLE QCoro::QmlTask setPermissions(const QStringList& names, int mode);
+
+    // Selection by row, one bit per entry. Only rows whose state changed are signalled.
+    Q_INVOKABLE void setSelected(int row, bool selected);
+    Q_INVOKABLE void toggleSelected(int row);
+    Q_INVOKABLE void selectRange(int first, int last, bool selected = true);
+    Q_INVOKABLE void selectAll();
+    Q_INVOKABLE void clearSelection();
+    Q_INVOKABLE void invertSelection();
+    Q_INVOKABLE QStringList selectedNames() const;
+
+    // the batch operations above, applied to the selection
+    Q_INVOKABLE QCoro::QmlTask removeSelected();
+    Q_INVOKABLE QCoro::QmlTask moveSelected(const QString& destination);
+    Q_INVOKABLE QCoro::QmlTask setSelectedPermissions(int mode);
 
     const QString& currentPath() const { return m_currentPath; }
 
@@ -69,18 +109,37 @@ public:
     int rowCount(const QModelIndex& parent) const override;
     QVariant data(const QModelIndex& index, int role) const override;
 
-    QMimeType mimeType(const ADBFileEntry& entry) const;
+    QString filePath(const ADBFileEntry& entry) const;
+    // full path on the device of an entry in the current folder
+    QString devicePath(const QString& name) const;
+    const ADBFileTypes::Type* fileType(const ADBFileEntry& entry) const;
     QString iconName(const ADBFileEntry& entry) const;
-    QString fileSize(qint64 size) const;
+    static QString fileSize(qint64 size);
+    // folders first, then regular files, then everything else, each by name without regard to case
+    static bool entryLessThan(const ADBFileEntry& a, const ADBFileEntry& b);
+
+    // Replaces the rows with a listing of the current folder: drops "." and "..", sorts, and keeps the selection
+    // by name. Where every updateFolder ends, and how the model benchmark feeds in synthetic listings.
+    void setListing(std::vector<ADBFileEntry> entries);
+
+    QString selectedFile() const;
+    void setSelectedFile(const QString& path);
+    int selectionCount() const { return m_selectionCount; }
+
+    bool watching() const { return m_watching; }
+    void setWatching(bool watching);
 
     bool canGoBack() const { return m_historyIndex > 0; }
     bool canGoForward() const { return m_historyIndex < (m_history.size()-1); }
 signals:
     void currentPathChanged();
     void basePathChanged();
-    void selectedFileChanged();
+    void selectionChanged();
+    void deviceSerialChanged();
+    void homePathChanged();
+    void watchingChanged();
 private:
-    ADBClient* m_adbClient;
+    ADBClient* m_adbClient = nullptr;
     QString m_basePath = "/";
 
     QString m_currentPath = "";
@@ -89,9 +148,64 @@ private:
     QStringList m_history{};
     int m_historyIndex = -1;
 
-    QString m_selectedFile;
-
-    QCoro::Task<void> updateFolder();
+    // always as long as m_entries, rows are inserted and removed together with the entries
+    std::vector<bool> m_selection{};
+    int m_selectionCount = 0;
+    void resetSelection(const QSet<QString>& keep = {});
+    void emitSelectionChanged(int first, int last);
+    void insertEntry(std::vector<ADBFileEntry>::iterator it, const ADBFileEntry& entry);
+    void removeEntry(int row);
+
+    QString m_deviceSerial;
+    QString m_homePath;
+    QTimer* m_snapshotTimer;
+    void saveSnapshot();
+
+    static constexpr qint64 maxListingAge = 30 * 1000;
+    static constexpr int maxPrefetchedFolders = 4;
+    static constexpr int maxPrefetchQueue = 8;
+    QStringList m_prefetchQueue{};
+    bool m_prefetching = false;
+
+    bool m_watching = false;
+    std::unique_ptr<ADBFolderWatcher> m_watcher;
+    QTimer* m_patchTimer;
+    QSet<QString> m_pendingChanges{};
+    bool m_pendingRelist = false;
+    bool m_patching = false;
+    // past this many changed entries a single listing is cheaper than a STAT for each
+    static constexpr int maxPatchedEntries = 32;
+
+    void watchCurrentFolder();
+    void folderChanged(const QStringList& names);
+    QCoro::Task<void> applyChanges();
+    void patchEntry(const QString& name, std::optional<ADBFileEntry> entry);
+
+    QCoro::Task<QVariantMap> co_removeFiles(QStringList names);
+    QCoro::Task<QVariantMap> co_moveFiles(QStringList names, QString destination);
+    QCoro::Task<QVariantMap> co_renameFile(QString name, QString newName);
+    QCoro::Task<QVariantMap> co_makeDirectory(QString name);
+    QCoro::Task<QVariantMap> co_setPermissions(QStringList names, int mode);
+    QVariantMap applyResults(const QString& folder, const QStringList& names, const std::vector<ADBFileOperationResult>& results, bool removed);
+
+    // cancelled by the next updateFolder, which makes the newest navigation the only one that commits
+    ADBCancelToken m_navigation{};
+    // folder that m_entries were listed from
+    QString m_listedPath{};
+    QCoro::Task<void> updateFolder(bool useCache = true, QStringList prefetchFirst = {});
+    // lists a folder shown from the cache again and commits the result if the navigation is still current
+    QCoro::Task<void> revalidate(QString path, ADBCancelToken token);
+    void prefetch(QStringList paths);
+    QCoro::Task<void> runPrefetch();
+
+    // files whose extension says nothing get their first bytes read once they become visible,
+    // nullptr marks files that were looked at without a match
+    static constexpr int maxSniffQueue = 16;
+    QHash<QString, const ADBFileTypes::Type*> m_sniffedTypes{};
+    QStringList m_sniffQueue{};
+    bool m_sniffing = false;
+    void sniff(QStringList names);
+    QCoro::Task<void> runSniff();
 };
 
 #endif
@@ -0,0 +1,115 @@
+/*
+ * Copyright (C) 2025  JCM
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * waydroid-files is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "adb_folder_watcher.h"
+
+#include <QDebug>
+#include <QTimer>
+
+#include "adb_client.h"
+
+ADBFolderWatcher::ADBFolderWatcher(ADBClient* client, QString path, QObject* parent) : QObject(parent), m_client(client), m_path(path) {
+    co_start(this);
+}
+
+QCoro::Task<void> ADBFolderWatcher::co_start(QPointer<ADBFolderWatcher> self) {
+    // n/d: created/deleted, y/m: moved in/out, w: written file closed, D/M/x: the folder itself went away
+    QString command = QStringLiteral("command -v inotifyd >/dev/null && exec inotifyd - %1:ndymwDMx 2>/dev/null").arg(shellQuote(self->m_path));
+    std::unique_ptr<QIODevice> events = co_await self->m_client->co_openShell(command);
+    if(!self) {
+        co_return;
+    }
+    if(!events) {
+        self->startPolling();
+        co_return;
+    }
+
+    self->m_events = std::move(events);
+    connect(self->m_events.get(), &QIODevice::readyRead, self, &ADBFolderWatcher::readEvents);
+    connect(self->m_events.get(), &QIODevice::readChannelFinished, self, [self]() {
+        if(self->m_events->bytesAvailable() > 0) {
+            self->readEvents();
+        }
+        // no inotifyd on the device, or the watch broke (e.g. the folder was unmounted)
+        qDebug() << "inotifyd stream for" << self->m_path << "ended" << (self->m_sawEvents ? "" : "without events") << ", polling instead";
+        if(self->m_sawEvents) {
+            emit self->changed({});
+        }
+        self->startPolling();
+    });
+    if(self->m_events->bytesAvailable() > 0) {
+        self->readEvents();
+    }
+}
+
+void ADBFolderWatcher::readEvents() {
+    QStringList names{};
+    bool unknown = false;
+
+    m_line += m_events->readAll();
+    int end;
+    while((end = m_line.indexOf('\n')) >= 0) {
+        QByteArray line = m_line.left(end);
+        m_line.remove(0, end + 1);
+
+        // "<events>\t<folder>\t<name>", the name is missing for events on the folder itself
+        QList<QByteArray> parts = line.split('\t');
+        if(parts.size() < 2) {
+            continue;
+        }
+        m_sawEvents = true;
+        if(parts.size() < 3 || parts.at(2).isEmpty()) {
+            unknown = true;
+            continue;
+        }
+        QString name = QString::fromUtf8(parts.at(2));
+        if(!names.contains(name)) {
+            names.append(name);
+        }
+    }
+
+    if(unknown) {
+        emit changed({});
+    } else if(!names.isEmpty()) {
+        emit changed(names);
+    }
+}
+
+void ADBFolderWatcher::startPolling() {
+    if(m_polling) {
+        return;
+    }
+    m_polling = true;
+
+    m_pollTimer = new QTimer(this);
+    m_pollTimer->setInterval(pollInterval);
+    connect(m_pollTimer, &QTimer::timeout, this, [this]() {
+        co_poll(this);
+    });
+    m_pollTimer->start();
+    co_poll(this);
+}
+
+QCoro::Task<void> ADBFolderWatcher::co_poll(QPointer<ADBFolderWatcher> self) {
+    // a single STAT per interval, only a changed folder mtime is worth a listing
+    auto stat = co_await self->m_client->co_stat(self->m_path);
+    if(!self || !stat) {
+        co_return;
+    }
+    if(self->m_lastTime != 0 && stat->time != self->m_lastTime) {
+        emit self->changed({});
+    }
+    self->m_lastTime = stat->time;
+}
@@ -0,0 +1,65 @@
+/*
+ * Copyright (C) 2025  JCM
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * waydroid-files is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ADB_FOLDER_WATCHER_H
+#define ADB_FOLDER_WATCHER_H
+
+#include <memory>
+
+#include <QIODevice>
+#include <QObject>
+#include <QPointer>
+#include <QStringList>
+
+#include <QCoro/QCoroTask>
+
+class ADBClient;
+class QTimer;
+
+// Reports changes inside one device folder. Prefers a long running inotifyd on the device,
+// which names the changed entries, and falls back to polling the folder's mtime, which can only tell that something changed.
+class ADBFolderWatcher : public QObject {
+    Q_OBJECT
+
+public:
+    ADBFolderWatcher(ADBClient* client, QString path, QObject* parent = nullptr);
+    ~ADBFolderWatcher() = default;
+
+    const QString& path() const { return m_path; }
+signals:
+    // An empty list means the changes are unknown and the whole folder has to be listed again.
+    void changed(const QStringList& names);
+private:
+    static QCoro::Task<void> co_start(QPointer<ADBFolderWatcher> self);
+    static QCoro::Task<void> co_poll(QPointer<ADBFolderWatcher> self);
+
+    void readEvents();
+    void startPolling();
+
+    static constexpr int pollInterval = 3000;
+
+    ADBClient* m_client;
+    QString m_path;
+    std::unique_ptr<QIODevice> m_events{};
+    QByteArray m_line{};
+    bool m_sawEvents = false;
+
+    QTimer* m_pollTimer = nullptr;
+    uint32_t m_lastTime = 0;
+    bool m_polling = false;
+};
+
+#endif
@@ -0,0 +1,776 @@
+/*
+ * Copyright (C) 2025  JCM
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * waydroid-files is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#define FUSE_USE_VERSION 31
+
+#include <atomic>
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <vector>
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QHash>
+#include <QTemporaryFile>
+
+#include <QCoro/QCoroTask>
+
+#include <fcntl.h>
+#include <fuse.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "adb_block_cache.h"
+#include "adb_client.h"
+#include "adb_listing_cache.h"
+
+#ifndef RENAME_NOREPLACE
+#define RENAME_NOREPLACE (1 << 0)
+#endif
+
+// waydroid-files-fuse: mounts the device filesystem, so any host program can open device files by path.
+//
+// libfuse calls in on its own threads while the client lives on the Qt thread. Cache hits are answered right away
+// on the FUSE thread, everything else is queued to the Qt thread as a coroutine and the FUSE thread waits for it.
+
+struct ADBFuseOptions {
+    QString root = "/";
+    qint64 attributeTtl = 10000;      // ms
+    qint64 listingTtl = 10000;        // ms
+    qint64 listingBudget = 8 * 1024 * 1024;
+    int attributeCapacity = 65536;
+    int blockCapacity = 1024;         // blocks of ADBBlockCache::blockSize
+    qint64 readAhead = 1024 * 1024;
+};
+
+class ADBFuseFilesystem {
+public:
+    // virtual file at the root of the mount with the counters below
+    static constexpr const char* statsPath = "/.waydroid-files-stats";
+
+    ADBFuseFilesystem(ADBClient* client, ADBFuseOptions options);
+
+    int getattr(const char* path, struct stat* st);
+    int readdir(const char* path, void* buffer, fuse_fill_dir_t filler);
+    int readlink(const char* path, char* buffer, size_t size);
+    int open(const char* path, struct fuse_file_info* fi);
+    int create(const char* path, mode_t mode, struct fuse_file_info* fi);
+    int read(const char* path, char* buffer, size_t size, off_t offset, struct fuse_file_info* fi);
+    int write(const char* path, const char* buffer, size_t size, off_t offset, struct fuse_file_info* fi);
+    int flush(const char* path, struct fuse_file_info* fi);
+    int release(const char* path, struct fuse_file_info* fi);
+    int truncate(const char* path, off_t size, struct fuse_file_info* fi);
+    int unlink(const char* path);
+    int rmdir(const char* path);
+    int mkdir(const char* path, mode_t mode);
+    int rename(const char* from, const char* to, unsigned int flags);
+    int chmod(const char* path, mode_t mode);
+
+    QString statsText() const;
+private:
+    // one per open(), kept in fuse_file_info::fh
+    struct Handle {
+        QString path;
+        // files opened for writing are edited in a local copy and sent back whole on flush
+        std::unique_ptr<QTemporaryFile> buffer{};
+        bool dirty = false;
+        mode_t mode = 0644;
+        bool stats = false;
+        QByteArray statsText{};
+        // fuse_main runs multithreaded, requests on the same open file can arrive on different threads at once
+        std::mutex mutex{};
+    };
+    struct CachedAttribute {
+        std::optional<ADBFileEntry> entry; // nullopt: known not to exist
+        qint64 fetchedAt;
+    };
+    struct Stats {
+        std::atomic<quint64> attributeHits{0};
+        std::atomic<quint64> attributeMisses{0};
+        std::atomic<quint64> listingHits{0};
+        std::atomic<quint64> listingMisses{0};
+        std::atomic<quint64> deviceRequests{0};
+        std::atomic<quint64> reads{0};
+        std::atomic<quint64> bytesRead{0};
+        std::atomic<quint64> bytesWritten{0};
+        std::atomic<quint64> flushes{0};
+    };
+
+    ADBClient* m_client;
+    ADBFuseOptions m_options;
+
+    mutable std::mutex m_mutex; // guards the two caches below, the block cache is only touched on the Qt thread
+    ADBListingCache m_listings;
+    QHash<QString, CachedAttribute> m_attributes{};
+    ADBBlockCache m_blocks;
+
+    Stats m_stats{};
+
+    QString devicePath(const char* path) const;
+    template<typename T> T onQt(std::function<QCoro::Task<T>()> job);
+
+    std::optional<std::vector<ADBFileEntry>> listing(const QString& path);
+    // -errno on failure
+    int entry(const QString& path, ADBFileEntry& result);
+    void remember(const QString& path, std::optional<ADBFileEntry> entry);
+    void forget(const QString& path);
+
+    int fillBuffer(Handle& handle, bool keepContent);
+    int send(Handle& handle);
+    static int errorCode(const ADBFileOperationResult& result);
+    static void fillStat(const ADBFileEntry& entry, struct stat* st);
+};
+
+template<typename T>
+static QCoro::Task<void> co_fulfil(std::function<QCoro::Task<T>()> job, std::promise<T>* promise) {
+    promise->set_value(co_await job());
+}
+
+template<typename T>
+T ADBFuseFilesystem::onQt(std::function<QCoro::Task<T>()> job) {
+    m_stats.deviceRequests++;
+    std::promise<T> promise;
+    std::future<T> future = promise.get_future();
+    QMetaObject::invokeMethod(m_client, [job = std::move(job), &promise]() {
+        co_fulfil<T>(job, &promise);
+    }, Qt::QueuedConnection);
+    return future.get();
+}
+
+ADBFuseFilesystem::ADBFuseFilesystem(ADBClient* client, ADBFuseOptions options)
+    : m_client(client), m_options(options), m_listings(options.listingBudget), m_blocks(client, options.blockCapacity) {
+    // a read-ahead window that does not fit into the block cache would be fetched again for every read inside it
+    m_options.readAhead = qBound(ADBBlockCache::blockSize, m_options.readAhead, m_options.blockCapacity * ADBBlockCache::blockSize);
+}
+
+QString ADBFuseFilesystem::devicePath(const char* path) const {
+    return QDir::cleanPath(m_options.root + '/' + QString::fromUtf8(path));
+}
+
+void ADBFuseFilesystem::fillStat(const ADBFileEntry& entry, struct stat* st) {
+    std::memset(st, 0, sizeof(struct stat));
+    st->st_mode = entry.mode;
+    st->st_nlink = S_ISDIR(entry.mode) ? 2 : 1;
+    st->st_size = entry.size;
+    st->st_blksize = ADBBlockCache::blockSize;
+    st->st_blocks = (entry.size + 511) / 512;
+    st->st_mtime = st->st_atime = st->st_ctime = entry.time;
+    st->st_uid = getuid();
+    st->st_gid = getgid();
+}
+
+int ADBFuseFilesystem::errorCode(const ADBFileOperationResult& result) {
+    static const std::pair<const char*, int> messages[] = {
+        {"No such file", ENOENT},
+        {"Permission denied", EACCES},
+        {"Read-only file system", EROFS},
+        {"Directory not empty", ENOTEMPTY},
+        {"Already exists", EEXIST},
+        {"Not a folder", ENOTDIR},
+        {"Not a directory", ENOTDIR},
+    };
+    for(const auto& [message, code] : messages) {
+        if(result.error.contains(QLatin1String(message))) {
+            return -code;
+        }
+    }
+    return -EIO;
+}
+
+std::optional<std::vector<ADBFileEntry>> ADBFuseFilesystem::listing(const QString& path) {
+    {
+        std::lock_guard lock{m_mutex};
+        if(auto entries = m_listings.lookup(path, m_options.listingTtl)) {
+            m_stats.listingHits++;
+            return entries;
+        }
+    }
+    m_stats.listingMisses++;
+
+    ADBClient* client = m_client;
+    std::vector<ADBFileEntry> entries = onQt<std::vector<ADBFileEntry>>([client, path]() {
+        return client->co_listFiles(path);
+    });
+    // every folder lists at least "." and "..", nothing at all means the LIST failed
+    if(entries.empty()) {
+        return std::nullopt;
+    }
+
+    std::lock_guard lock{m_mutex};
+    m_listings.insert(path, entries);
+    // the listing has the attributes of all children, so the getattr for each of them that usually follows is free
+    qint64 now = QDateTime::currentMSecsSinceEpoch();
+    for(const ADBFileEntry& child : entries) {
+        if(child.fileName == "." || child.fileName == "..") {
+            continue;
+        }
+        if(m_attributes.size() < m_options.attributeCapacity) {
+            m_attributes.insert(QDir::cleanPath(path + '/' + child.fileName), CachedAttribute{child, now});
+        }
+    }
+    return entries;
+}
+
+void ADBFuseFilesystem::remember(const QString& path, std::optional<ADBFileEntry> entry) {
+    std::lock_guard lock{m_mutex};
+    if(m_attributes.size() >= m_options.attributeCapacity) {
+        // expired ones first, and everything if that was not enough
+        qint64 now = QDateTime::currentMSecsSinceEpoch();
+        for(auto it = m_attributes.begin(); it != m_attributes.end();) {
+            it = now - it->fetchedAt > m_options.attributeTtl ? m_attributes.erase(it) : std::next(it);
+        }
+        if(m_attributes.size() >= m_options.attributeCapacity) {
+            m_attributes.clear();
+        }
+    }
+    m_attributes.insert(path, CachedAttribute{entry, QDateTime::currentMSecsSinceEpoch()});
+}
+
+void ADBFuseFilesystem::forget(const QString& path) {
+    std::lock_guard lock{m_mutex};
+    m_attributes.remove(path);
+    QString parent = path.section('/', 0, -2);
+    m_listings.invalidate(parent.isEmpty() ? "/" : parent);
+    m_listings.invalidate(path);
+}
+
+int ADBFuseFilesystem::entry(const QString& path, ADBFileEntry& result) {
+    {
+        std::lock_guard lock{m_mutex};
+        auto it = m_attributes.constFind(path);
+        if(it != m_attributes.constEnd() && QDateTime::currentMSecsSinceEpoch() - it->fetchedAt <= m_options.attributeTtl) {
+            m_stats.attributeHits++;
+            if(!it->entry) {
+                return -ENOENT;
+            }
+            result = *it->entry;
+            return 0;
+        }
+    }
+    m_stats.attributeMisses++;
+
+    ADBClient* client = m_client;
+    std::optional<ADBFileEntry> stat = onQt<std::optional<ADBFileEntry>>([client, path]() {
+        return client->co_stat(path);
+    });
+    if(!stat) {
+        return -EIO;
+    }
+    // STAT reports missing files as all zeroes rather than as an error
+    if(stat->mode == 0) {
+        remember(path, std::nullopt);
+        return -ENOENT;
+    }
+    stat->fileName = path.section('/', -1);
+    remember(path, *stat);
+    result = *stat;
+    return 0;
+}
+
+int ADBFuseFilesystem::getattr(const char* path, struct stat* st) {
+    if(std::strcmp(path, statsPath) == 0) {
+        fillStat(ADBFileEntry{{}, S_IFREG | 0444, static_cast<uint32_t>(statsText().toUtf8().size()),
+                              static_cast<uint32_t>(QDateTime::currentSecsSinceEpoch())}, st);
+        return 0;
+    }
+    ADBFileEntry result;
+    if(int error = entry(devicePath(path), result); error != 0) {
+        return error;
+    }
+    fillStat(result, st);
+    return 0;
+}
+
+int ADBFuseFilesystem::readdir(const char* path, void* buffer, fuse_fill_dir_t filler) {
+    QString folder = devicePath(path);
+    std::optional<std::vector<ADBFileEntry>> entries = listing(folder);
+    if(!entries) {
+        return -EIO;
+    }
+    struct stat st;
+    for(const ADBFileEntry& child : *entries) {
+        fillStat(child, &st);
+        if(filler(buffer, child.fileName.toUtf8().constData(), &st, 0, static_cast<fuse_fill_dir_flags>(0)) != 0) {
+            break;
+        }
+    }
+    return 0;
+}
+
+int ADBFuseFilesystem::readlink(const char* path, char* buffer, size_t size) {
+    ADBClient* client = m_client;
+    QString command = QStringLiteral("readlink -- %1").arg(shellQuote(devicePath(path)));
+    std::optional<QByteArray> target = onQt<std::optional<QByteArray>>([client, command]() {
+        return client->co_shell(command);
+    });
+    if(!target || target->isEmpty()) {
+        return -EIO;
+    }
+    QByteArray link = target->trimmed();
+    size_t length = std::min(size - 1, static_cast<size_t>(link.size()));
+    std::memcpy(buffer, link.constData(), length);
+    buffer[length] = '\0';
+    return 0;
+}
+
+int ADBFuseFilesystem::fillBuffer(Handle& handle, bool keepContent) {
+    handle.buffer = std::make_unique<QTemporaryFile>();
+    if(!handle.buffer->open()) {
+        qWarning() << "Failed to create a write buffer:" << handle.buffer->errorString();
+        return -EIO;
+    }
+    if(!keepContent) {
+        return 0;
+    }
+    ADBClient* client = m_client;
+    QString path = handle.path;
+    QTemporaryFile* file = handle.buffer.get();
+    bool ok = onQt<bool>([client, path, file]() {
+        return client->co_pullToDevice(path, *file, ADBIOScheduler::Priority::Interactive);
+    });
+    return ok ? 0 : -EIO;
+}
+
+int ADBFuseFilesystem::send(Handle& handle) {
+    if(!handle.dirty) {
+        return 0;
+    }
+    if(!handle.buffer->flush()) {
+        return -EIO;
+    }
+    m_stats.flushes++;
+    ADBClient* client = m_client;
+    ADBBlockCache* blocks = &m_blocks;
+    QString hostPath = handle.buffer->fileName();
+    QString path = handle.path;
+    mode_t mode = handle.mode;
+    bool ok = onQt<bool>([client, blocks, hostPath, path, mode]() {
+        // blocks are keyed by mtime, which only has a resolution of seconds
+        blocks->clear();
+        return client->co_pushFile(hostPath, path, mode);
+    });
+    forget(path);
+    if(!ok) {
+        return -EIO;
+    }
+    handle.dirty = false;
+    return 0;
+}
+
+int ADBFuseFilesystem::open(const char* path, struct fuse_file_info* fi) {
+    auto handle = std::make_unique<Handle>();
+    if(std::strcmp(path, statsPath) == 0) {
+        if((fi->flags & O_ACCMODE) != O_RDONLY) {
+            return -EACCES;
+        }
+        handle->stats = true;
+        handle->statsText = statsText().toUtf8();
+        // the size reported by getattr is stale by the time it is read
+        fi->direct_io = 1;
+        fi->fh = reinterpret_cast<uint64_t>(handle.release());
+        return 0;
+    }
+
+    handle->path = devicePath(path);
+    ADBFileEntry existing;
+    if(int error = entry(handle->path, existing); error != 0) {
+        return error;
+    }
+    if(S_ISDIR(existing.mode)) {
+        return -EISDIR;
+    }
+    handle->mode = existing.mode & 07777;
+
+    if((fi->flags & O_ACCMODE) != O_RDONLY) {
+        bool truncate = fi->flags & O_TRUNC;
+        if(int error = fillBuffer(*handle, !truncate); error != 0) {
+            return error;
+        }
+        handle->dirty = truncate;
+    }
+    fi->fh = reinterpret_cast<uint64_t>(handle.release());
+    return 0;
+}
+
+int ADBFuseFilesystem::create(const char* path, mode_t mode, struct fuse_file_info* fi) {
+    auto handle = std::make_unique<Handle>();
+    handle->path = devicePath(path);
+    handle->mode = mode & 07777;
+    if(int error = fillBuffer(*handle, false); error != 0) {
+        return error;
+    }
+    // sent right away, so the file exists for the getattr that follows even before anything is written
+    handle->dirty = true;
+    if(int error = send(*handle); error != 0) {
+        return error;
+    }
+    fi->fh = reinterpret_cast<uint64_t>(handle.release());
+    return 0;
+}
+
+int ADBFuseFilesystem::read(const char*, char* buffer, size_t size, off_t offset, struct fuse_file_info* fi) {
+    Handle& handle = *reinterpret_cast<Handle*>(fi->fh);
+    m_stats.reads++;
+    if(handle.stats) {
+        QByteArray data = handle.statsText.mid(offset, size);
+        std::memcpy(buffer, data.constData(), data.size());
+        return data.size();
+    }
+    if(handle.buffer) {
+        std::lock_guard lock{handle.mutex};
+        if(!handle.buffer->seek(offset)) {
+            return -EIO;
+        }
+        qint64 length = handle.buffer->read(buffer, size);
+        return length < 0 ? -EIO : static_cast<int>(length);
+    }
+
+    ADBFileEntry file;
+    if(int error = entry(handle.path, file); error != 0) {
+        return error;
+    }
+    if(offset >= file.size) {
+        return 0;
+    }
+    qint64 length = std::min<qint64>(size, file.size - offset);
+
+    // FUSE asks for 128 KiB at a time, fetching whole aligned windows turns a sequential read into one
+    // device round trip per window and leaves the rest of the window in the block cache for the reads that follow
+    qint64 windowStart = offset / m_options.readAhead * m_options.readAhead;
+    qint64 windowEnd = std::min<qint64>((offset + length + m_options.readAhead - 1) / m_options.readAhead * m_options.readAhead, file.size);
+
+    ADBBlockCache* blocks = &m_blocks;
+    QString path = handle.path;
+    uint32_t time = file.time;
+    std::optional<QByteArray> data = onQt<std::optional<QByteArray>>([blocks, path, time, windowStart, windowEnd]() {
+        return blocks->co_read(path, time, windowStart, windowEnd - windowStart);
+    });
+    if(!data) {
+        return -EIO;
+    }
+    QByteArray piece = data->mid(offset - windowStart, length);
+    std::memcpy(buffer, piece.constData(), piece.size());
+    m_stats.bytesRead += piece.size();
+    return piece.size();
+}
+
+int ADBFuseFilesystem::write(const char*, const char* buffer, size_t size, off_t offset, struct fuse_file_info* fi) {
+    Handle& handle = *reinterpret_cast<Handle*>(fi->fh);
+    if(!handle.buffer) {
+        return -EBADF;
+    }
+    std::lock_guard lock{handle.mutex};
+    if(!handle.buffer->seek(offset)) {
+        return -EIO;
+    }
+    qint64 written = handle.buffer->write(buffer, size);
+    if(written < 0) {
+        return -EIO;
+    }
+    handle.dirty = true;
+    m_stats.bytesWritten += written;
+    return static_cast<int>(written);
+}
+
+int ADBFuseFilesystem::flush(const char*, struct fuse_file_info* fi) {
+    Handle& handle = *reinterpret_cast<Handle*>(fi->fh);
+    std::lock_guard lock{handle.mutex};
+    return handle.buffer ? send(handle) : 0;
+}
+
+int ADBFuseFilesystem::release(const char*, struct fuse_file_info* fi) {
+    std::unique_ptr<Handle> handle{reinterpret_cast<Handle*>(fi->fh)};
+    std::lock_guard lock{handle->mutex};
+    return handle->buffer ? send(*handle) : 0;
+}
+
+int ADBFuseFilesystem::truncate(const char* path, off_t size, struct fuse_file_info* fi) {
+    if(fi) {
+        Handle& handle = *reinterpret_cast<Handle*>(fi->fh);
+        std::lock_guard lock{handle.mutex};
+        if(!handle.buffer || !handle.buffer->resize(size)) {
+            return -EIO;
+        }
+        handle.dirty = true;
+        return 0;
+    }
+
+    Handle handle;
+    handle.path = devicePath(path);
+    ADBFileEntry existing;
+    if(int error = entry(handle.path, existing); error != 0) {
+        return error;
+    }
+    handle.mode = existing.mode & 07777;
+    if(int error = fillBuffer(handle, size != 0); error != 0) {
+        return error;
+    }
+    if(!handle.buffer->resize(size)) {
+        return -EIO;
+    }
+    handle.dirty = true;
+    return send(handle);
+}
+
+int ADBFuseFilesystem::unlink(const char* path) {
+    ADBClient* client = m_client;
+    QString target = devicePath(path);
+    std::vector<ADBFileOperationResult> results = onQt<std::vector<ADBFileOperationResult>>([client, target]() {
+        return client->co_removeFiles({target});
+    });
+    forget(target);
+    if(results.empty()) {
+        return -EIO;
+    }
+    return results.front().ok ? 0 : errorCode(results.front());
+}
+
+int ADBFuseFilesystem::rmdir(const char* path) {
+    // the removal below is recursive, rmdir must not be
+    QString target = devicePath(path);
+    std::optional<std::vector<ADBFileEntry>> entries = listing(target);
+    if(!entries) {
+        return -EIO;
+    }
+    for(const ADBFileEntry& child : *entries) {
+        if(child.fileName != "." && child.fileName != "..") {
+            return -ENOTEMPTY;
+        }
+    }
+    return unlink(path);
+}
+
+int ADBFuseFilesystem::mkdir(const char* path, mode_t mode) {
+    ADBClient* client = m_client;
+    QString target = devicePath(path);
+    ADBFileOperationResult result = onQt<ADBFileOperationResult>([client, target]() {
+        return client->co_makeDirectory(target);
+    });
+    forget(target);
+    if(!result.ok) {
+        return errorCode(result);
+    }
+    return (mode & 07777) == 0755 ? 0 : chmod(path, mode);
+}
+
+int ADBFuseFilesystem::rename(const char* from, const char* to, unsigned int flags) {
+    if(flags & ~RENAME_NOREPLACE) {
+        return -EINVAL;
+    }
+    QString source = devicePath(from);
+    QString target = devicePath(to);
+
+    // rename(2) replaces the target, co_rename refuses to, so a file in the way goes first
+    ADBFileEntry existing;
+    if(!(flags & RENAME_NOREPLACE) && entry(target, existing) == 0 && !S_ISDIR(existing.mode)) {
+        if(int error = unlink(to); error != 0) {
+            return error;
+        }
+    }
+
+    ADBClient* client = m_client;
+    ADBFileOperationResult result = onQt<ADBFileOperationResult>([client, source, target]() {
+        return client->co_rename(source, target);
+    });
+    forget(source);
+    forget(target);
+    return result.ok ? 0 : errorCode(result);
+}
+
+int ADBFuseFilesystem::chmod(const char* path, mode_t mode) {
+    ADBClient* client = m_client;
+    QString target = devicePath(path);
+    std::vector<ADBFileOperationResult> results = onQt<std::vector<ADBFileOperationResult>>([client, target, mode]() {
+        return client->co_setMode({target}, mode & 07777);
+    });
+    forget(target);
+    if(results.empty()) {
+        return -EIO;
+    }
+    return results.front().ok ? 0 : errorCode(results.front());
+}
+
+QString ADBFuseFilesystem::statsText() const {
+    qint64 listingUsage;
+    int attributes;
+    {
+        std::lock_guard lock{m_mutex};
+        listingUsage = m_listings.usage();
+        attributes = m_attributes.size();
+    }
+    return QStringLiteral(
+        "attribute_hits %1\nattribute_misses %2\nattributes_cached %3\n"
+        "listing_hits %4\nlisting_misses %5\nlisting_cache_bytes %6\n"
+        "device_requests %7\nreads %8\nbytes_read %9\nbytes_written %10\nflushes %11\n")
+        .arg(m_stats.attributeHits.load()).arg(m_stats.attributeMisses.load()).arg(attributes)
+        .arg(m_stats.listingHits.load()).arg(m_stats.listingMisses.load()).arg(listingUsage)
+        .arg(m_stats.deviceRequests.load()).arg(m_stats.reads.load()).arg(m_stats.bytesRead.load())
+        .arg(m_stats.bytesWritten.load()).arg(m_stats.flushes.load());
+}
+
+static ADBFuseFilesystem* filesystem() {
+    return static_cast<ADBFuseFilesystem*>(fuse_get_context()->private_data);
+}
+
+static const struct fuse_operations operations = [] {
+    struct fuse_operations ops{};
+    ops.init = [](struct fuse_conn_info*, struct fuse_config* config) -> void* {
+        // the kernel keeps pages of files whose mtime did not change, our own caches handle the rest
+        config->auto_cache = 1;
+        config->use_ino = 0;
+        return fuse_get_context()->private_data;
+    };
+    ops.getattr = [](const char* path, struct stat* st, struct fuse_file_info*) {
+        return filesystem()->getattr(path, st);
+    };
+    ops.readdir = [](const char* path, void* buffer, fuse_fill_dir_t filler, off_t, struct fuse_file_info*, enum fuse_readdir_flags) {
+        return filesystem()->readdir(path, buffer, filler);
+    };
+    ops.readlink = [](const char* path, char* buffer, size_t size) {
+        return filesystem()->readlink(path, buffer, size);
+    };
+    ops.open = [](const char* path, struct fuse_file_info* fi) {
+        return filesystem()->open(path, fi);
+    };
+    ops.create = [](const char* path, mode_t mode, struct fuse_file_info* fi) {
+        return filesystem()->create(path, mode, fi);
+    };
+    ops.read = [](const char* path, char* buffer, size_t size, off_t offset, struct fuse_file_info* fi) {
+        return filesystem()->read(path, buffer, size, offset, fi);
+    };
+    ops.write = [](const char* path, const char* buffer, size_t size, off_t offset, struct fuse_file_info* fi) {
+        return filesystem()->write(path, buffer, size, offset, fi);
+    };
+    ops.flush = [](const char* path, struct fuse_file_info* fi) {
+        return filesystem()->flush(path, fi);
+    };
+    ops.release = [](const char* path, struct fuse_file_info* fi) {
+        return filesystem()->release(path, fi);
+    };
+    ops.truncate = [](const char* path, off_t size, struct fuse_file_info* fi) {
+        return filesystem()->truncate(path, size, fi);
+    };
+    ops.unlink = [](const char* path) {
+        return filesystem()->unlink(path);
+    };
+    ops.rmdir = [](const char* path) {
+        return filesystem()->rmdir(path);
+    };
+    ops.mkdir = [](const char* path, mode_t mode) {
+        return filesystem()->mkdir(path, mode);
+    };
+    ops.rename = [](const char* from, const char* to, unsigned int flags) {
+        return filesystem()->rename(from, to, flags);
+    };
+    ops.chmod = [](const char* path, mode_t mode, struct fuse_file_info*) {
+        return filesystem()->chmod(path, mode);
+    };
+    // adb can not set times on its own, accepting it keeps cp -p and touch from failing
+    ops.utimens = [](const char*, const struct timespec[2], struct fuse_file_info*) {
+        return 0;
+    };
+    return ops;
+}();
+
+int main(int argc, char *argv[]) {
+    QCoreApplication app(argc, argv);
+    app.setApplicationName("waydroid-files.jcm");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Mount the filesystem of an Android device over ADB.\n\n"
+        "Cache statistics can be read from " + QString(ADBFuseFilesystem::statsPath) + " below the mount point.");
+    parser.addHelpOption();
+    parser.addPositionalArgument("mountpoint", "Empty folder to mount the device on");
+    parser.addOptions({
+        {"adbd", "Talk to adbd at <host:port> directly instead of the adb server.", "host:port"},
+        {"root", "Folder on the device to mount.", "path", "/"},
+        {"attr-ttl", "Seconds that attributes are trusted without asking the device again.", "seconds", "10"},
+        {"dir-ttl", "Seconds that folder listings are trusted without asking the device again.", "seconds", "10"},
+        {"listing-cache", "Memory for folder listings.", "MiB", "8"},
+        {"attr-cache", "Number of file attributes kept.", "count", "65536"},
+        {"block-cache", "Memory for file contents.", "MiB", "64"},
+        {"read-ahead", "Size of the aligned windows that reads fetch.", "KiB", "1024"},
+        {"o", "Mount options passed on to FUSE.", "options"},
+        {"debug", "Log every FUSE request."},
+    });
+    parser.process(app);
+
+    QStringList args = parser.positionalArguments();
+    if(args.size() != 1) {
+        parser.showHelp(1);
+    }
+
+    ADBFuseOptions options;
+    options.root = parser.value("root");
+    options.attributeTtl = parser.value("attr-ttl").toDouble() * 1000;
+    options.listingTtl = parser.value("dir-ttl").toDouble() * 1000;
+    options.listingBudget = parser.value("listing-cache").toLongLong() * 1024 * 1024;
+    options.attributeCapacity = std::max(1, parser.value("attr-cache").toInt());
+    options.blockCapacity = std::max<qint64>(1, parser.value("block-cache").toLongLong() * 1024 * 1024 / ADBBlockCache::blockSize);
+    options.readAhead = parser.value("read-ahead").toLongLong() * 1024;
+
+    ADBClient client;
+    if(parser.isSet("adbd")) {
+        client.setDirectAddress(parser.value("adbd"));
+    }
+    ADBFuseFilesystem filesystem{&client, options};
+
+    // always in the foreground: forking would lose the Qt thread, and the FUSE loop runs on a thread of its own
+    std::vector<QByteArray> fuseArgs{QByteArray(argv[0]), QFile::encodeName(args.first()), "-f"};
+    if(parser.isSet("o")) {
+        fuseArgs.push_back("-o");
+        fuseArgs.push_back(parser.value("o").toUtf8());
+    }
+    if(parser.isSet("debug")) {
+        fuseArgs.push_back("-d");
+    }
+    std::vector<char*> fuseArgv;
+    for(QByteArray& arg : fuseArgs) {
+        fuseArgv.push_back(arg.data());
+    }
+
+    // SIGINT and SIGTERM end the FUSE loop, they have to arrive on its thread to wake it up
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    sigaddset(&signals, SIGHUP);
+    pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+
+    int result = 0;
+    std::thread loop{[&]() {
+        pthread_sigmask(SIG_UNBLOCK, &signals, nullptr);
+        result = fuse_main(static_cast<int>(fuseArgv.size()), fuseArgv.data(), &operations, &filesystem);
+        QMetaObject::invokeMethod(&app, &QCoreApplication::quit, Qt::QueuedConnection);
+    }};
+    app.exec();
+    loop.join();
+
+    std::fputs(qPrintable(filesystem.statsText()), stderr);
+    return result;
+}
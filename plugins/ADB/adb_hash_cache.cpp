@@ -0,0 +1,134 @@
+/*
+ * Copyright (C) 2025  JCM
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * waydroid-files is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "adb_hash_cache.h"
+
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QStandardPaths>
+
+#include <QtConcurrent>
+
+#include <QCoro/QCoroFuture>
+
+#include "adb_trace.h"
+
+ADBHashCache::ADBHashCache(QString file) : m_file(file) {
+    load();
+}
+
+ADBHashCache::~ADBHashCache() {
+    if(m_unsaved > 0) {
+        save();
+    }
+}
+
+ADBHashCache& ADBHashCache::hostFiles() {
+    static ADBHashCache cache{QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/host-hashes"};
+    return cache;
+}
+
+QByteArray ADBHashCache::hashFile(const QString& path) {
+    ADBTraceSpan span{"file", "sha256", path, false};
+    QFile file(path);
+    if(!file.open(QIODevice::ReadOnly)) {
+        qWarning() << "Failed to open" << path << "for hashing";
+        return {};
+    }
+    QCryptographicHash hash(QCryptographicHash::Sha256);
+    if(!hash.addData(&file)) {
+        qWarning() << "Failed to read" << path << "for hashing";
+        return {};
+    }
+    return hash.result().toHex();
+}
+
+QByteArray ADBHashCache::lookup(const QString& path, qint64 size, qint64 time) const {
+    auto it = m_entries.constFind(path);
+    if(it == m_entries.constEnd() || it->size != size || it->time != time) {
+        return {};
+    }
+    return it->hash;
+}
+
+void ADBHashCache::insert(const QString& path, qint64 size, qint64 time, const QByteArray& hash) {
+    if(path.contains('\n')) {
+        return;
+    }
+    if(m_entries.size() >= maxEntries && !m_entries.contains(path)) {
+        // no usage order is kept, starting over is good enough for a table that is this cheap to rebuild
+        m_entries.clear();
+    }
+    m_entries.insert(path, Entry{size, time, hash});
+    if(++m_unsaved >= saveEvery) {
+        save();
+    }
+}
+
+QCoro::Task<QByteArray> ADBHashCache::co_hash(QString path) {
+    QFileInfo info(path);
+    if(!info.isFile()) {
+        co_return QByteArray{};
+    }
+    qint64 size = info.size();
+    qint64 time = info.lastModified().toMSecsSinceEpoch();
+    if(QByteArray hash = lookup(path, size, time); !hash.isEmpty()) {
+        co_return hash;
+    }
+
+    QByteArray hash = co_await QtConcurrent::run(&ADBHashCache::hashFile, path);
+    if(!hash.isEmpty()) {
+        insert(path, size, time, hash);
+    }
+    co_return hash;
+}
+
+void ADBHashCache::load() {
+    QFile file(m_file);
+    if(!file.open(QIODevice::ReadOnly)) {
+        return;
+    }
+    // <hash> <size> <mtime in ms> <path>, the path last since it may contain anything but a newline
+    while(!file.atEnd()) {
+        QByteArray line = file.readLine();
+        line.chop(1);
+        QList<QByteArray> fields = line.split(' ');
+        if(fields.size() < 4) {
+            continue;
+        }
+        QString path = QString::fromUtf8(line.mid(fields.at(0).size() + fields.at(1).size() + fields.at(2).size() + 3));
+        m_entries.insert(path, Entry{fields.at(1).toLongLong(), fields.at(2).toLongLong(), fields.at(0)});
+    }
+}
+
+void ADBHashCache::save() {
+    m_unsaved = 0;
+    QDir().mkpath(QFileInfo(m_file).absolutePath());
+
+    QSaveFile file(m_file);
+    if(!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "Failed to save hash cache to" << m_file;
+        return;
+    }
+    for(auto it = m_entries.constBegin(); it != m_entries.constEnd(); ++it) {
+        file.write(it->hash + ' ' + QByteArray::number(it->size) + ' ' + QByteArray::number(it->time) + ' ' + it.key().toUtf8() + '\n');
+    }
+    file.commit();
+}
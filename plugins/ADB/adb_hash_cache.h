@@ -0,0 +1,62 @@
+/*
+ * Copyright (C) 2025  JCM
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * waydroid-files is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ADB_HASH_CACHE_H
+#define ADB_HASH_CACHE_H
+
+#include <QByteArray>
+#include <QHash>
+#include <QString>
+
+#include <QCoro/QCoroTask>
+
+// SHA-256 of host files, remembered by path together with the size and mtime they had when hashed,
+// so comparing against the device only reads a host file again after it changed.
+// The table is kept in a small text file that survives restarts.
+class ADBHashCache {
+public:
+    explicit ADBHashCache(QString file);
+    ~ADBHashCache();
+
+    // shared by all clients, stored in the cache location
+    static ADBHashCache& hostFiles();
+
+    static QByteArray hashFile(const QString& path);
+
+    QByteArray lookup(const QString& path, qint64 size, qint64 time) const;
+    void insert(const QString& path, qint64 size, qint64 time, const QByteArray& hash);
+
+    // hex encoded like sha256sum prints it, empty if the file cannot be read
+    QCoro::Task<QByteArray> co_hash(QString path);
+private:
+    struct Entry {
+        qint64 size;
+        qint64 time;
+        QByteArray hash;
+    };
+
+    static constexpr int maxEntries = 50000;
+    static constexpr int saveEvery = 64;
+
+    QString m_file;
+    QHash<QString, Entry> m_entries{};
+    int m_unsaved = 0;
+
+    void load();
+    void save();
+};
+
+#endif
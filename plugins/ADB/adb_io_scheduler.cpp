@@ -0,0 +1,57 @@
+/*
+ * Copyright (C) 2025  JCM
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * waydroid-files is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "adb_io_scheduler.h"
+
+#include <QDateTime>
+
+#include <QCoro/QCoroSignal>
+
+#include "adb_trace.h"
+
+ADBIOScheduler::Interactive::Interactive(ADBIOScheduler* scheduler) : m_scheduler(scheduler) {
+    m_scheduler->m_interactive++;
+}
+
+ADBIOScheduler::Interactive::~Interactive() {
+    if(m_scheduler && --m_scheduler->m_interactive == 0) {
+        emit m_scheduler->interactiveIdle();
+    }
+}
+
+ADBIOScheduler& ADBIOScheduler::instance() {
+    static ADBIOScheduler scheduler;
+    return scheduler;
+}
+
+QCoro::Task<void> ADBIOScheduler::co_yieldToInteractive(BulkStream& stream) {
+    if(m_interactive == 0) {
+        stream.paused = 0;
+        co_return;
+    }
+    qint64 start = QDateTime::currentMSecsSinceEpoch();
+    if(start < stream.runUntil) {
+        co_return;
+    }
+
+    ADBTraceSpan span{"session", "bulk paused"};
+    co_await qCoro(this, &ADBIOScheduler::interactiveIdle, std::chrono::milliseconds{maxPause.count() - stream.paused});
+    qint64 now = QDateTime::currentMSecsSinceEpoch();
+    stream.paused += now - start;
+    if(stream.paused >= maxPause.count()) {
+        stream.paused = 0;
+        stream.runUntil = now + bulkRun.count();
+    }
+}
@@ -0,0 +1,77 @@
+/*
+ * Copyright (C) 2025  JCM
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * waydroid-files is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ADB_IO_SCHEDULER_H
+#define ADB_IO_SCHEDULER_H
+
+#include <chrono>
+#include <utility>
+
+#include <QObject>
+
+#include <QCoro/QCoroTask>
+
+// Lets interactive requests (listings, stats, thumbnails) go first. While any of them is in flight, bulk work
+// (transfers, scans) pauses at its next DATA packet, which also stops draining the socket and so frees the
+// device's bandwidth. Shared by all clients in the process, since they all compete for the same device.
+class ADBIOScheduler : public QObject {
+    Q_OBJECT
+
+public:
+    enum class Priority {
+        Interactive,
+        Bulk,
+    };
+
+    // marks interactive work as in flight for as long as it lives
+    class Interactive {
+    public:
+        explicit Interactive(ADBIOScheduler* scheduler);
+        Interactive(Interactive&& other) noexcept : m_scheduler(std::exchange(other.m_scheduler, nullptr)) {}
+        Interactive(const Interactive&) = delete;
+        ~Interactive();
+    private:
+        ADBIOScheduler* m_scheduler;
+    };
+
+    // Pause bookkeeping of one bulk transfer or scan, kept by the caller for as long as that runs.
+    struct BulkStream {
+        // how long the stream has been held back since it last ran freely
+        qint64 paused = 0;
+        // it is not held back again before this time
+        qint64 runUntil = 0;
+    };
+
+    static ADBIOScheduler& instance();
+
+    Interactive interactive() { return Interactive{this}; }
+    bool interactivePending() const { return m_interactive > 0; }
+
+    // Returns right away unless interactive work is waiting. Once a stream has been held back for maxPause in
+    // total, it runs freely for bulkRun before it yields again, so a busy browser cannot starve a transfer.
+    QCoro::Task<void> co_yieldToInteractive(BulkStream& stream);
+signals:
+    void interactiveIdle();
+private:
+    ADBIOScheduler() = default;
+
+    static constexpr std::chrono::milliseconds maxPause{1500};
+    static constexpr std::chrono::milliseconds bulkRun{1000};
+
+    int m_interactive = 0;
+};
+
+#endif
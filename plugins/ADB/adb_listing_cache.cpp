@@ -0,0 +1,71 @@
+/*
+ * Copyright (C) 2025  JCM
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * waydroid-files is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "adb_listing_cache.h"
+
+#include <QDateTime>
+#include <QDir>
+
+ADBListingCache::ADBListingCache(qint64 budget) : m_budget(budget) {
+}
+
+QString ADBListingCache::normalize(const QString& path) {
+    return QDir::cleanPath(path);
+}
+
+std::optional<std::vector<ADBFileEntry>> ADBListingCache::lookup(const QString& path, qint64 maxAge) {
+    auto it = m_entries.find(normalize(path));
+    if(it == m_entries.end() || QDateTime::currentMSecsSinceEpoch() - it->fetchedAt > maxAge) {
+        return std::nullopt;
+    }
+    m_lru.splice(m_lru.begin(), m_lru, it->lru);
+    return it->entries;
+}
+
+bool ADBListingCache::contains(const QString& path, qint64 maxAge) const {
+    auto it = m_entries.find(normalize(path));
+    return it != m_entries.end() && QDateTime::currentMSecsSinceEpoch() - it->fetchedAt <= maxAge;
+}
+
+void ADBListingCache::insert(const QString& path, std::vector<ADBFileEntry> entries) {
+    QString key = normalize(path);
+    invalidate(key);
+
+    qint64 bytes = sizeof(Entry) + key.size() * sizeof(QChar);
+    for(const ADBFileEntry& entry : entries) {
+        bytes += sizeof(ADBFileEntry) + entry.fileName.size() * sizeof(QChar);
+    }
+    if(bytes > m_budget) {
+        return;
+    }
+
+    m_lru.push_front(key);
+    m_entries.insert(key, Entry{std::move(entries), QDateTime::currentMSecsSinceEpoch(), bytes, m_lru.begin()});
+    m_usage += bytes;
+
+    while(m_usage > m_budget) {
+        invalidate(m_lru.back());
+    }
+}
+
+void ADBListingCache::invalidate(const QString& path) {
+    auto it = m_entries.find(normalize(path));
+    if(it == m_entries.end()) {
+        return;
+    }
+    m_usage -= it->bytes;
+    m_lru.erase(it->lru);
+    m_entries.erase(it);
+}
@@ -0,0 +1,60 @@
+/*
+ * Copyright (C) 2025  JCM
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * waydroid-files is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ADB_LISTING_CACHE_H
+#define ADB_LISTING_CACHE_H
+
+#include <list>
+#include <optional>
+#include <vector>
+
+#include <QHash>
+#include <QString>
+
+#include "adb_client.h"
+
+// Recent directory listings, so folders that were prefetched or visited a moment ago open without a round trip.
+// Listings older than the age asked for count as missing, and the least recently used ones are dropped
+// once their estimated memory use exceeds the budget.
+class ADBListingCache {
+public:
+    ADBListingCache(qint64 budget);
+    ~ADBListingCache() = default;
+
+    std::optional<std::vector<ADBFileEntry>> lookup(const QString& path, qint64 maxAge);
+    bool contains(const QString& path, qint64 maxAge) const;
+    void insert(const QString& path, std::vector<ADBFileEntry> entries);
+    void invalidate(const QString& path);
+
+    qint64 usage() const { return m_usage; }
+private:
+    struct Entry {
+        std::vector<ADBFileEntry> entries;
+        qint64 fetchedAt;
+        qint64 bytes;
+        std::list<QString>::iterator lru;
+    };
+
+    qint64 m_budget;
+    qint64 m_usage = 0;
+
+    QHash<QString, Entry> m_entries{};
+    std::list<QString> m_lru{}; // most recently used first
+
+    static QString normalize(const QString& path);
+};
+
+#endif
@@ -0,0 +1,274 @@
+/*
+ * Copyright (C) 2025  JCM
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * waydroid-files is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "adb_media_server.h"
+
+#include <algorithm>
+#include <tuple>
+
+#include <QDebug>
+#include <QHostAddress>
+#include <QRandomGenerator>
+#include <QTcpServer>
+#include <QTcpSocket>
+
+#include <sys/stat.h>
+
+#include "adb_client.h"
+#include "adb_file_types.h"
+#include "adb_trace.h"
+#include "adb_transport.h"
+
+ADBMediaServer::ADBMediaServer(ADBClient* client)
+    : m_client(client), m_server(new QTcpServer(this)), m_cache(client, cacheBlocks) {
+    m_token = QByteArray::number(QRandomGenerator::global()->generate64(), 16)
+        + QByteArray::number(QRandomGenerator::global()->generate64(), 16);
+
+    connect(m_server, &QTcpServer::newConnection, this, [this]() {
+        while(QTcpSocket* socket = m_server->nextPendingConnection()) {
+            co_serve(socket);
+        }
+    });
+}
+
+ADBMediaServer::~ADBMediaServer() = default;
+
+QUrl ADBMediaServer::urlFor(const QString& devicePath) {
+    if(!m_server->isListening() && !m_server->listen(QHostAddress::LocalHost)) {
+        qWarning() << "Failed to start the media server:" << m_server->errorString();
+        return QUrl{};
+    }
+
+    QUrl url{};
+    url.setScheme("http");
+    url.setHost("127.0.0.1");
+    url.setPort(m_server->serverPort());
+    url.setPath("/" + QString::fromLatin1(m_token) + (devicePath.startsWith('/') ? devicePath : "/" + devicePath), QUrl::DecodedMode);
+    return url;
+}
+
+std::optional<std::pair<qint64, qint64>> ADBMediaServer::parseRange(const QByteArray& range, qint64 size) {
+    if(!range.startsWith("bytes=") || size <= 0) {
+        return std::nullopt;
+    }
+    QByteArray spec = range.mid(6).trimmed();
+    int dash = spec.indexOf('-');
+    if(dash < 0) {
+        return std::nullopt;
+    }
+
+    bool okay = true;
+    qint64 first = 0;
+    qint64 last = size - 1;
+    if(dash == 0) {
+        // the last n bytes
+        qint64 suffix = spec.mid(1).toLongLong(&okay);
+        if(!okay || suffix <= 0) {
+            return std::nullopt;
+        }
+        first = std::max<qint64>(size - suffix, 0);
+    } else {
+        first = spec.left(dash).toLongLong(&okay);
+        if(okay && dash + 1 < spec.size()) {
+            last = std::min(spec.mid(dash + 1).toLongLong(&okay), size - 1);
+        }
+    }
+    if(!okay || first < 0 || first > last) {
+        return std::nullopt;
+    }
+    return std::make_pair(first, last);
+}
+
+QByteArray ADBMediaServer::statusLine(int status) {
+    switch(status) {
+        case 200: return "HTTP/1.1 200 OK\r\n";
+        case 206: return "HTTP/1.1 206 Partial Content\r\n";
+        case 400: return "HTTP/1.1 400 Bad Request\r\n";
+        case 404: return "HTTP/1.1 404 Not Found\r\n";
+        case 405: return "HTTP/1.1 405 Method Not Allowed\r\n";
+        case 416: return "HTTP/1.1 416 Range Not Satisfiable\r\n";
+        case 431: return "HTTP/1.1 431 Request Header Fields Too Large\r\n";
+        default: return "HTTP/1.1 500 Internal Server Error\r\n";
+    }
+}
+
+QCoro::Task<void> ADBMediaServer::co_serve(QTcpSocket* socket) {
+    ADBStreamIO io{*socket};
+    QByteArray buffer{};
+
+    // players seek with a new request on the same connection, so keep serving until one side gives up
+    bool keepAlive = true;
+    while(keepAlive) {
+        int end;
+        while((end = buffer.indexOf("\r\n\r\n")) < 0 && buffer.size() <= maxHeaderSize) {
+            QByteArray chunk = co_await io.read(4096, idleTimeout);
+            if(chunk.isEmpty()) {
+                break;
+            }
+            buffer += chunk;
+        }
+        if(end < 0) {
+            if(buffer.size() > maxHeaderSize) {
+                co_await io.write(statusLine(431) + "Content-Length: 0\r\nConnection: close\r\n\r\n");
+            }
+            break;
+        }
+
+        QList<QByteArray> lines = buffer.left(end).split('\n');
+        buffer.remove(0, end + 4);
+
+        QList<QByteArray> requestLine = lines.takeFirst().trimmed().split(' ');
+        if(requestLine.size() != 3) {
+            co_await io.write(statusLine(400) + "Content-Length: 0\r\nConnection: close\r\n\r\n");
+            break;
+        }
+        Request request{};
+        request.method = requestLine.at(0);
+        QByteArray target = requestLine.at(1);
+        if(int query = target.indexOf('?'); query >= 0) {
+            target.truncate(query);
+        }
+        request.path = QUrl::fromPercentEncoding(target);
+        for(const QByteArray& line : lines) {
+            int colon = line.indexOf(':');
+            if(colon > 0) {
+                request.headers.insert(line.left(colon).trimmed().toLower(), line.mid(colon + 1).trimmed());
+            }
+        }
+        keepAlive = requestLine.at(2) == "HTTP/1.1" && request.headers.value("connection").toLower() != "close";
+
+        if(!co_await co_respond(*socket, request)) {
+            break;
+        }
+    }
+
+    socket->disconnectFromHost();
+    socket->deleteLater();
+}
+
+QCoro::Task<bool> ADBMediaServer::co_respond(QTcpSocket& socket, Request request) {
+    ADBStreamIO io{socket};
+    QByteArray connection = request.headers.value("connection").toLower() == "close" ? "close" : "keep-alive";
+    auto reply = [&](int status, const QByteArray& headers = {}) {
+        return statusLine(status) + headers + "Content-Length: 0\r\nConnection: " + connection + "\r\n\r\n";
+    };
+
+    if(request.method != "GET" && request.method != "HEAD") {
+        co_await io.write(reply(405, "Allow: GET, HEAD\r\n"));
+        co_return true;
+    }
+    QString prefix = "/" + QString::fromLatin1(m_token) + "/";
+    if(!request.path.startsWith(prefix) || !m_client) {
+        co_await io.write(reply(404));
+        co_return true;
+    }
+    QString path = request.path.mid(prefix.size() - 1);
+
+    ADBTraceSpan span{"http", "serve", path};
+    auto entry = co_await m_client->co_stat(path);
+    if(!entry || !S_ISREG(entry->mode)) {
+        co_await io.write(reply(404));
+        co_return true;
+    }
+
+    std::optional<qint64> fileSize = co_await co_fileSize(path, entry->time, entry->size);
+    if(!fileSize) {
+        qWarning() << "Cannot tell the size of" << path << ", not serving it";
+        co_await io.write(reply(500));
+        co_return true;
+    }
+    qint64 size = *fileSize;
+    qint64 first = 0;
+    qint64 last = size - 1;
+    int status = 200;
+    QByteArray range = request.headers.value("range");
+    if(!range.isEmpty() && !range.contains(',')) {
+        auto parsed = parseRange(range, size);
+        if(!parsed) {
+            co_await io.write(reply(416, "Content-Range: bytes */" + QByteArray::number(size) + "\r\n"));
+            co_return true;
+        }
+        std::tie(first, last) = *parsed;
+        status = 206;
+    }
+    qint64 length = size > 0 ? last - first + 1 : 0;
+
+    const ADBFileTypes::Type* type = ADBFileTypes::forFileName(path);
+    QByteArray headers = statusLine(status);
+    headers += "Content-Type: " + (type ? ADBFileTypes::mimeTypeName(type).toLatin1() : QByteArray{"application/octet-stream"}) + "\r\n";
+    headers += "Content-Length: " + QByteArray::number(length) + "\r\n";
+    if(status == 206) {
+        headers += "Content-Range: bytes " + QByteArray::number(first) + "-" + QByteArray::number(last) + "/" + QByteArray::number(size) + "\r\n";
+    }
+    headers += "Accept-Ranges: bytes\r\nConnection: " + connection + "\r\n\r\n";
+    if(co_await io.write(headers) <= 0) {
+        co_return false;
+    }
+    if(request.method == "HEAD" || length == 0) {
+        co_return true;
+    }
+
+    // Pieces end on pieceSize boundaries, so seeking back hits the blocks that are still cached.
+    // The next piece is already on its way while the current one goes out.
+    qint64 end = last + 1;
+    auto pieceEnd = [end](qint64 offset) {
+        return std::min((offset / pieceSize + 1) * pieceSize, end);
+    };
+    qint64 offset = first;
+    QCoro::Task<std::optional<QByteArray>> next = m_cache.co_read(path, entry->time, offset, pieceEnd(offset) - offset);
+    while(offset < end) {
+        std::optional<QByteArray> data = co_await next;
+        if(!data || data->isEmpty()) {
+            qWarning() << "Failed to read" << path << "at" << offset;
+            co_return false; // the promised length cannot be kept, only closing tells the player
+        }
+        qint64 nextOffset = offset + data->size();
+        if(nextOffset < end) {
+            next = m_cache.co_read(path, entry->time, nextOffset, pieceEnd(nextOffset) - nextOffset);
+        }
+        if(co_await io.write(*data) != data->size() || socket.state() != QAbstractSocket::ConnectedState) {
+            if(nextOffset < end) {
+                co_await next;
+            }
+            co_return false;
+        }
+        offset = nextOffset;
+    }
+    co_return true;
+}
+
+// Sync v1 STAT only has the lower 32 bits of the size, a 5 GiB video would be announced as 1 GiB and cut short.
+// The device tells the real size through stat, and where that fails a file is only served if it ends before 4 GiB.
+QCoro::Task<std::optional<qint64>> ADBMediaServer::co_fileSize(QString path, uint32_t time, uint32_t syncSize) {
+    auto cached = m_sizes.constFind(path);
+    if(cached != m_sizes.constEnd() && cached->first == time && static_cast<uint32_t>(cached->second) == syncSize) {
+        co_return cached->second;
+    }
+
+    std::optional<qint64> size = co_await m_client->co_fileSize(path);
+    if(!size) {
+        auto beyond = co_await m_client->co_readRange(path, qint64{1} << 32, 1);
+        if(!beyond || !beyond->isEmpty()) {
+            co_return std::nullopt;
+        }
+        size = syncSize;
+    }
+
+    if(m_sizes.size() >= maxCachedSizes) {
+        m_sizes.clear();
+    }
+    m_sizes.insert(path, {time, *size});
+    co_return size;
+}
@@ -0,0 +1,80 @@
+/*
+ * Copyright (C) 2025  JCM
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * waydroid-files is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ADB_MEDIA_SERVER_H
+#define ADB_MEDIA_SERVER_H
+
+#include <chrono>
+#include <optional>
+#include <utility>
+
+#include <QByteArray>
+#include <QHash>
+#include <QObject>
+#include <QUrl>
+
+#include <QCoro/QCoroTask>
+
+#include "adb_block_cache.h"
+
+class ADBClient;
+class QTcpServer;
+class QTcpSocket;
+
+// Serves device files over HTTP on localhost, with Range support, so a player can start and seek right away instead
+// of waiting for the whole file to be pulled. The bytes come from ranged reads through an in-memory block cache, and
+// the next piece is read while the current one is sent. Nothing is written to disk.
+// URLs carry a random token, so other local apps cannot browse the device through the server.
+class ADBMediaServer : public QObject {
+    Q_OBJECT
+
+public:
+    explicit ADBMediaServer(ADBClient* client);
+    ~ADBMediaServer();
+
+    // starts listening on first use, empty if that fails
+    QUrl urlFor(const QString& devicePath);
+private:
+    struct Request {
+        QByteArray method;
+        QString path;
+        QHash<QByteArray, QByteArray> headers; // names in lower case
+    };
+
+    static constexpr qint64 pieceSize = 1024 * 1024;
+    static constexpr int cacheBlocks = 256;
+    static constexpr int maxHeaderSize = 16 * 1024;
+    static constexpr std::chrono::milliseconds idleTimeout{30 * 1000};
+    static constexpr int maxCachedSizes = 1024;
+
+    ADBClient* m_client;
+    QTcpServer* m_server;
+    ADBBlockCache m_cache;
+    QByteArray m_token;
+    // real sizes by path, with the mtime they were read at
+    QHash<QString, std::pair<uint32_t, qint64>> m_sizes{};
+
+    // first and last byte, nullopt if the range cannot be satisfied
+    static std::optional<std::pair<qint64, qint64>> parseRange(const QByteArray& range, qint64 size);
+    static QByteArray statusLine(int status);
+
+    QCoro::Task<void> co_serve(QTcpSocket* socket);
+    // false if the connection has to be closed afterwards
+    QCoro::Task<bool> co_respond(QTcpSocket& socket, Request request);
+    QCoro::Task<std::optional<qint64>> co_fileSize(QString path, uint32_t time, uint32_t syncSize);
+};
+
+#endif
@@ -0,0 +1,320 @@
+/*
+ * Copyright (C) 2025  JCM
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * waydroid-files is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <iterator>
+#include <vector>
+
+#include <QAbstractItemModelTester>
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QRandomGenerator>
+
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
+#include "adb_folder_model.h"
+
+// waydroid-files-model-bench: how ADBFolderModel copes with large folders, without a device.
+// Synthetic listings go straight into setListing, so the numbers are the model's alone: the sort, the reset,
+// every role of data() and a scroll through the whole list, together with the memory and allocations they take.
+
+#ifdef __GLIBC__
+// Counts every heap allocation of the process by standing in for malloc and forwarding to glibc's own.
+extern "C" {
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t count, size_t size);
+void* __libc_realloc(void* ptr, size_t size);
+void __libc_free(void* ptr);
+}
+
+static std::atomic<qint64> allocations{0};
+static std::atomic<qint64> liveBytes{0};
+
+extern "C" void* malloc(size_t size) {
+    void* ptr = __libc_malloc(size);
+    if(ptr) {
+        allocations.fetch_add(1, std::memory_order_relaxed);
+        liveBytes.fetch_add(static_cast<qint64>(malloc_usable_size(ptr)), std::memory_order_relaxed);
+    }
+    return ptr;
+}
+extern "C" void* calloc(size_t count, size_t size) {
+    void* ptr = __libc_calloc(count, size);
+    if(ptr) {
+        allocations.fetch_add(1, std::memory_order_relaxed);
+        liveBytes.fetch_add(static_cast<qint64>(malloc_usable_size(ptr)), std::memory_order_relaxed);
+    }
+    return ptr;
+}
+extern "C" void* realloc(void* old, size_t size) {
+    qint64 before = old ? static_cast<qint64>(malloc_usable_size(old)) : 0;
+    void* ptr = __libc_realloc(old, size);
+    if(ptr) {
+        allocations.fetch_add(1, std::memory_order_relaxed);
+        liveBytes.fetch_add(static_cast<qint64>(malloc_usable_size(ptr)) - before, std::memory_order_relaxed);
+    } else if(size == 0) {
+        liveBytes.fetch_sub(before, std::memory_order_relaxed);
+    }
+    return ptr;
+}
+extern "C" void free(void* ptr) {
+    if(ptr) {
+        liveBytes.fetch_sub(static_cast<qint64>(malloc_usable_size(ptr)), std::memory_order_relaxed);
+    }
+    __libc_free(ptr);
+}
+
+static bool countingAllocations() { return true; }
+#else
+static std::atomic<qint64> allocations{0};
+static std::atomic<qint64> liveBytes{0};
+static bool countingAllocations() { return false; }
+#endif
+
+static bool json = false;
+
+static void print(const QString& line) {
+    std::fputs(qPrintable(line + '\n'), stdout);
+}
+
+static qint64 currentRss() {
+    QFile statm("/proc/self/statm");
+    if(!statm.open(QIODevice::ReadOnly)) {
+        return 0;
+    }
+    // size resident shared ..., in pages
+    return statm.readAll().split(' ').value(1).toLongLong() * sysconf(_SC_PAGESIZE);
+}
+
+static qint64 peakRss() {
+    struct rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+    return static_cast<qint64>(usage.ru_maxrss) * 1024;
+}
+
+// Roughly what a phone's storage looks like: a tenth folders, the rest mostly media and documents with names
+// that share prefixes the way camera and download names do.
+static std::vector<ADBFileEntry> syntheticListing(int count, quint32 seed) {
+    static const char* extensions[] = {
+        "jpg", "jpg", "jpg", "png", "mp4", "mp3", "pdf", "txt", "apk", "zip", "json", "", "JPG", "webp", "ogg",
+    };
+    static const char* prefixes[] = {"IMG_", "VID_", "Screenshot_", "document-", "Download ", "backup.", "a", "Z"};
+
+    QRandomGenerator random(seed);
+    std::vector<ADBFileEntry> entries{};
+    entries.reserve(static_cast<size_t>(count) + 2);
+    entries.push_back(ADBFileEntry{".", S_IFDIR | 0771, 4096, 1700000000});
+    entries.push_back(ADBFileEntry{"..", S_IFDIR | 0771, 4096, 1700000000});
+    for(int i = 0; i < count; i++) {
+        uint32_t time = 1500000000 + random.bounded(250000000u);
+        QString name = QString::fromLatin1(prefixes[random.bounded(static_cast<int>(std::size(prefixes)))]) +
+            QString::number(random.bounded(100000000u)) + "_" + QString::number(i, 36);
+        if(random.bounded(10) == 0) {
+            entries.push_back(ADBFileEntry{name, S_IFDIR | 0771, 4096, time});
+            continue;
+        }
+        const char* extension = extensions[random.bounded(static_cast<int>(std::size(extensions)))];
+        if(*extension) {
+            name += "." + QString::fromLatin1(extension);
+        }
+        // a few symlinks and sockets so the "everything else" group is not empty
+        uint32_t type = random.bounded(100) == 0 ? S_IFLNK : random.bounded(1000) == 0 ? S_IFSOCK : S_IFREG;
+        entries.push_back(ADBFileEntry{name, type | 0660, random.bounded(1u << 26), time});
+    }
+    return entries;
+}
+
+// setListing, selection and a second listing under QAbstractItemModelTester, which aborts on the first
+// inconsistency; the timed runs below do not have it attached.
+static void checkModel(int count, quint32 seed) {
+    ADBFolderModel model{};
+    QAbstractItemModelTester tester(&model, QAbstractItemModelTester::FailureReportingMode::Fatal);
+    model.setListing(syntheticListing(count, seed));
+    model.selectRange(count / 4, count / 2);
+    model.setListing(syntheticListing(count, seed));
+    model.invertSelection();
+    model.clearSelection();
+    model.setListing({});
+}
+
+struct Measure {
+    QElapsedTimer timer{};
+    qint64 allocationsBefore = allocations.load();
+
+    Measure() { timer.start(); }
+    qint64 nsecs() const { return timer.nsecsElapsed(); }
+    qint64 allocated() const { return allocations.load() - allocationsBefore; }
+};
+
+static QJsonObject benchmark(int count, quint32 seed, int viewport) {
+    QJsonObject result{{"entries", count}};
+    {
+        std::vector<ADBFileEntry> entries = syntheticListing(count, seed);
+        Measure measure{};
+        std::sort(entries.begin(), entries.end(), &ADBFolderModel::entryLessThan);
+        result.insert("sortMs", measure.nsecs() / 1e6);
+    }
+
+    // freed again before the baseline, so only what the model keeps is counted
+    qint64 rssBefore = currentRss();
+    qint64 liveBefore = liveBytes.load();
+    std::vector<ADBFileEntry> entries = syntheticListing(count, seed);
+    ADBFolderModel model{};
+    {
+        Measure measure{};
+        model.setListing(std::move(entries));
+        result.insert("setListingMs", measure.nsecs() / 1e6);
+        result.insert("setListingAllocations", measure.allocated());
+    }
+    int rows = model.rowCount({});
+    // the model now holds everything that was allocated for the listing
+    result.insert("rssPerEntry", static_cast<double>(currentRss() - rssBefore) / std::max(rows, 1));
+    if(countingAllocations()) {
+        result.insert("heapPerEntry", static_cast<double>(liveBytes.load() - liveBefore) / std::max(rows, 1));
+    }
+
+    QHash<int, QByteArray> roles = model.roleNames();
+    QList<int> roleIds = roles.keys();
+    std::sort(roleIds.begin(), roleIds.end());
+    QJsonObject perRole{};
+    for(int role : roleIds) {
+        Measure measure{};
+        for(int row = 0; row < rows; row++) {
+            QVariant value = model.data(model.index(row), role);
+            Q_UNUSED(value);
+        }
+        perRole.insert(QString::fromLatin1(roles.value(role)), QJsonObject{
+            {"nsPerCall", static_cast<double>(measure.nsecs()) / std::max(rows, 1)},
+            {"allocationsPerCall", static_cast<double>(measure.allocated()) / std::max(rows, 1)},
+        });
+    }
+    result.insert("data", perRole);
+
+    // a page at a time from top to bottom, the way a ListView creates delegates that read every role
+    qint64 slowest = 0;
+    qint64 steps = 0;
+    Measure scroll{};
+    for(int first = 0; first < rows; first += viewport) {
+        int last = std::min(first + viewport, rows) - 1;
+        QElapsedTimer step{};
+        step.start();
+        model.setVisibleRange(first, last);
+        for(int row = first; row <= last; row++) {
+            QModelIndex index = model.index(row);
+            for(int role : roleIds) {
+                QVariant value = model.data(index, role);
+                Q_UNUSED(value);
+            }
+        }
+        slowest = std::max(slowest, step.nsecsElapsed());
+        steps++;
+    }
+    result.insert("scroll", QJsonObject{
+        {"steps", steps},
+        {"totalMs", scroll.nsecs() / 1e6},
+        {"averageUs", steps ? static_cast<double>(scroll.nsecs()) / steps / 1e3 : 0.0},
+        {"slowestUs", slowest / 1e3},
+        {"allocations", scroll.allocated()},
+    });
+    result.insert("peakRss", peakRss());
+    return result;
+}
+
+static void printResult(const QJsonObject& result) {
+    print(QStringLiteral("%1 entries").arg(result.value("entries").toInt()));
+    print(QStringLiteral("  sort\t\t%1 ms").arg(result.value("sortMs").toDouble(), 0, 'f', 2));
+    print(QStringLiteral("  setListing\t%1 ms\t%2 allocations")
+        .arg(result.value("setListingMs").toDouble(), 0, 'f', 2).arg(result.value("setListingAllocations").toInt()));
+    QString memory = QStringLiteral("  memory\t%1 B/entry resident").arg(result.value("rssPerEntry").toDouble(), 0, 'f', 1);
+    if(result.contains("heapPerEntry")) {
+        memory += QStringLiteral(", %1 B/entry heap").arg(result.value("heapPerEntry").toDouble(), 0, 'f', 1);
+    }
+    print(memory);
+
+    QJsonObject perRole = result.value("data").toObject();
+    for(auto it = perRole.constBegin(); it != perRole.constEnd(); ++it) {
+        QJsonObject role = it->toObject();
+        print(QStringLiteral("  data %1\t%2 ns/call\t%3 allocations/call").arg(it.key(), -16)
+            .arg(role.value("nsPerCall").toDouble(), 0, 'f', 1).arg(role.value("allocationsPerCall").toDouble(), 0, 'f', 2));
+    }
+
+    QJsonObject scroll = result.value("scroll").toObject();
+    print(QStringLiteral("  scroll\t%1 steps in %2 ms, %3 us average, %4 us slowest")
+        .arg(scroll.value("steps").toInt()).arg(scroll.value("totalMs").toDouble(), 0, 'f', 2)
+        .arg(scroll.value("averageUs").toDouble(), 0, 'f', 1).arg(scroll.value("slowestUs").toDouble(), 0, 'f', 1));
+    print(QStringLiteral("  peak RSS\t%1 MiB").arg(result.value("peakRss").toDouble() / (1024 * 1024), 0, 'f', 1));
+}
+
+int main(int argc, char** argv) {
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("waydroid-files-model-bench");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Measures the folder model on synthetic listings of the given sizes.");
+    parser.addHelpOption();
+    parser.addOptions({
+        {"json", "Print the results as JSON."},
+        {"sizes", "Comma separated numbers of entries to measure.", "sizes", "1000,100000,1000000"},
+        {"seed", "Seed of the synthetic listings.", "seed", "1"},
+        {"viewport", "Rows visible at once while scrolling.", "rows", "20"},
+        {"no-check", "Skip the QAbstractItemModelTester pass."},
+    });
+    parser.process(app);
+    json = parser.isSet("json");
+
+    std::vector<int> sizes{};
+    for(const QString& size : parser.value("sizes").split(',', QString::SkipEmptyParts)) {
+        bool ok = false;
+        int count = size.trimmed().toInt(&ok);
+        if(!ok || count < 0) {
+            qWarning() << "Invalid size" << size;
+            return 1;
+        }
+        sizes.push_back(count);
+    }
+    quint32 seed = parser.value("seed").toUInt();
+    int viewport = std::max(parser.value("viewport").toInt(), 1);
+
+    if(!parser.isSet("no-check")) {
+        checkModel(1000, seed);
+    }
+
+    QJsonArray results{};
+    for(int count : sizes) {
+        QJsonObject result = benchmark(count, seed, viewport);
+        json ? results.append(result) : printResult(result);
+    }
+    if(json) {
+        print(QString::fromUtf8(QJsonDocument(QJsonObject{
+            {"countingAllocations", countingAllocations()},
+            {"results", results},
+        }).toJson(QJsonDocument::Compact)));
+    }
+    return 0;
+}
@@ -0,0 +1,82 @@
+/*
+ * Copyright (C) 2025  JCM
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * waydroid-files is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "adb_session_pool.h"
+
+#include <QAbstractSocket>
+#include <QDateTime>
+
+#include "adb_trace.h"
+
+ADBSession::ADBSession(ADBSessionPool* pool, std::unique_ptr<QIODevice> socket, quint64 generation)
+    : m_pool(pool), m_socket(std::move(socket)), m_generation(generation) {
+}
+
+ADBSession::~ADBSession() {
+    if(m_socket && m_pool && m_done) {
+        m_pool->release(std::move(m_socket), m_generation);
+    }
+}
+
+ADBSessionPool::ADBSessionPool(QByteArray service, int maxIdle) : m_service(service), m_maxIdle(maxIdle) {
+}
+
+void ADBSessionPool::setTransport(std::shared_ptr<ADBTransport> transport) {
+    m_transport = std::move(transport);
+    m_idle.clear();
+    m_generation++;
+}
+
+bool ADBSessionPool::usable(QIODevice& device) {
+    if(auto* socket = qobject_cast<QAbstractSocket*>(&device)) {
+        return socket->state() == QAbstractSocket::ConnectedState;
+    }
+    return device.isOpen() && !device.atEnd();
+}
+
+QCoro::Task<ADBSession> ADBSessionPool::co_acquire() {
+    ADBTraceSpan span{"session", "acquire", QString::fromUtf8(m_service)};
+    qint64 now = QDateTime::currentMSecsSinceEpoch();
+    while(!m_idle.empty()) {
+        Idle idle = std::move(m_idle.back());
+        m_idle.pop_back();
+
+        // the server closes sessions when the device goes away, and unread data means a previous user left it dirty
+        if(usable(*idle.socket) && idle.socket->bytesAvailable() == 0 && now - idle.since < maxIdleTime) {
+            span.setDetail(QString::fromUtf8(m_service) + " (reused)");
+            co_return ADBSession{this, std::move(idle.socket), m_generation};
+        }
+    }
+
+    // keep the transport alive even if it gets replaced while we are connecting
+    std::shared_ptr<ADBTransport> transport = m_transport;
+    quint64 generation = m_generation;
+    std::unique_ptr<QIODevice> socket = co_await transport->co_open(m_service);
+    if(!socket) {
+        co_return ADBSession{};
+    }
+    co_return ADBSession{this, std::move(socket), generation};
+}
+
+void ADBSessionPool::release(std::unique_ptr<QIODevice> socket, quint64 generation) {
+    if(generation != m_generation || !usable(*socket) || static_cast<int>(m_idle.size()) >= m_maxIdle) {
+        return;
+    }
+    m_idle.push_back(Idle{std::move(socket), QDateTime::currentMSecsSinceEpoch()});
+}
+
+void ADBSessionPool::clear() {
+    m_idle.clear();
+}
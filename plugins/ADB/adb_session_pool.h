@@ -0,0 +1,86 @@
+/*
+ * Copyright (C) 2025  JCM
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * waydroid-files is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ADB_SESSION_POOL_H
+#define ADB_SESSION_POOL_H
+
+#include <memory>
+#include <vector>
+
+#include <QByteArray>
+#include <QIODevice>
+
+#include <QCoro/QCoroTask>
+
+#include "adb_transport.h"
+
+class ADBSessionPool;
+
+// A stream borrowed from an ADBSessionPool. It only goes back to the pool if done() was called,
+// which marks the conversation as cleanly finished. Anything else (errors, FAIL) closes it.
+class ADBSession {
+public:
+    ADBSession() = default;
+    ADBSession(ADBSessionPool* pool, std::unique_ptr<QIODevice> socket, quint64 generation);
+    ADBSession(ADBSession&& other) = default;
+    ADBSession& operator=(ADBSession&& other) = default;
+    ~ADBSession();
+
+    explicit operator bool() const { return m_socket != nullptr; }
+    QIODevice& socket() { return *m_socket; }
+
+    void done() { m_done = true; }
+private:
+    ADBSessionPool* m_pool = nullptr;
+    std::unique_ptr<QIODevice> m_socket{};
+    quint64 m_generation = 0;
+    bool m_done = false;
+};
+
+// Keeps connections that already went through the transport and service handshake (e.g. "sync:"),
+// so back to back requests skip connecting to the adb server and selecting the device again.
+class ADBSessionPool {
+public:
+    ADBSessionPool(QByteArray service, int maxIdle = 4);
+    ~ADBSessionPool() = default;
+
+    // Drops all idle sessions, since they belong to the previous transport. Sessions still in use are not taken back.
+    void setTransport(std::shared_ptr<ADBTransport> transport);
+
+    QCoro::Task<ADBSession> co_acquire();
+    // generation is the one the session was opened in, sessions of an older transport are closed instead
+    void release(std::unique_ptr<QIODevice> socket, quint64 generation);
+    void clear();
+
+    // still connected, without having read the end of the stream
+    static bool usable(QIODevice& device);
+private:
+    struct Idle {
+        std::unique_ptr<QIODevice> socket;
+        qint64 since;
+    };
+
+    static constexpr qint64 maxIdleTime = 30 * 1000;
+
+    std::shared_ptr<ADBTransport> m_transport = std::make_shared<ADBServerTransport>();
+    QByteArray m_service;
+    int m_maxIdle;
+    std::vector<Idle> m_idle{};
+    // counts setTransport calls
+    quint64 m_generation = 0;
+};
+
+#endif
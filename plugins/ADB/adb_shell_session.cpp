@@ -0,0 +1,152 @@
+/*
+ * Copyright (C) 2025  JCM
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * waydroid-files is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "adb_shell_session.h"
+
+#include <QDebug>
+#include <QRandomGenerator>
+#include <QScopeGuard>
+#include <QtEndian>
+
+#include <QCoro/QCoroSignal>
+
+#include "adb_session_pool.h"
+#include "adb_trace.h"
+
+void ADBShellSession::setTransport(std::shared_ptr<ADBTransport> transport) {
+    m_transport = std::move(transport);
+    // a running batch may be suspended in a read on the stream, it is dropped once that batch is over
+    if(m_busy) {
+        m_transportChanged = true;
+    } else {
+        m_stream.reset();
+    }
+}
+
+QCoro::Task<bool> ADBShellSession::co_open() {
+    if(m_stream && ADBSessionPool::usable(*m_stream)) {
+        co_return true;
+    }
+
+    // raw, because a pty would echo the commands back and mangle the output
+    std::shared_ptr<ADBTransport> transport = m_transport;
+    m_stream = co_await transport->co_open("shell,v2,raw:");
+    if(!m_stream) {
+        qWarning() << "Failed to start a shell, does the device support shell protocol v2?";
+        co_return false;
+    }
+
+    m_marker = "\x1e" "waydroid-files-" + QByteArray::number(QRandomGenerator::global()->generate64(), 16);
+    m_packets.clear();
+    m_output.clear();
+    co_return true;
+}
+
+QCoro::Task<bool> ADBShellSession::co_readMore() {
+    ADBStreamIO io{*m_stream};
+    QByteArray chunk = co_await io.read(64 * 1024);
+    if(chunk.isEmpty()) {
+        co_return false;
+    }
+    m_packets += chunk;
+
+    bool exited = false;
+    while(m_packets.size() >= headerSize) {
+        quint32 length = qFromLittleEndian<quint32>(m_packets.constData() + 1);
+        if(static_cast<quint32>(m_packets.size() - headerSize) < length) {
+            break;
+        }
+        char id = m_packets.at(0);
+        if(id == Stdout || id == Stderr) {
+            m_output += m_packets.mid(headerSize, static_cast<int>(length));
+        } else if(id == Exit) {
+            exited = true;
+        }
+        m_packets.remove(0, headerSize + static_cast<int>(length));
+    }
+    co_return !exited;
+}
+
+QCoro::Task<std::vector<ADBShellResult>> ADBShellSession::co_run(QStringList commands) {
+    std::vector<ADBShellResult> results(static_cast<size_t>(commands.size()));
+    if(commands.isEmpty()) {
+        co_return results;
+    }
+
+    while(m_busy) {
+        co_await qCoro(this, &ADBShellSession::idle);
+    }
+    m_busy = true;
+    auto release = qScopeGuard([this]() {
+        if(m_transportChanged) {
+            m_transportChanged = false;
+            m_stream.reset();
+        }
+        m_busy = false;
+        emit idle();
+    });
+
+    ADBTraceSpan span{"shell", "batch", QString::number(commands.size())};
+    if(!co_await co_open()) {
+        co_return results;
+    }
+
+    // Each command gets /dev/null as stdin, otherwise it could eat the commands after it.
+    // The marker starts on a fresh line, so the newline before it is not part of the output.
+    QByteArray script{};
+    for(int i = 0; i < commands.size(); i++) {
+        script += "{ " + commands.at(i).toUtf8() + "\n} </dev/null 2>&1; printf '\\n%s %d %d\\n' '" + m_marker + "' "
+            + QByteArray::number(i) + " $?\n";
+    }
+    ADBStreamIO io{*m_stream};
+    for(int offset = 0; offset < script.size(); offset += maxStdinPacket) {
+        QByteArray payload = script.mid(offset, maxStdinPacket);
+        QByteArray packet(headerSize, Stdin);
+        qToLittleEndian<quint32>(static_cast<quint32>(payload.size()), packet.data() + 1);
+        if(co_await io.write(packet + payload) <= 0) {
+            qWarning() << "Failed to send commands to the shell";
+            m_stream.reset();
+            co_return results;
+        }
+    }
+
+    QByteArray separator = "\n" + m_marker + " ";
+    int finished = 0;
+    while(finished < commands.size()) {
+        int start = m_output.indexOf(separator);
+        int end = start < 0 ? -1 : m_output.indexOf('\n', start + separator.size());
+        if(end < 0) {
+            if(!co_await co_readMore()) {
+                qWarning() << "Shell ended after" << finished << "of" << commands.size() << "commands";
+                m_stream.reset();
+                break;
+            }
+            continue;
+        }
+
+        QList<QByteArray> fields = m_output.mid(start + separator.size(), end - start - separator.size()).split(' ');
+        bool okay = fields.size() == 2;
+        int index = okay ? fields.at(0).toInt(&okay) : -1;
+        int status = okay ? fields.at(1).toInt(&okay) : -1;
+        if(okay && index >= 0 && index < commands.size()) {
+            results[static_cast<size_t>(index)] = ADBShellResult{status, m_output.left(start)};
+        } else {
+            qWarning() << "Protocol error, malformed command marker" << m_output.mid(start, end - start);
+        }
+        m_output.remove(0, end + 1);
+        finished++;
+    }
+    co_return results;
+}
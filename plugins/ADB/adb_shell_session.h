@@ -0,0 +1,81 @@
+/*
+ * Copyright (C) 2025  JCM
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * waydroid-files is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ADB_SHELL_SESSION_H
+#define ADB_SHELL_SESSION_H
+
+#include <memory>
+#include <vector>
+
+#include <QByteArray>
+#include <QIODevice>
+#include <QObject>
+#include <QStringList>
+
+#include <QCoro/QCoroTask>
+
+#include "adb_transport.h"
+
+struct ADBShellResult {
+    // -1 if the session broke before the command finished
+    int exitStatus = -1;
+    // stdout and stderr together
+    QByteArray output{};
+};
+
+// One long running "shell,v2,raw:" session that takes commands in batches. A whole batch goes out at once and a
+// marker line after each command tells where its output ends and what it exited with, so a hundred small commands
+// cost about one round trip instead of a connection and a shell each.
+class ADBShellSession : public QObject {
+    Q_OBJECT
+
+public:
+    ADBShellSession() = default;
+    ~ADBShellSession() = default;
+
+    // Closes the shell, or after the running batch if there is one. The next batch starts one on the new transport.
+    void setTransport(std::shared_ptr<ADBTransport> transport);
+
+    // Results in the order of the commands. Batches from concurrent callers run one after the other.
+    QCoro::Task<std::vector<ADBShellResult>> co_run(QStringList commands);
+signals:
+    void idle();
+private:
+    // shell protocol v2 packet ids, each packet starts with the id and a little endian 32 bit length
+    enum PacketId : char {
+        Stdin = 0,
+        Stdout = 1,
+        Stderr = 2,
+        Exit = 3,
+    };
+    static constexpr int headerSize = 5;
+    static constexpr int maxStdinPacket = 64 * 1024;
+
+    std::shared_ptr<ADBTransport> m_transport = std::make_shared<ADBServerTransport>();
+    std::unique_ptr<QIODevice> m_stream{};
+    bool m_busy = false;
+    bool m_transportChanged = false;
+
+    // random per shell, so file names or contents printed by a command cannot pass for it
+    QByteArray m_marker{};
+    QByteArray m_packets{};
+    QByteArray m_output{};
+
+    QCoro::Task<bool> co_open();
+    QCoro::Task<bool> co_readMore();
+};
+
+#endif
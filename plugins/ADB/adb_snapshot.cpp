@@ -0,0 +1,148 @@
+/*
+ * Copyright (C) 2025  JCM
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * waydroid-files is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "adb_snapshot.h"
+
+#include <cstring>
+
+#include <QDebug>
+#include <QFile>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QtEndian>
+
+namespace {
+    constexpr char snapshotMagic[4] = {'W', 'F', 'S', '1'};
+
+    struct [[gnu::packed]] snapshot_header {
+        char magic[4];
+        uint32_t serialLength;
+        uint32_t homeLength;
+        uint32_t pathLength;
+        uint32_t entryCount;
+    };
+    struct [[gnu::packed]] snapshot_entry {
+        uint32_t mode;
+        uint32_t size;
+        uint32_t time;
+        uint32_t namelen;
+    };
+
+    void appendRaw(QByteArray& data, const void* value, size_t size) {
+        data.append(static_cast<const char*>(value), static_cast<int>(size));
+    }
+}
+
+QString ADBSnapshot::defaultLocation() {
+    return QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/last-session.snapshot";
+}
+
+std::optional<ADBSnapshot> ADBSnapshot::load(const QString& fileName) {
+    QFile file{fileName};
+    if(!file.open(QIODevice::ReadOnly)) {
+        return std::nullopt;
+    }
+    qint64 size = file.size();
+    const uchar* data = file.map(0, size);
+    if(!data) {
+        qWarning() << "Failed to map snapshot" << fileName;
+        return std::nullopt;
+    }
+
+    qint64 pos = 0;
+    auto take = [&](qint64 length) -> const char* {
+        if(length < 0 || pos + length > size) {
+            return nullptr;
+        }
+        const char* p = reinterpret_cast<const char*>(data + pos);
+        pos += length;
+        return p;
+    };
+
+    const snapshot_header* header = reinterpret_cast<const snapshot_header*>(take(sizeof(snapshot_header)));
+    if(!header || memcmp(header->magic, snapshotMagic, sizeof(snapshotMagic)) != 0) {
+        return std::nullopt;
+    }
+
+    ADBSnapshot snapshot;
+    const char* serial = take(qFromLittleEndian(header->serialLength));
+    const char* home = take(qFromLittleEndian(header->homeLength));
+    const char* path = take(qFromLittleEndian(header->pathLength));
+    if(!serial || !home || !path) {
+        return std::nullopt;
+    }
+    snapshot.deviceSerial = QString::fromUtf8(serial, qFromLittleEndian(header->serialLength));
+    snapshot.homePath = QString::fromUtf8(home, qFromLittleEndian(header->homeLength));
+    snapshot.currentPath = QString::fromUtf8(path, qFromLittleEndian(header->pathLength));
+
+    uint32_t count = qFromLittleEndian(header->entryCount);
+    snapshot.entries.reserve(std::min<qint64>(count, size / sizeof(snapshot_entry)));
+    for(uint32_t i = 0; i < count; i++) {
+        const snapshot_entry* raw = reinterpret_cast<const snapshot_entry*>(take(sizeof(snapshot_entry)));
+        if(!raw) {
+            return std::nullopt;
+        }
+        const char* name = take(qFromLittleEndian(raw->namelen));
+        if(!name) {
+            return std::nullopt;
+        }
+
+        ADBFileEntry entry;
+        entry.fileName = QString::fromUtf8(name, qFromLittleEndian(raw->namelen));
+        entry.mode = qFromLittleEndian(raw->mode);
+        entry.size = qFromLittleEndian(raw->size);
+        entry.time = qFromLittleEndian(raw->time);
+        snapshot.entries.push_back(entry);
+    }
+    return snapshot;
+}
+
+bool ADBSnapshot::save(const QString& fileName) const {
+    QByteArray serial = deviceSerial.toUtf8();
+    QByteArray home = homePath.toUtf8();
+    QByteArray path = currentPath.toUtf8();
+
+    snapshot_header header;
+    memcpy(header.magic, snapshotMagic, sizeof(snapshotMagic));
+    header.serialLength = qToLittleEndian<uint32_t>(serial.size());
+    header.homeLength = qToLittleEndian<uint32_t>(home.size());
+    header.pathLength = qToLittleEndian<uint32_t>(path.size());
+    header.entryCount = qToLittleEndian<uint32_t>(entries.size());
+
+    QByteArray data{};
+    appendRaw(data, &header, sizeof(header));
+    data += serial;
+    data += home;
+    data += path;
+    for(const ADBFileEntry& entry : entries) {
+        QByteArray name = entry.fileName.toUtf8();
+        snapshot_entry raw{
+            qToLittleEndian(entry.mode),
+            qToLittleEndian(entry.size),
+            qToLittleEndian(entry.time),
+            qToLittleEndian<uint32_t>(name.size()),
+        };
+        appendRaw(data, &raw, sizeof(raw));
+        data += name;
+    }
+
+    QSaveFile file{fileName};
+    if(!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "Failed to open snapshot for writing:" << fileName;
+        return false;
+    }
+    file.write(data);
+    return file.commit();
+}
@@ -0,0 +1,40 @@
+/*
+ * Copyright (C) 2025  JCM
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * waydroid-files is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ADB_SNAPSHOT_H
+#define ADB_SNAPSHOT_H
+
+#include <optional>
+#include <vector>
+
+#include <QString>
+
+#include "adb_client.h"
+
+// What was on screen when the app was last used, so the next start can show it before the device is reachable.
+// Stored as a flat little endian file that is read straight out of a memory mapping.
+struct ADBSnapshot {
+    QString deviceSerial;
+    QString homePath;
+    QString currentPath;
+    std::vector<ADBFileEntry> entries;
+
+    static QString defaultLocation();
+    static std::optional<ADBSnapshot> load(const QString& fileName);
+    bool save(const QString& fileName) const;
+};
+
+#endif
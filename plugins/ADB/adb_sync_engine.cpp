@@ -0,0 +1,417 @@
+/*
+ * Copyright (C) 2025  JCM
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * waydroid-files is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "adb_sync_engine.h"
+
+#include <algorithm>
+#include <iterator>
+
+#include <QCryptographicHash>
+#include <QSet>
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QStandardPaths>
+
+#include <QtConcurrent>
+
+#include <QCoro/QCoroFuture>
+
+#include <sys/stat.h>
+
+#include "adb_hash_cache.h"
+
+static bool sameEntry(const std::optional<ADBSyncEntry>& a, const ADBSyncEntry& b) {
+    return a && a->size == b.size && a->time == b.time;
+}
+
+static bool isBelow(const QString& path, const QStringList& folders) {
+    for(const QString& folder : folders) {
+        if(folder.isEmpty() || path.startsWith(folder + "/")) {
+            return true;
+        }
+    }
+    return false;
+}
+
+ADBSyncEngine::ADBSyncEngine(QObject* parent) : QObject(parent) {
+}
+
+ADBSyncManifest ADBSyncEngine::hostManifest(const QString& root) {
+    ADBSyncManifest manifest{};
+    QDir rootDir{root};
+    if(!rootDir.exists()) {
+        return manifest;
+    }
+
+    QDirIterator it(root, QDir::Files | QDir::Dirs | QDir::NoDotAndDotDot | QDir::Hidden, QDirIterator::Subdirectories);
+    while(it.hasNext()) {
+        it.next();
+        QFileInfo info = it.fileInfo();
+        QString relative = rootDir.relativeFilePath(info.filePath());
+        if(info.isSymLink()) {
+            continue;
+        }
+        if(info.isDir()) {
+            manifest.folders.append(relative);
+            if(!info.isReadable() || !info.isExecutable()) {
+                manifest.incomplete.append(relative);
+            }
+            continue;
+        }
+        if(info.isFile()) {
+            manifest.files.insert(relative, ADBSyncEntry{info.size(), info.lastModified().toSecsSinceEpoch()});
+        }
+    }
+    return manifest;
+}
+
+QCoro::Task<ADBSyncManifest> ADBSyncEngine::co_deviceManifest(ADBClient& client, QString root, int parallel) {
+    ADBSyncManifest manifest{};
+
+    auto rootEntry = co_await client.co_stat(root);
+    if(!rootEntry) {
+        manifest.valid = false;
+        co_return manifest;
+    }
+    if(rootEntry->mode == 0) {
+        co_return manifest; // not there yet, the first push creates it
+    }
+
+    // One level at a time, with a few listings in flight, since every folder costs a round trip.
+    parallel = std::max(parallel, 1);
+    QStringList level{""};
+    while(!level.isEmpty()) {
+        QStringList next{};
+        for(qsizetype start = 0; start < level.size(); start += parallel) {
+            std::vector<std::pair<QString, QCoro::Task<std::vector<ADBFileEntry>>>> listings{};
+            for(qsizetype i = start; i < std::min<qsizetype>(start + parallel, level.size()); i++) {
+                const QString& folder = level.at(i);
+                listings.emplace_back(folder, client.co_listFiles(folder.isEmpty() ? root : root + "/" + folder, ADBIOScheduler::Priority::Bulk));
+            }
+            for(auto& [folder, listing] : listings) {
+                std::vector<ADBFileEntry> entries = co_await listing;
+                // even an empty folder lists "." and "..", so nothing at all means the listing failed
+                if(entries.empty()) {
+                    if(folder.isEmpty()) {
+                        manifest.valid = false;
+                        co_return manifest;
+                    }
+                    manifest.incomplete.append(folder);
+                    continue;
+                }
+                for(const ADBFileEntry& entry : entries) {
+                    if(entry.fileName == "." || entry.fileName == "..") {
+                        continue;
+                    }
+                    QString relative = folder.isEmpty() ? entry.fileName : folder + "/" + entry.fileName;
+                    if(S_ISDIR(entry.mode)) {
+                        manifest.folders.append(relative);
+                        next.append(relative);
+                    } else if(S_ISREG(entry.mode)) {
+                        manifest.files.insert(relative, ADBSyncEntry{entry.size, entry.time});
+                    }
+                }
+            }
+        }
+        level = next;
+    }
+    co_return manifest;
+}
+
+QString ADBSyncEngine::stateFile(const QString& serial) const {
+    QByteArray id = QCryptographicHash::hash((serial + '\n' + QDir::cleanPath(m_hostPath) + '\n' + QDir::cleanPath(m_devicePath)).toUtf8(), QCryptographicHash::Sha1).toHex();
+    return QStandardPaths::writableLocation(QStandardPaths::AppDataLocation) + "/sync/" + QString::fromLatin1(id);
+}
+
+QHash<QString, ADBSyncEngine::Base> ADBSyncEngine::loadState(const QString& file) {
+    QHash<QString, Base> base{};
+    QFile f{file};
+    if(!f.open(QIODevice::ReadOnly)) {
+        return base;
+    }
+    // <host size> <host mtime> <device size> <device mtime> <path>
+    while(!f.atEnd()) {
+        QByteArray line = f.readLine();
+        line.chop(1);
+        QList<QByteArray> fields = line.split(' ');
+        if(fields.size() < 5) {
+            continue;
+        }
+        qsizetype prefix = 4;
+        for(int i = 0; i < 4; i++) {
+            prefix += fields.at(i).size();
+        }
+        base.insert(QString::fromUtf8(line.mid(prefix)), Base{
+            {fields.at(0).toLongLong(), fields.at(1).toLongLong()},
+            {fields.at(2).toLongLong(), fields.at(3).toLongLong()},
+        });
+    }
+    return base;
+}
+
+void ADBSyncEngine::saveState(const QString& file, const QHash<QString, Base>& base) {
+    QDir().mkpath(QFileInfo(file).absolutePath());
+    QSaveFile f{file};
+    if(!f.open(QIODevice::WriteOnly)) {
+        qWarning() << "Failed to save sync state to" << file;
+        return;
+    }
+    for(auto it = base.constBegin(); it != base.constEnd(); ++it) {
+        if(it.key().contains('\n')) {
+            continue;
+        }
+        f.write(QByteArray::number(it->host.size) + ' ' + QByteArray::number(it->host.time) + ' ' +
+            QByteArray::number(it->device.size) + ' ' + QByteArray::number(it->device.time) + ' ' + it.key().toUtf8() + '\n');
+    }
+    f.commit();
+}
+
+QCoro::Task<QVariantMap> ADBSyncEngine::co_sync() {
+    if(m_running || !m_adbClient || m_hostPath.isEmpty() || m_devicePath.isEmpty()) {
+        qWarning() << "Cannot start sync, it is either running already or not set up";
+        co_return QVariantMap{};
+    }
+    m_running = true;
+    emit runningChanged();
+    m_done = 0;
+    m_total = 0;
+    emit progressChanged();
+
+    QString serial = co_await m_adbClient->co_serial();
+    QString file = stateFile(serial);
+
+    QFuture<ADBSyncManifest> hostFuture = QtConcurrent::run(&ADBSyncEngine::hostManifest, m_hostPath);
+    ADBSyncManifest device = co_await co_deviceManifest(*m_adbClient, m_devicePath, m_parallelTransfers + 1);
+    ADBSyncManifest host = co_await hostFuture;
+    if(!device.valid) {
+        qWarning() << "Failed to list" << m_devicePath << "on the device, not syncing";
+        m_running = false;
+        emit runningChanged();
+        co_return QVariantMap{};
+    }
+
+    Run run{};
+    run.base = loadState(file);
+    for(const char* key : {"pushed", "pulled", "deletedOnHost", "deletedOnDevice", "conflicts", "failed"}) {
+        run.result.insert(key, QStringList{});
+    }
+    QStringList incomplete = host.incomplete + device.incomplete;
+
+    QSet<QString> paths{};
+    for(auto it = host.files.constBegin(); it != host.files.constEnd(); ++it) {
+        paths.insert(it.key());
+    }
+    for(auto it = device.files.constBegin(); it != device.files.constEnd(); ++it) {
+        paths.insert(it.key());
+    }
+    for(auto it = run.base.constBegin(); it != run.base.constEnd(); ++it) {
+        paths.insert(it.key());
+    }
+
+    for(const QString& path : std::as_const(paths)) {
+        if(isBelow(path, incomplete)) {
+            continue;
+        }
+        std::optional<ADBSyncEntry> h = host.files.contains(path) ? std::optional{host.files.value(path)} : std::nullopt;
+        std::optional<ADBSyncEntry> d = device.files.contains(path) ? std::optional{device.files.value(path)} : std::nullopt;
+        std::optional<Base> b = run.base.contains(path) ? std::optional{run.base.value(path)} : std::nullopt;
+
+        bool hostChanged = b ? !sameEntry(h, b->host) : h.has_value();
+        bool deviceChanged = b ? !sameEntry(d, b->device) : d.has_value();
+        if(!hostChanged && !deviceChanged) {
+            continue;
+        }
+
+        Step step{Action::Conflict, path, h, d};
+        if(hostChanged && !deviceChanged) {
+            step.action = h ? Action::Push : (m_propagateDeletions ? Action::DeleteOnDevice : Action::Pull);
+        } else if(deviceChanged && !hostChanged) {
+            step.action = d ? Action::Pull : (m_propagateDeletions ? Action::DeleteOnHost : Action::Push);
+        } else if(!h && !d) {
+            run.base.remove(path); // deleted on both sides
+            continue;
+        } else if(h && d && h->size == d->size) {
+            step.action = Action::Compare; // likely the same edit made twice, or a first run over copies
+        }
+        if(step.action == Action::Conflict) {
+            step = resolveConflict(step);
+        }
+        run.steps.push_back(step);
+    }
+
+    m_total = static_cast<int>(run.steps.size());
+    emit progressChanged();
+
+    // deletions on the device need no transfer, they go out together rather than costing a round trip each
+    auto deletions = std::stable_partition(run.steps.begin(), run.steps.end(), [](const Step& step) {
+        return step.action != Action::DeleteOnDevice;
+    });
+    std::vector<Step> deviceDeletions(std::make_move_iterator(deletions), std::make_move_iterator(run.steps.end()));
+    run.steps.erase(deletions, run.steps.end());
+    co_await co_deleteOnDevice(run, deviceDeletions);
+
+    std::vector<QCoro::Task<void>> workers{};
+    for(int i = 0; i < std::max(m_parallelTransfers, 1); i++) {
+        workers.push_back(co_worker(run));
+    }
+    for(auto& worker : workers) {
+        co_await worker;
+    }
+
+    saveState(file, run.base);
+
+    m_running = false;
+    emit runningChanged();
+    co_return run.result;
+}
+
+ADBSyncEngine::Step ADBSyncEngine::resolveConflict(const Step& step) const {
+    Step resolved = step;
+    switch(m_conflictPolicy) {
+        case ReportConflicts:
+            resolved.action = Action::Conflict;
+            break;
+        case PreferHost:
+            resolved.action = step.host ? Action::Push : Action::DeleteOnDevice;
+            break;
+        case PreferDevice:
+            resolved.action = step.device ? Action::Pull : Action::DeleteOnHost;
+            break;
+        case PreferNewer:
+            // an edit always wins over a deletion, that is the one that cannot be recovered otherwise
+            if(!step.host) {
+                resolved.action = Action::Pull;
+            } else if(!step.device) {
+                resolved.action = Action::Push;
+            } else {
+                resolved.action = step.host->time >= step.device->time ? Action::Push : Action::Pull;
+            }
+            break;
+    }
+    return resolved;
+}
+
+QCoro::Task<void> ADBSyncEngine::co_worker(Run& run) {
+    while(run.next < run.steps.size()) {
+        Step step = run.steps.at(run.next++);
+        if(!(co_await co_apply(run, step))) {
+            QStringList failed = run.result.value("failed").toStringList();
+            failed.append(step.path);
+            run.result.insert("failed", failed);
+        }
+        m_done++;
+        emit progressChanged();
+    }
+}
+
+QCoro::Task<void> ADBSyncEngine::co_deleteOnDevice(Run& run, std::vector<Step> steps) {
+    if(steps.empty()) {
+        co_return;
+    }
+    QStringList deviceFiles{};
+    for(const Step& step : steps) {
+        deviceFiles.append(m_devicePath + "/" + step.path);
+    }
+    // not recursive, a folder that has taken the place of a deleted file stays
+    std::vector<ADBFileOperationResult> results = co_await m_adbClient->co_removeFiles(deviceFiles, false);
+
+    for(size_t i = 0; i < steps.size(); i++) {
+        const Step& step = steps.at(i);
+        bool ok = i < results.size() && results.at(i).ok;
+        if(ok) {
+            run.base.remove(step.path);
+        } else {
+            qWarning() << "Failed to delete" << deviceFiles.at(static_cast<int>(i)) << "on the device:"
+                       << (i < results.size() ? results.at(i).error : QString{});
+        }
+        const char* key = ok ? "deletedOnDevice" : "failed";
+        QStringList paths = run.result.value(key).toStringList();
+        paths.append(step.path);
+        run.result.insert(key, paths);
+        m_done++;
+    }
+    emit progressChanged();
+}
+
+QCoro::Task<bool> ADBSyncEngine::co_apply(Run& run, Step step) {
+    QString hostFile = m_hostPath + "/" + step.path;
+    QString deviceFile = m_devicePath + "/" + step.path;
+    auto record = [&run, &step](const char* key) {
+        QStringList paths = run.result.value(key).toStringList();
+        paths.append(step.path);
+        run.result.insert(key, paths);
+    };
+
+    switch(step.action) {
+        case Action::Push:
+            // the device takes over the host mtime when the push finishes
+            if(!(co_await m_adbClient->co_pushFile(hostFile, deviceFile))) {
+                co_return false;
+            }
+            run.base.insert(step.path, Base{*step.host, *step.host});
+            record("pushed");
+            co_return true;
+        case Action::Pull: {
+            QDir().mkpath(QFileInfo(hostFile).absolutePath());
+            // in this mode the host file also gets the device mtime
+            if(!(co_await m_adbClient->co_pullFileTo(deviceFile, hostFile, ADBClient::TransferIfChanged))) {
+                co_return false;
+            }
+            run.base.insert(step.path, Base{*step.device, *step.device});
+            record("pulled");
+            co_return true;
+        }
+        case Action::DeleteOnHost:
+            if(QFile::exists(hostFile) && !QFile::remove(hostFile)) {
+                qWarning() << "Failed to delete" << hostFile;
+                co_return false;
+            }
+            run.base.remove(step.path);
+            record("deletedOnHost");
+            co_return true;
+        case Action::DeleteOnDevice: {
+            // planned deletions went out in one batch before the workers, this is one a conflict resolved to
+            std::vector<ADBFileOperationResult> results = co_await m_adbClient->co_removeFiles({deviceFile}, false);
+            if(results.empty() || !results.front().ok) {
+                qWarning() << "Failed to delete" << deviceFile << "on the device:"
+                           << (results.empty() ? QString{} : results.front().error);
+                co_return false;
+            }
+            run.base.remove(step.path);
+            record("deletedOnDevice");
+            co_return true;
+        }
+        case Action::Compare: {
+            QByteArray deviceHash = co_await m_adbClient->co_deviceHash(deviceFile);
+            QByteArray hostHash = co_await ADBHashCache::hostFiles().co_hash(hostFile);
+            if(!deviceHash.isEmpty() && deviceHash == hostHash) {
+                run.base.insert(step.path, Base{*step.host, *step.device});
+                co_return true;
+            }
+            Step resolved = resolveConflict(step);
+            co_return co_await co_apply(run, resolved);
+        }
+        case Action::Conflict:
+            // the old state stays, so it is reported again until one side is resolved by hand
+            record("conflicts");
+            co_return true;
+    }
+    co_return false;
+}
@@ -0,0 +1,141 @@
+/*
+ * Copyright (C) 2025  JCM
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * waydroid-files is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ADB_SYNC_ENGINE_H
+#define ADB_SYNC_ENGINE_H
+
+#include <optional>
+#include <vector>
+
+#include <QHash>
+#include <QObject>
+#include <QStringList>
+#include <QVariantMap>
+
+#include <QCoro/QCoroQmlTask>
+
+#include "adb_client.h"
+
+struct ADBSyncEntry {
+    qint64 size;
+    qint64 time; // seconds, the resolution both sides share
+};
+
+// The regular files below a folder, by path relative to it.
+struct ADBSyncManifest {
+    QHash<QString, ADBSyncEntry> files{};
+    QStringList folders{};
+    // folders that could not be listed, nothing below them is touched since their files look deleted otherwise
+    QStringList incomplete{};
+    bool valid = true;
+};
+
+// Keeps a host folder and a device folder in step in both directions.
+// The state of the last run is remembered per folder pair and device, which tells edits apart from deletions
+// and lets unchanged files through on size and mtime alone. Hashes are only compared when both sides changed
+// to the same size. Usable from QML and from plain C++ through co_sync.
+class ADBSyncEngine : public QObject {
+    Q_OBJECT
+
+public:
+    enum ConflictPolicy {
+        ReportConflicts,
+        PreferHost,
+        PreferDevice,
+        PreferNewer,
+    };
+    Q_ENUM(ConflictPolicy)
+
+    ADBSyncEngine(QObject* parent = nullptr);
+    ~ADBSyncEngine() = default;
+
+    Q_PROPERTY(ADBClient* adbClient MEMBER m_adbClient)
+    Q_PROPERTY(QString hostPath MEMBER m_hostPath NOTIFY hostPathChanged)
+    Q_PROPERTY(QString devicePath MEMBER m_devicePath NOTIFY devicePathChanged)
+    Q_PROPERTY(ConflictPolicy conflictPolicy MEMBER m_conflictPolicy)
+    // when off, files deleted on one side are copied back from the other instead
+    Q_PROPERTY(bool propagateDeletions MEMBER m_propagateDeletions)
+    Q_PROPERTY(int parallelTransfers MEMBER m_parallelTransfers)
+
+    Q_PROPERTY(bool running READ running NOTIFY runningChanged)
+    Q_PROPERTY(int done READ done NOTIFY progressChanged)
+    Q_PROPERTY(int total READ total NOTIFY progressChanged)
+
+    // Resolves to a map with the pushed, pulled, deletedOnHost, deletedOnDevice, conflicts and failed paths.
+    Q_INVOKABLE QCoro::QmlTask sync() {
+        return co_sync();
+    }
+    QCoro::Task<QVariantMap> co_sync();
+
+    static ADBSyncManifest hostManifest(const QString& root);
+    static QCoro::Task<ADBSyncManifest> co_deviceManifest(ADBClient& client, QString root, int parallel = 4);
+
+    bool running() const { return m_running; }
+    int done() const { return m_done; }
+    int total() const { return m_total; }
+signals:
+    void hostPathChanged();
+    void devicePathChanged();
+    void runningChanged();
+    void progressChanged();
+private:
+    struct Base {
+        ADBSyncEntry host;
+        ADBSyncEntry device;
+    };
+    enum class Action {
+        Push,
+        Pull,
+        DeleteOnHost,
+        DeleteOnDevice,
+        Compare,
+        Conflict,
+    };
+    struct Step {
+        Action action;
+        QString path;
+        std::optional<ADBSyncEntry> host;
+        std::optional<ADBSyncEntry> device;
+    };
+    struct Run {
+        std::vector<Step> steps;
+        size_t next = 0;
+        QHash<QString, Base> base;
+        QVariantMap result;
+    };
+
+    ADBClient* m_adbClient = nullptr;
+    QString m_hostPath;
+    QString m_devicePath;
+    ConflictPolicy m_conflictPolicy = ReportConflicts;
+    bool m_propagateDeletions = true;
+    int m_parallelTransfers = 3;
+
+    bool m_running = false;
+    int m_done = 0;
+    int m_total = 0;
+
+    QString stateFile(const QString& serial) const;
+    static QHash<QString, Base> loadState(const QString& file);
+    static void saveState(const QString& file, const QHash<QString, Base>& base);
+
+    Step resolveConflict(const Step& step) const;
+    QCoro::Task<void> co_deleteOnDevice(Run& run, std::vector<Step> steps);
+    QCoro::Task<void> co_worker(Run& run);
+    QCoro::Task<bool> co_apply(Run& run, Step step);
+};
+
+#endif
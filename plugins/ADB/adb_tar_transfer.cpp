@@ -0,0 +1,573 @@
+/*
+ * Copyright (C) 2025  JCM
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * waydroid-files is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "adb_tar_transfer.h"
+
+#include <algorithm>
+#include <climits>
+#include <cstring>
+
+#include <QDebug>
+#include <QDir>
+#include <QDirIterator>
+#include <QFileInfo>
+#include <QtEndian>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "adb_io_scheduler.h"
+#include "adb_trace.h"
+#include "adb_transport.h"
+
+ADBTarTransfer::ADBTarTransfer(QObject* parent) : QObject(parent) {
+}
+
+void ADBTarTransfer::start() {
+    m_running = true;
+    m_done = 0;
+    m_total = 0;
+    m_files = 0;
+    emit runningChanged();
+    emit progressChanged();
+}
+
+void ADBTarTransfer::stop() {
+    m_running = false;
+    emit runningChanged();
+}
+
+QByteArray ADBTarTransfer::packet(char id, const QByteArray& payload) {
+    QByteArray result(packetHeaderSize, id);
+    qToLittleEndian<quint32>(static_cast<quint32>(payload.size()), result.data() + 1);
+    return result + payload;
+}
+
+QCoro::Task<std::optional<ADBTarTransfer::Packet>> ADBTarTransfer::co_readPacket(ADBStreamIO& io, QByteArray& buffer) {
+    while(true) {
+        if(buffer.size() >= packetHeaderSize) {
+            quint32 length = qFromLittleEndian<quint32>(buffer.constData() + 1);
+            if(static_cast<quint32>(buffer.size() - packetHeaderSize) >= length) {
+                Packet result{buffer.at(0), buffer.mid(packetHeaderSize, static_cast<int>(length))};
+                buffer.remove(0, packetHeaderSize + static_cast<int>(length));
+                co_return result;
+            }
+        }
+        QByteArray chunk = co_await io.read(256 * 1024);
+        if(chunk.isEmpty()) {
+            co_return std::nullopt;
+        }
+        buffer += chunk;
+    }
+}
+
+void ADBTarTransfer::putOctal(char* field, int width, qint64 value) {
+    // ustar has width - 1 octal digits and a NUL, larger numbers use the base-256 form of GNU tar
+    if(value >= (qint64{1} << (3 * (width - 1)))) {
+        std::memset(field, 0, width);
+        field[0] = static_cast<char>(0x80);
+        for(int i = width - 1; i > 0 && value > 0; i--, value >>= 8) {
+            field[i] = static_cast<char>(value & 0xff);
+        }
+        return;
+    }
+    QByteArray digits = QByteArray::number(value, 8).rightJustified(width - 1, '0');
+    std::memcpy(field, digits.constData(), width - 1);
+    field[width - 1] = '\0';
+}
+
+static qint64 parseNumber(const char* field, int width) {
+    if(static_cast<unsigned char>(field[0]) & 0x80) {
+        qint64 value = 0;
+        for(int i = 1; i < width; i++) {
+            value = (value << 8) | static_cast<unsigned char>(field[i]);
+        }
+        return value;
+    }
+    return QByteArray(field, width).split('\0').first().trimmed().toLongLong(nullptr, 8);
+}
+
+static QByteArray field(const char* data, int width) {
+    return QByteArray(data, static_cast<int>(qstrnlen(data, width)));
+}
+
+QByteArray ADBTarTransfer::header(const QByteArray& name, char type, uint32_t mode, qint64 size, qint64 time, const QByteArray& link) {
+    QByteArray result{};
+    // GNU long names, which toybox and busybox tar both read, are simpler than splitting into prefix and name
+    for(auto [value, longType] : {std::pair{link, 'K'}, std::pair{name, 'L'}}) {
+        if(value.size() >= 100) {
+            QByteArray data = value + '\0';
+            result += header("././@LongLink", longType, 0644, data.size(), 0);
+            result += data + QByteArray((blockSize - data.size() % blockSize) % blockSize, '\0');
+        }
+    }
+
+    QByteArray block(blockSize, '\0');
+    char* data = block.data();
+    std::memcpy(data, name.constData(), std::min<int>(name.size(), 100));
+    putOctal(data + 100, 8, mode & 07777);
+    putOctal(data + 108, 8, 0);
+    putOctal(data + 116, 8, 0);
+    putOctal(data + 124, 12, size);
+    putOctal(data + 136, 12, time);
+    data[156] = type;
+    std::memcpy(data + 157, link.constData(), std::min<int>(link.size(), 100));
+    std::memcpy(data + 257, "ustar\0" "00", 8);
+
+    std::memset(data + 148, ' ', 8);
+    unsigned int checksum = 0;
+    for(char c : block) {
+        checksum += static_cast<unsigned char>(c);
+    }
+    putOctal(data + 148, 7, checksum);
+    data[155] = ' ';
+    return result + block;
+}
+
+std::optional<QString> ADBTarTransfer::Extractor::hostPath(const QString& name) const {
+    QString relative = QDir::cleanPath(name);
+    while(relative.startsWith('/')) {
+        relative.remove(0, 1);
+    }
+    // nothing in the archive may end up outside of the destination
+    if(relative == ".." || relative.startsWith("../")) {
+        return std::nullopt;
+    }
+    if(relative.isEmpty() || relative == ".") {
+        return m_root;
+    }
+    // nor get there through a symlink on the way, whether it was already on the host or came from the archive
+    QString path = m_root;
+    QStringList parts = relative.split('/');
+    for(qsizetype i = 0; i + 1 < parts.size(); i++) {
+        path += "/" + parts.at(i);
+        if(isSymlink(path)) {
+            return std::nullopt;
+        }
+    }
+    return m_root + "/" + relative;
+}
+
+bool ADBTarTransfer::Extractor::isSymlink(const QString& path) {
+    struct stat st;
+    return ::lstat(QFile::encodeName(path).constData(), &st) == 0 && S_ISLNK(st.st_mode);
+}
+
+bool ADBTarTransfer::Extractor::feed(QByteArray data) {
+    m_pending += data;
+    int position = 0;
+    while(position < m_pending.size()) {
+        int available = m_pending.size() - position;
+        if(m_remaining > 0) {
+            int length = static_cast<int>(std::min<qint64>(m_remaining, available));
+            const char* piece = m_pending.constData() + position;
+            if(m_file) {
+                if(m_file->write(piece, length) != length) {
+                    qWarning() << "Failed to write" << m_file->fileName() << ":" << m_file->errorString();
+                    return false;
+                }
+                m_transfer.m_done += length;
+            } else if(m_type == 'L' || m_type == 'K' || m_type == 'x') {
+                m_extension.append(piece, length);
+            }
+            m_remaining -= length;
+            position += length;
+            if(m_remaining == 0) {
+                entryDone();
+            }
+        } else if(m_padding > 0) {
+            int length = static_cast<int>(std::min<qint64>(m_padding, available));
+            m_padding -= length;
+            position += length;
+        } else if(m_ended) {
+            position = m_pending.size();
+        } else if(available >= blockSize) {
+            if(!header(m_pending.constData() + position)) {
+                return false;
+            }
+            position += blockSize;
+            if(m_remaining == 0 && !m_ended) {
+                entryDone();
+            }
+        } else {
+            break;
+        }
+    }
+    m_pending.remove(0, position);
+    return true;
+}
+
+bool ADBTarTransfer::Extractor::header(const char* block) {
+    if(std::all_of(block, block + blockSize, [](char c) { return c == '\0'; })) {
+        m_ended = true;
+        return true;
+    }
+
+    unsigned int checksum = 0;
+    for(int i = 0; i < blockSize; i++) {
+        checksum += i >= 148 && i < 156 ? ' ' : static_cast<unsigned char>(block[i]);
+    }
+    if(static_cast<qint64>(checksum) != parseNumber(block + 148, 8)) {
+        qWarning() << "Protocol error, tar header checksum mismatch";
+        return false;
+    }
+
+    qint64 size = parseNumber(block + 124, 12);
+    m_remaining = size;
+    m_padding = (blockSize - size % blockSize) % blockSize;
+    // old tars mark regular files with NUL, '7' is a contiguous file which nobody treats specially
+    m_type = block[156] == '\0' || block[156] == '7' ? '0' : block[156];
+    m_mode = static_cast<uint32_t>(parseNumber(block + 100, 8));
+    m_time = parseNumber(block + 136, 12);
+    m_file.reset();
+    m_extension.clear();
+    if(m_type == 'L' || m_type == 'K' || m_type == 'x') {
+        return true;
+    }
+    if(m_type == 'g') {
+        m_type = 0;
+        return true;
+    }
+
+    QString name = m_longName.isEmpty() ? QString::fromUtf8(field(block, 100)) : m_longName;
+    QString link = m_longLink.isEmpty() ? QString::fromUtf8(field(block + 157, 100)) : m_longLink;
+    if(m_longName.isEmpty() && std::memcmp(block + 257, "ustar", 5) == 0 && block[345] != '\0') {
+        name = QString::fromUtf8(field(block + 345, 155)) + "/" + name;
+    }
+    m_longName.clear();
+    m_longLink.clear();
+
+    std::optional<QString> path = hostPath(name);
+    if(!path) {
+        qWarning() << "Skipping" << name << "from the archive, it points outside of" << m_root << "or through a symlink";
+        m_type = 0;
+        return true;
+    }
+    m_path = *path;
+    QByteArray nativePath = QFile::encodeName(m_path);
+
+    switch(m_type) {
+        case '5':
+            if(isSymlink(m_path)) {
+                QFile::remove(m_path);
+            }
+            if(!QDir().mkpath(m_path)) {
+                qWarning() << "Failed to create" << m_path;
+                return false;
+            }
+            m_folders.push_back(Folder{m_path, m_mode, m_time});
+            break;
+        case '0':
+            QDir().mkpath(QFileInfo(m_path).path());
+            // opening would follow a symlink that is already there
+            if(isSymlink(m_path)) {
+                QFile::remove(m_path);
+            }
+            m_file = std::make_unique<QFile>(m_path);
+            if(!m_file->open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+                qWarning() << "Failed to open" << m_path << "for writing:" << m_file->errorString();
+                return false;
+            }
+            break;
+        case '1': {
+            std::optional<QString> target = hostPath(link);
+            QFile::remove(m_path);
+            if(!target || ::link(QFile::encodeName(*target).constData(), nativePath.constData()) != 0) {
+                qWarning() << "Failed to link" << m_path << "to" << link;
+            }
+            break;
+        }
+        case '2':
+            // Created once everything else is in place, like GNU tar does. Until then no entry can be written
+            // through a symlink with an arbitrary target that the archive itself brought along.
+            m_symlinks.push_back(Symlink{name, link, m_time});
+            break;
+        default:
+            // devices, fifos and sockets are no use on the host
+            m_type = 0;
+            break;
+    }
+    return true;
+}
+
+void ADBTarTransfer::Extractor::entryDone() {
+    QByteArray nativePath = QFile::encodeName(m_path);
+    struct timespec times[2] = {{m_time, 0}, {m_time, 0}};
+
+    switch(m_type) {
+        case 'L':
+            m_longName = QString::fromUtf8(field(m_extension.constData(), m_extension.size()));
+            return;
+        case 'K':
+            m_longLink = QString::fromUtf8(field(m_extension.constData(), m_extension.size()));
+            return;
+        case 'x':
+            // pax records: "<length> <key>=<value>\n"
+            for(const QByteArray& record : m_extension.split('\n')) {
+                int space = record.indexOf(' ');
+                int equals = record.indexOf('=', space);
+                if(space < 0 || equals < 0) {
+                    continue;
+                }
+                QByteArray key = record.mid(space + 1, equals - space - 1);
+                if(key == "path") {
+                    m_longName = QString::fromUtf8(record.mid(equals + 1));
+                } else if(key == "linkpath") {
+                    m_longLink = QString::fromUtf8(record.mid(equals + 1));
+                }
+            }
+            return;
+        case '0':
+            if(m_file) {
+                m_file->close();
+                m_file.reset();
+                ::chmod(nativePath.constData(), m_mode & 07777);
+                ::utimensat(AT_FDCWD, nativePath.constData(), times, 0);
+            }
+            break;
+        default:
+            break;
+    }
+    if(m_type != 0) {
+        m_transfer.m_files++;
+    }
+}
+
+bool ADBTarTransfer::Extractor::finish() {
+    if(m_remaining > 0 || m_file) {
+        qWarning() << "Protocol error, tar stream ended in the middle of" << m_path;
+        return false;
+    }
+    // the path is checked again, an earlier symlink may have taken the place of one of its folders
+    for(const Symlink& symlink : m_symlinks) {
+        std::optional<QString> path = hostPath(symlink.name);
+        if(!path) {
+            qWarning() << "Skipping the symlink" << symlink.name << "from the archive, it points outside of" << m_root << "or through a symlink";
+            continue;
+        }
+        QByteArray nativePath = QFile::encodeName(*path);
+        QDir().mkpath(QFileInfo(*path).path());
+        QFile::remove(*path);
+        if(::symlink(QFile::encodeName(symlink.target).constData(), nativePath.constData()) != 0) {
+            qWarning() << "Failed to create the symlink" << *path;
+            continue;
+        }
+        struct timespec times[2] = {{symlink.time, 0}, {symlink.time, 0}};
+        ::utimensat(AT_FDCWD, nativePath.constData(), times, AT_SYMLINK_NOFOLLOW);
+    }
+    // innermost first, a folder without write permission would keep its children from getting their times
+    for(auto it = m_folders.rbegin(); it != m_folders.rend(); ++it) {
+        QByteArray nativePath = QFile::encodeName(it->path);
+        struct timespec times[2] = {{it->time, 0}, {it->time, 0}};
+        ::utimensat(AT_FDCWD, nativePath.constData(), times, 0);
+        ::chmod(nativePath.constData(), it->mode & 07777);
+    }
+    return true;
+}
+
+QCoro::Task<bool> ADBTarTransfer::co_pull(QString devicePath, QString hostPath) {
+    if(m_running || !m_adbClient) {
+        co_return false;
+    }
+    ADBTraceSpan span{"tar", "pull", devicePath};
+    start();
+    auto finished = [this](bool ok) {
+        stop();
+        return ok;
+    };
+    if(!QDir().mkpath(hostPath)) {
+        qWarning() << "Failed to create" << hostPath;
+        co_return finished(false);
+    }
+
+    QString quoted = shellQuote(devicePath);
+    // only for the progress, du counts whole blocks so the real total is a bit below
+    std::optional<QByteArray> usage = co_await m_adbClient->co_shell("du -sk " + quoted + " 2>/dev/null");
+    if(usage) {
+        m_total = usage->split('\t').first().trimmed().toLongLong() * 1024;
+        emit progressChanged();
+    }
+
+    std::shared_ptr<ADBTransport> transport = m_adbClient->transport();
+    std::unique_ptr<QIODevice> stream = co_await transport->co_open("shell,v2,raw:cd " + quoted.toUtf8() + " && tar cf - .");
+    if(!stream) {
+        qWarning() << "Failed to start tar on the device";
+        co_return finished(false);
+    }
+
+    ADBStreamIO io{*stream};
+    ADBIOScheduler& scheduler = ADBIOScheduler::instance();
+    ADBIOScheduler::BulkStream bulk{};
+    Extractor extractor{*this, QDir::cleanPath(hostPath)};
+    QByteArray buffer{};
+    QByteArray errors{};
+    int status = -1;
+    bool ok = true;
+    while(std::optional<Packet> packet = co_await co_readPacket(io, buffer)) {
+        if(packet->id == Stdout) {
+            if(!extractor.feed(packet->payload)) {
+                ok = false;
+                break;
+            }
+            emit progressChanged();
+            co_await scheduler.co_yieldToInteractive(bulk);
+        } else if(packet->id == Stderr) {
+            errors += packet->payload;
+        } else if(packet->id == Exit) {
+            status = packet->payload.isEmpty() ? -1 : static_cast<unsigned char>(packet->payload.at(0));
+            break;
+        }
+    }
+    ok = ok && extractor.finish();
+
+    if(!errors.isEmpty()) {
+        qWarning() << "tar on the device:" << errors.trimmed();
+    }
+    if(ok && status != 0) {
+        qWarning() << "tar on the device exited with" << status;
+        ok = false;
+    }
+    co_return finished(ok);
+}
+
+QCoro::Task<bool> ADBTarTransfer::co_push(QString hostPath, QString devicePath) {
+    if(m_running || !m_adbClient) {
+        co_return false;
+    }
+    ADBTraceSpan span{"tar", "push", hostPath};
+    start();
+    auto finished = [this](bool ok) {
+        stop();
+        return ok;
+    };
+
+    QString root = QDir::cleanPath(hostPath);
+    if(!QFileInfo(root).isDir()) {
+        qWarning() << hostPath << "is not a folder";
+        co_return finished(false);
+    }
+
+    // the walk comes first, so the total is known before anything is sent
+    std::vector<std::pair<QByteArray, struct stat>> entries{};
+    QDir rootDir{root};
+    QDirIterator it(root, QDir::AllEntries | QDir::Hidden | QDir::System | QDir::NoDotAndDotDot, QDirIterator::Subdirectories);
+    while(it.hasNext()) {
+        QString path = it.next();
+        struct stat st;
+        if(::lstat(QFile::encodeName(path).constData(), &st) != 0) {
+            continue;
+        }
+        entries.emplace_back(rootDir.relativeFilePath(path).toUtf8(), st);
+        m_total += S_ISREG(st.st_mode) ? st.st_size : 0;
+    }
+    emit progressChanged();
+
+    QString quoted = shellQuote(devicePath);
+    std::shared_ptr<ADBTransport> transport = m_adbClient->transport();
+    std::unique_ptr<QIODevice> stream = co_await transport->co_open("shell,v2,raw:mkdir -p " + quoted.toUtf8() + " && cd " + quoted.toUtf8() + " && tar xpf -");
+    if(!stream) {
+        qWarning() << "Failed to start tar on the device";
+        co_return finished(false);
+    }
+    ADBStreamIO io{*stream};
+    ADBIOScheduler& scheduler = ADBIOScheduler::instance();
+    ADBIOScheduler::BulkStream bulk{};
+
+    QByteArray pending{};
+    auto send = [&io, &pending](bool all) -> QCoro::Task<bool> {
+        while(pending.size() >= maxStdinPacket || (all && !pending.isEmpty())) {
+            if(co_await io.write(packet(Stdin, pending.left(maxStdinPacket))) <= 0) {
+                qWarning() << "Failed to send to tar on the device";
+                co_return false;
+            }
+            pending.remove(0, std::min(maxStdinPacket, pending.size()));
+        }
+        co_return true;
+    };
+
+    bool ok = true;
+    for(const auto& [name, st] : entries) {
+        if(S_ISDIR(st.st_mode)) {
+            pending += header(name + '/', '5', st.st_mode, 0, st.st_mtim.tv_sec);
+        } else if(S_ISLNK(st.st_mode)) {
+            QByteArray target(PATH_MAX, '\0');
+            ssize_t length = ::readlink(QFile::encodeName(root + "/" + QString::fromUtf8(name)).constData(), target.data(), target.size());
+            if(length < 0) {
+                continue;
+            }
+            target.truncate(static_cast<int>(length));
+            pending += header(name, '2', st.st_mode, 0, st.st_mtim.tv_sec, target);
+        } else if(S_ISREG(st.st_mode)) {
+            QFile file{root + "/" + QString::fromUtf8(name)};
+            if(!file.open(QIODevice::ReadOnly)) {
+                qWarning() << "Failed to open" << file.fileName() << ":" << file.errorString();
+                ok = false;
+                continue;
+            }
+            pending += header(name, '0', st.st_mode, st.st_size, st.st_mtim.tv_sec);
+            // the header promised st_size bytes, a file that changed in between is cut or padded to that
+            qint64 remaining = st.st_size;
+            while(remaining > 0) {
+                QByteArray chunk = file.read(std::min<qint64>(remaining, maxStdinPacket));
+                if(chunk.isEmpty()) {
+                    qWarning() << file.fileName() << "shrank while it was sent";
+                    chunk = QByteArray(static_cast<int>(std::min<qint64>(remaining, maxStdinPacket)), '\0');
+                    ok = false;
+                }
+                pending += chunk;
+                remaining -= chunk.size();
+                m_done += chunk.size();
+                if(!co_await send(false)) {
+                    co_return finished(false);
+                }
+                emit progressChanged();
+                co_await scheduler.co_yieldToInteractive(bulk);
+            }
+            pending += QByteArray((blockSize - st.st_size % blockSize) % blockSize, '\0');
+        } else {
+            continue;
+        }
+        m_files++;
+        if(!co_await send(false)) {
+            co_return finished(false);
+        }
+    }
+    pending += QByteArray(2 * blockSize, '\0');
+    if(!co_await send(true) || co_await io.write(packet(CloseStdin, {})) <= 0) {
+        co_return finished(false);
+    }
+    emit progressChanged();
+
+    QByteArray buffer{};
+    QByteArray errors{};
+    int status = -1;
+    while(std::optional<Packet> packet = co_await co_readPacket(io, buffer)) {
+        if(packet->id == Stdout || packet->id == Stderr) {
+            errors += packet->payload;
+        } else if(packet->id == Exit) {
+            status = packet->payload.isEmpty() ? -1 : static_cast<unsigned char>(packet->payload.at(0));
+            break;
+        }
+    }
+    if(!errors.isEmpty()) {
+        qWarning() << "tar on the device:" << errors.trimmed();
+    }
+    if(status != 0) {
+        qWarning() << "tar on the device exited with" << status;
+        ok = false;
+    }
+    co_return finished(ok);
+}
@@ -0,0 +1,148 @@
+/*
+ * Copyright (C) 2025  JCM
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * waydroid-files is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ADB_TAR_TRANSFER_H
+#define ADB_TAR_TRANSFER_H
+
+#include <memory>
+#include <optional>
+#include <vector>
+
+#include <QByteArray>
+#include <QFile>
+#include <QObject>
+#include <QStringList>
+
+#include <QCoro/QCoroQmlTask>
+
+#include "adb_client.h"
+
+class ADBStreamIO;
+
+// Copies whole folder trees through a single tar stream on a "shell,v2,raw:" session instead of a RECV or SEND
+// for every file. The archive is never stored on either side: the host unpacks the device's "tar c" output as it
+// arrives, and packs the host files on the fly into the stdin of "tar x" for the other direction.
+// Modes and modification times are kept both ways. Usable from QML and from plain C++ through co_pull and co_push.
+class ADBTarTransfer : public QObject {
+    Q_OBJECT
+
+public:
+    ADBTarTransfer(QObject* parent = nullptr);
+    ~ADBTarTransfer() = default;
+
+    Q_PROPERTY(ADBClient* adbClient MEMBER m_adbClient)
+
+    Q_PROPERTY(bool running READ running NOTIFY runningChanged)
+    // bytes of file content, total is an estimate from du for pulls and 0 until it is known
+    Q_PROPERTY(qint64 done READ done NOTIFY progressChanged)
+    Q_PROPERTY(qint64 total READ total NOTIFY progressChanged)
+    Q_PROPERTY(int files READ files NOTIFY progressChanged)
+
+    // The contents of the source folder end up in the destination folder, which is created if needed.
+    Q_INVOKABLE QCoro::QmlTask pull(const QString& devicePath, const QString& hostPath) {
+        return co_pull(devicePath, hostPath);
+    }
+    Q_INVOKABLE QCoro::QmlTask push(const QString& hostPath, const QString& devicePath) {
+        return co_push(hostPath, devicePath);
+    }
+    QCoro::Task<bool> co_pull(QString devicePath, QString hostPath);
+    QCoro::Task<bool> co_push(QString hostPath, QString devicePath);
+
+    bool running() const { return m_running; }
+    qint64 done() const { return m_done; }
+    qint64 total() const { return m_total; }
+    int files() const { return m_files; }
+signals:
+    void runningChanged();
+    void progressChanged();
+private:
+    // shell protocol v2 packet ids, see ADBShellSession
+    enum PacketId : char {
+        Stdin = 0,
+        Stdout = 1,
+        Stderr = 2,
+        Exit = 3,
+        CloseStdin = 3,
+    };
+    static constexpr int packetHeaderSize = 5;
+    static constexpr int maxStdinPacket = 64 * 1024;
+    static constexpr int blockSize = 512;
+
+    struct Packet {
+        char id;
+        QByteArray payload;
+    };
+
+    // Unpacks a ustar stream (with the GNU and pax long name extensions) below a host folder, a piece at a time.
+    class Extractor {
+    public:
+        Extractor(ADBTarTransfer& transfer, QString root) : m_transfer(transfer), m_root(std::move(root)) {}
+
+        bool feed(QByteArray data);
+        // creates the symlinks and restores the folder times, which every file written into them has changed
+        bool finish();
+    private:
+        ADBTarTransfer& m_transfer;
+        QString m_root;
+
+        QByteArray m_pending{};
+        // content of the current entry that is still to come, and the padding after it
+        qint64 m_remaining = 0;
+        qint64 m_padding = 0;
+        std::unique_ptr<QFile> m_file{};
+        char m_type = 0; // 0 for entries that are skipped
+        QByteArray m_extension{};
+        QString m_path{};
+        QString m_longName{};
+        QString m_longLink{};
+        uint32_t m_mode = 0;
+        qint64 m_time = 0;
+        struct Folder {
+            QString path;
+            uint32_t mode;
+            qint64 time;
+        };
+        std::vector<Folder> m_folders{};
+        struct Symlink {
+            QString name;
+            QString target;
+            qint64 time;
+        };
+        std::vector<Symlink> m_symlinks{};
+        bool m_ended = false;
+
+        bool header(const char* block);
+        void entryDone();
+        std::optional<QString> hostPath(const QString& name) const;
+        static bool isSymlink(const QString& path);
+    };
+
+    ADBClient* m_adbClient = nullptr;
+
+    bool m_running = false;
+    qint64 m_done = 0;
+    qint64 m_total = 0;
+    int m_files = 0;
+
+    void start();
+    void stop();
+    static QByteArray packet(char id, const QByteArray& payload);
+    static QCoro::Task<std::optional<Packet>> co_readPacket(ADBStreamIO& io, QByteArray& buffer);
+    static QByteArray header(const QByteArray& name, char type, uint32_t mode, qint64 size, qint64 time, const QByteArray& link = {});
+    static void putOctal(char* field, int width, qint64 value);
+};
+
+#endif
@@ -0,0 +1,291 @@
+/*
+ * Copyright (C) 2025  JCM
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * waydroid-files is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "adb_thumbnail_provider.h"
+
+#include <QBuffer>
+#include <QCoreApplication>
+#include <QDebug>
+#include <QImageReader>
+#include <QRegularExpression>
+#include <QStandardPaths>
+#include <QUrl>
+#include <QtConcurrent>
+#include <QtEndian>
+
+#include <QCoro/QCoroFuture>
+
+#include <sys/stat.h>
+
+#include "adb_client.h"
+#include "adb_file_types.h"
+
+QQuickTextureFactory* ADBThumbnailResponse::textureFactory() const {
+    return QQuickTextureFactory::textureFactoryForImage(m_image);
+}
+
+void ADBThumbnailResponse::cancel() {
+    *m_cancelled = true;
+}
+
+void ADBThumbnailResponse::finish(QImage image) {
+    if(*m_cancelled) {
+        return;
+    }
+    m_image = image;
+    emit finished();
+}
+
+ADBThumbnailScheduler* ADBThumbnailScheduler::instance() {
+    static ADBThumbnailScheduler* scheduler = new ADBThumbnailScheduler();
+    return scheduler;
+}
+
+ADBThumbnailScheduler::ADBThumbnailScheduler()
+    : QObject(QCoreApplication::instance())
+    , m_client(new ADBClient())
+    , m_cache(QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/Thumbnails", cacheBudget)
+    , m_blocks(m_client, 16)
+{
+    m_client->setParent(this);
+}
+
+void ADBThumbnailScheduler::enqueue(ADBThumbnailJob* job) {
+    m_pending.push_back(std::shared_ptr<ADBThumbnailJob>(job));
+    schedule();
+}
+
+void ADBThumbnailScheduler::setVisiblePaths(QSet<QString> paths) {
+    m_visiblePaths = paths;
+}
+
+void ADBThumbnailScheduler::schedule() {
+    // delegates that scrolled out of view cancel their requests, so drop those before picking
+    m_pending.erase(std::remove_if(m_pending.begin(), m_pending.end(), [](const std::shared_ptr<ADBThumbnailJob>& job) {
+        return job->isCancelled();
+    }), m_pending.end());
+
+    while(m_runningJobs < maxConcurrentJobs && !m_pending.empty()) {
+        auto visible = std::find_if(m_pending.rbegin(), m_pending.rend(), [this](const std::shared_ptr<ADBThumbnailJob>& job) {
+            return m_visiblePaths.contains(job->path());
+        });
+        auto it = visible != m_pending.rend() ? std::prev(visible.base()) : std::prev(m_pending.end());
+
+        std::shared_ptr<ADBThumbnailJob> job = *it;
+        m_pending.erase(it);
+
+        m_runningJobs++;
+        run(job);
+    }
+}
+
+QCoro::Task<void> ADBThumbnailScheduler::run(std::shared_ptr<ADBThumbnailJob> job) {
+    if(!job->isCancelled()) {
+        QImage image = co_await co_thumbnail(job->path(), job->size());
+        // a response cancelled in the meantime is already on its way out, it gets nothing
+        if(!job->isCancelled()) {
+            emit job->done(image);
+        }
+    }
+
+    m_runningJobs--;
+    schedule();
+}
+
+// Decoding and encoding run on the thread pool, a full size photo would otherwise stall scrolling for a while.
+static QImage readScaled(QByteArray data, QSize size) {
+    QBuffer buffer{&data};
+    buffer.open(QIODevice::ReadOnly);
+    QImageReader reader{&buffer};
+    reader.setAutoTransform(true);
+
+    // lets decoders like JPEG downscale while decoding instead of producing the full image first
+    QSize original = reader.size();
+    if(original.isValid()) {
+        reader.setScaledSize(original.scaled(size, Qt::KeepAspectRatio).boundedTo(original));
+    }
+    return reader.read();
+}
+
+QCoro::Task<QImage> ADBThumbnailScheduler::co_thumbnail(QString path, QSize size) {
+    auto entry = co_await m_client->co_stat(path);
+    if(!entry || !S_ISREG(entry->mode)) {
+        co_return QImage{};
+    }
+
+    QByteArray variant = QByteArray::number(size.width()) + "x" + QByteArray::number(size.height());
+    QByteArray key = ADBDiskCache::makeKey(path, entry->size, entry->time, variant);
+    if(QString cached = m_cache.lookup(key); !cached.isEmpty()) {
+        QImage image = co_await QtConcurrent::run([cached]() {
+            return QImage{cached, "PNG"};
+        });
+        if(!image.isNull()) {
+            co_return image;
+        }
+        m_cache.remove(key);
+    }
+
+    const ADBFileTypes::Type* type = ADBFileTypes::forFileName(path);
+    bool video = type && type->contentType == ADBFileTypes::Videos;
+
+    QImage image{};
+    if(type && type->mimeType == "image/jpeg" && entry->size > mediaStoreThreshold) {
+        image = co_await co_exifThumbnail(path, entry->time, size);
+    }
+    if(image.isNull() && (video || entry->size > mediaStoreThreshold)) {
+        image = co_await co_mediaStoreThumbnail(path, size, video);
+    }
+    if(image.isNull() && !video && entry->size <= maxPullSize) {
+        QBuffer buffer{};
+        buffer.open(QIODevice::WriteOnly);
+        if(co_await m_client->co_pullToDevice(path, buffer, ADBIOScheduler::Priority::Interactive)) {
+            buffer.close();
+            image = co_await QtConcurrent::run(readScaled, buffer.data(), size);
+        }
+    }
+    if(image.isNull()) {
+        co_return QImage{};
+    }
+
+    QString file = m_cache.pathFor(key);
+    if(co_await QtConcurrent::run([image, file]() { return image.save(file, "PNG"); })) {
+        m_cache.insert(key);
+    }
+    co_return image;
+}
+
+// Returns the JPEG thumbnail embedded in IFD1 of an Exif APP1 segment, if there is one.
+static QByteArray exifThumbnail(const QByteArray& segment) {
+    if(!segment.startsWith(QByteArray("Exif\0\0", 6)) || segment.size() < 14) {
+        return {};
+    }
+    QByteArray tiff = segment.mid(6);
+    bool little = tiff.startsWith("II");
+    auto u16 = [&](qint64 pos) -> quint32 {
+        if(pos < 0 || pos + 2 > tiff.size()) return 0;
+        return little ? qFromLittleEndian<quint16>(tiff.constData() + pos) : qFromBigEndian<quint16>(tiff.constData() + pos);
+    };
+    auto u32 = [&](qint64 pos) -> quint32 {
+        if(pos < 0 || pos + 4 > tiff.size()) return 0;
+        return little ? qFromLittleEndian<quint32>(tiff.constData() + pos) : qFromBigEndian<quint32>(tiff.constData() + pos);
+    };
+
+    quint32 ifd0 = u32(4);
+    quint32 ifd1 = u32(ifd0 + 2 + u16(ifd0) * 12);
+    if(ifd1 == 0) {
+        return {};
+    }
+
+    quint32 offset = 0;
+    quint32 length = 0;
+    for(quint32 i = 0, count = u16(ifd1); i < count; i++) {
+        qint64 tag = ifd1 + 2 + i * 12;
+        if(u16(tag) == 0x0201) {
+            offset = u32(tag + 8);
+        } else if(u16(tag) == 0x0202) {
+            length = u32(tag + 8);
+        }
+    }
+    if(offset == 0 || length == 0 || offset + length > static_cast<quint32>(tiff.size())) {
+        return {};
+    }
+    return tiff.mid(offset, length);
+}
+
+QCoro::Task<QImage> ADBThumbnailScheduler::co_exifThumbnail(QString path, uint32_t time, QSize size) {
+    // walk the marker segments at the start of the file, only reading their headers until APP1 shows up
+    qint64 pos = 2;
+    for(int segments = 0; segments < 16; segments++) {
+        auto header = co_await m_blocks.co_read(path, time, pos, 4);
+        if(!header || header->size() != 4 || static_cast<uchar>(header->at(0)) != 0xFF) {
+            co_return QImage{};
+        }
+        uchar marker = header->at(1);
+        qint64 length = qFromBigEndian<quint16>(header->constData() + 2);
+        if(marker == 0xDA || marker == 0xD9) {
+            co_return QImage{}; // image data starts, no Exif
+        }
+        if(marker == 0xE1) {
+            auto segment = co_await m_blocks.co_read(path, time, pos + 4, length - 2);
+            if(!segment) {
+                co_return QImage{};
+            }
+            QByteArray jpeg = exifThumbnail(*segment);
+            if(jpeg.isEmpty()) {
+                co_return QImage{};
+            }
+            co_return co_await QtConcurrent::run(readScaled, jpeg, size);
+        }
+        pos += 2 + length;
+    }
+    co_return QImage{};
+}
+
+QCoro::Task<QImage> ADBThumbnailScheduler::co_mediaStoreThumbnail(QString path, QSize size, bool video) {
+    // MediaStore records paths on the primary volume, not the /sdcard alias
+    QString storagePath = path;
+    if(storagePath.startsWith("/sdcard/")) {
+        storagePath.replace(0, 7, "/storage/emulated/0");
+    }
+
+    QString uri = video ? "content://media/external/video/media" : "content://media/external/images/media";
+    QString where = "_data='" + QString(storagePath).replace("'", "''") + "'";
+    auto output = co_await m_client->co_shell("content query --uri " + uri + " --projection _id --where " + shellQuote(where));
+    if(!output) {
+        co_return QImage{};
+    }
+
+    static const QRegularExpression idExpression{"_id=(\\d+)"};
+    auto match = idExpression.match(QString::fromUtf8(*output));
+    if(!match.hasMatch()) {
+        co_return QImage{};
+    }
+    QString id = match.captured(1);
+
+    QString volume = storagePath.section('/', 0, storagePath.startsWith("/storage/emulated/") ? 3 : 2);
+    QString thumbnail = co_await m_client->co_findFirstAccessibleRegularFile({
+        volume + (video ? "/Movies/.thumbnails/" : "/Pictures/.thumbnails/") + id + ".jpg",
+        volume + "/DCIM/.thumbnails/" + id + ".jpg",
+    });
+    if(thumbnail.isEmpty()) {
+        co_return QImage{};
+    }
+
+    QBuffer buffer{};
+    buffer.open(QIODevice::WriteOnly);
+    if(!(co_await m_client->co_pullToDevice(thumbnail, buffer, ADBIOScheduler::Priority::Interactive))) {
+        co_return QImage{};
+    }
+    buffer.close();
+    co_return co_await QtConcurrent::run(readScaled, buffer.data(), size);
+}
+
+QQuickImageResponse* ADBThumbnailProvider::requestImageResponse(const QString& id, const QSize& requestedSize) {
+    ADBThumbnailResponse* response = new ADBThumbnailResponse();
+
+    QString path = QUrl::fromPercentEncoding(id.toUtf8());
+    QSize size = requestedSize.isValid() && !requestedSize.isEmpty() ? requestedSize : QSize{128, 128};
+
+    // called on the image loader thread, the scheduler and its sockets belong to the main thread
+    ADBThumbnailScheduler* scheduler = ADBThumbnailScheduler::instance();
+    ADBThumbnailJob* job = new ADBThumbnailJob(path, size, response->cancelledFlag());
+    QObject::connect(job, &ADBThumbnailJob::done, response, &ADBThumbnailResponse::finish, Qt::QueuedConnection);
+    job->moveToThread(scheduler->thread());
+    QMetaObject::invokeMethod(scheduler, [scheduler, job]() {
+        scheduler->enqueue(job);
+    }, Qt::QueuedConnection);
+
+    return response;
+}
@@ -0,0 +1,116 @@
+/*
+ * Copyright (C) 2025  JCM
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * waydroid-files is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ADB_THUMBNAIL_PROVIDER_H
+#define ADB_THUMBNAIL_PROVIDER_H
+
+#include <atomic>
+#include <deque>
+#include <memory>
+
+#include <QImage>
+#include <QObject>
+#include <QQuickAsyncImageProvider>
+#include <QQuickImageResponse>
+#include <QSet>
+#include <QSize>
+
+#include <QCoro/QCoroTask>
+
+#include "adb_block_cache.h"
+#include "adb_disk_cache.h"
+
+class ADBClient;
+
+class ADBThumbnailResponse : public QQuickImageResponse {
+    Q_OBJECT
+
+public:
+    ADBThumbnailResponse() = default;
+    ~ADBThumbnailResponse() = default;
+
+    QQuickTextureFactory* textureFactory() const override;
+    void cancel() override;
+
+    // shared with the job, which may outlive this response
+    std::shared_ptr<std::atomic<bool>> cancelledFlag() const { return m_cancelled; }
+    void finish(QImage image);
+private:
+    QImage m_image;
+    std::shared_ptr<std::atomic<bool>> m_cancelled = std::make_shared<std::atomic<bool>>(false);
+};
+
+// One request as the scheduler sees it, on the main thread. The image loader deletes responses whenever their delegate
+// goes away, so the job never touches its response: the result goes out through done(), which is connected queued to
+// the response and dropped by Qt if that is gone by then.
+class ADBThumbnailJob : public QObject {
+    Q_OBJECT
+
+public:
+    ADBThumbnailJob(QString path, QSize size, std::shared_ptr<std::atomic<bool>> cancelled)
+        : m_path(path), m_size(size), m_cancelled(std::move(cancelled)) {}
+
+    QString path() const { return m_path; }
+    QSize size() const { return m_size; }
+    bool isCancelled() const { return *m_cancelled; }
+signals:
+    void done(QImage image);
+private:
+    QString m_path;
+    QSize m_size;
+    std::shared_ptr<std::atomic<bool>> m_cancelled;
+};
+
+// Lives on the main thread, where it owns its own ADBClient and runs a bounded number of thumbnail jobs at once.
+// Pending jobs for rows the ListView reports as visible go first, otherwise the most recent request wins.
+class ADBThumbnailScheduler : public QObject {
+    Q_OBJECT
+
+public:
+    static ADBThumbnailScheduler* instance();
+
+    // takes ownership of the job
+    void enqueue(ADBThumbnailJob* job);
+    void setVisiblePaths(QSet<QString> paths);
+private:
+    ADBThumbnailScheduler();
+
+    static constexpr int maxConcurrentJobs = 2;
+    static constexpr qint64 cacheBudget = 64 * 1024 * 1024;
+    static constexpr uint32_t mediaStoreThreshold = 4 * 1024 * 1024;
+    static constexpr uint32_t maxPullSize = 32 * 1024 * 1024;
+
+    ADBClient* m_client;
+    ADBDiskCache m_cache;
+    ADBBlockCache m_blocks;
+
+    std::deque<std::shared_ptr<ADBThumbnailJob>> m_pending{};
+    QSet<QString> m_visiblePaths{};
+    int m_runningJobs = 0;
+
+    void schedule();
+    QCoro::Task<void> run(std::shared_ptr<ADBThumbnailJob> job);
+    QCoro::Task<QImage> co_thumbnail(QString path, QSize size);
+    QCoro::Task<QImage> co_exifThumbnail(QString path, uint32_t time, QSize size);
+    QCoro::Task<QImage> co_mediaStoreThumbnail(QString path, QSize size, bool video);
+};
+
+class ADBThumbnailProvider : public QQuickAsyncImageProvider {
+public:
+    QQuickImageResponse* requestImageResponse(const QString& id, const QSize& requestedSize) override;
+};
+
+#endif
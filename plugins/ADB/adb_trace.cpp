@@ -0,0 +1,152 @@
+/*
+ * Copyright (C) 2025  JCM
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * waydroid-files is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "adb_trace.h"
+
+#include <mutex>
+#include <vector>
+
+#include <QCoreApplication>
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QSaveFile>
+#include <QThread>
+
+std::atomic<bool> ADBTrace::s_enabled{false};
+
+namespace {
+    struct Event {
+        const char* category;
+        const char* name;
+        QString detail;
+        qint64 start;
+        qint64 end;
+        quint64 thread;
+        bool async;
+    };
+
+    constexpr size_t capacity = 1 << 16;
+
+    std::mutex mutex{};
+    std::vector<Event> events{};
+    size_t next = 0;
+    QString exitPath{};
+
+    QElapsedTimer& clock() {
+        static QElapsedTimer timer = []() {
+            QElapsedTimer timer;
+            timer.start();
+            return timer;
+        }();
+        return timer;
+    }
+
+    QByteArray escape(const QString& string) {
+        QByteArray escaped{};
+        for(char c : string.toUtf8()) {
+            if(c == '"' || c == '\\') {
+                escaped += '\\';
+                escaped += c;
+            } else if(static_cast<unsigned char>(c) < 0x20) {
+                escaped += "\\u00" + QByteArray::number(static_cast<unsigned char>(c), 16).rightJustified(2, '0');
+            } else {
+                escaped += c;
+            }
+        }
+        return escaped;
+    }
+
+    void dumpAtExit() {
+        ADBTrace::dump(exitPath);
+    }
+}
+
+void ADBTrace::setEnabled(bool enabled) {
+    if(enabled) {
+        clock();
+        std::lock_guard lock{mutex};
+        events.reserve(capacity);
+    }
+    s_enabled.store(enabled, std::memory_order_relaxed);
+}
+
+void ADBTrace::enableFromEnvironment() {
+    static bool checked = false;
+    if(checked) {
+        return;
+    }
+    checked = true;
+
+    exitPath = qEnvironmentVariable("WAYDROID_FILES_TRACE");
+    if(!exitPath.isEmpty()) {
+        setEnabled(true);
+        qAddPostRoutine(dumpAtExit);
+    }
+}
+
+qint64 ADBTrace::now() {
+    return clock().nsecsElapsed();
+}
+
+void ADBTrace::record(const char* category, const char* name, const QString& detail, qint64 start, qint64 end, bool async) {
+    Event event{category, name, detail, start, end, reinterpret_cast<quint64>(QThread::currentThreadId()), async};
+
+    std::lock_guard lock{mutex};
+    if(events.size() < capacity) {
+        events.push_back(std::move(event));
+    } else {
+        events[next % capacity] = std::move(event);
+    }
+    next++;
+}
+
+bool ADBTrace::dump(const QString& path) {
+    std::vector<Event> snapshot{};
+    {
+        std::lock_guard lock{mutex};
+        snapshot = events;
+    }
+
+    QSaveFile file{path};
+    if(!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "Failed to write trace to" << path;
+        return false;
+    }
+
+    // Timestamps are in microseconds. Async spans become begin/end pairs with their own id, so overlapping
+    // coroutines on the main thread don't have to nest.
+    QByteArray pid = QByteArray::number(QCoreApplication::applicationPid());
+    file.write("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    quint64 id = 0;
+    bool first = true;
+    for(const Event& event : snapshot) {
+        QByteArray common = "\"cat\":\"" + QByteArray(event.category) + "\",\"name\":\"" + QByteArray(event.name) +
+            "\",\"pid\":" + pid + ",\"tid\":" + QByteArray::number(event.thread) +
+            ",\"args\":{\"detail\":\"" + escape(event.detail) + "\"}";
+        QByteArray start = QByteArray::number(event.start / 1000.0, 'f', 3);
+        QByteArray line{};
+        if(event.async) {
+            QByteArray idField = ",\"id\":" + QByteArray::number(++id);
+            line = "{\"ph\":\"b\",\"ts\":" + start + idField + "," + common + "},\n" +
+                "{\"ph\":\"e\",\"ts\":" + QByteArray::number(event.end / 1000.0, 'f', 3) + idField + "," + common + "}";
+        } else {
+            line = "{\"ph\":\"X\",\"ts\":" + start + ",\"dur\":" + QByteArray::number((event.end - event.start) / 1000.0, 'f', 3) + "," + common + "}";
+        }
+        file.write((first ? "" : ",\n") + line);
+        first = false;
+    }
+    file.write("\n]}\n");
+    return file.commit();
+}
@@ -0,0 +1,73 @@
+/*
+ * Copyright (C) 2025  JCM
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * waydroid-files is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ADB_TRACE_H
+#define ADB_TRACE_H
+
+#include <atomic>
+
+#include <QString>
+
+// Opt-in recording of timed spans into a fixed size ring buffer, written out as Chrome trace JSON
+// (chrome://tracing, ui.perfetto.dev). Enabled by setting WAYDROID_FILES_TRACE to the file to write at exit,
+// or with setEnabled and dump. While disabled a span costs one relaxed atomic load.
+class ADBTrace {
+public:
+    static bool enabled() { return s_enabled.load(std::memory_order_relaxed); }
+    static void setEnabled(bool enabled);
+    // reads WAYDROID_FILES_TRACE once and arranges for the dump at exit
+    static void enableFromEnvironment();
+
+    static qint64 now();
+    static void record(const char* category, const char* name, const QString& detail, qint64 start, qint64 end, bool async);
+    static bool dump(const QString& path);
+private:
+    static std::atomic<bool> s_enabled;
+};
+
+// Records the time between its construction and destruction. Async spans are meant for coroutines, which overlap
+// on the same thread, and get their own track. Everything else must nest properly within its thread.
+class ADBTraceSpan {
+public:
+    ADBTraceSpan(const char* category, const char* name, QString detail = {}, bool async = true)
+        : m_category(category), m_name(name), m_async(async) {
+        if(ADBTrace::enabled()) {
+            m_detail = std::move(detail);
+            m_start = ADBTrace::now();
+        }
+    }
+    ~ADBTraceSpan() {
+        if(m_start >= 0) {
+            ADBTrace::record(m_category, m_name, m_detail, m_start, ADBTrace::now(), m_async);
+        }
+    }
+    ADBTraceSpan(const ADBTraceSpan&) = delete;
+    ADBTraceSpan& operator=(const ADBTraceSpan&) = delete;
+
+    void setDetail(QString detail) {
+        if(m_start >= 0) {
+            m_detail = std::move(detail);
+        }
+    }
+private:
+    const char* m_category;
+    const char* m_name;
+    QString m_detail{};
+    qint64 m_start = -1;
+    bool m_async;
+};
+
+#endif
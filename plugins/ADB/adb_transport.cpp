@@ -0,0 +1,159 @@
+/*
+ * Copyright (C) 2025  JCM
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * waydroid-files is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "adb_transport.h"
+
+#include <expected>
+#include <optional>
+#include <variant>
+
+#include <QDebug>
+#include <QHostAddress>
+#include <QTcpSocket>
+
+#include <QCoro/QCoroAbstractSocket>
+#include <QCoro/QCoroIODevice>
+
+#include "adb_trace.h"
+
+enum class ADBProtolError {
+    InvalidStatus,
+    TruncatedPayload,
+};
+
+using ADBError = std::variant<QByteArray, ADBProtolError>;
+using ADBResult = std::expected<QByteArray, ADBError>;
+
+static QCoro::Task<std::expected<QByteArray, ADBError>> sendRequest(QTcpSocket& socket, const QByteArray& req) {
+    QByteArray r = QString::number(req.size(), 16).rightJustified(4, '0').toUtf8() + req;
+
+    auto co_socket = qCoro(socket);
+    co_await co_socket.write(r);
+
+    QByteArray status = co_await co_socket.read(4);
+    if(status != "OKAY" && status != "FAIL") {
+        co_return std::unexpected(ADBProtolError::InvalidStatus);
+    }
+
+    QByteArray len = co_await co_socket.read(4, std::chrono::milliseconds{1});
+    bool okay{};
+    int l = len.toInt(&okay, 16);
+    if(!okay) {
+        if(status == "FAIL") {
+            co_return std::unexpected(QByteArray(""));
+        }
+        co_return QByteArray{};
+    }
+
+    r = co_await co_socket.read(l);
+    if(r.size() != l) {
+        co_return std::unexpected(ADBProtolError::TruncatedPayload);
+    }
+
+    if(status == "FAIL") {
+        co_return std::unexpected(r);
+    }
+    co_return r;
+}
+
+static QCoro::Task<bool> openService(QTcpSocket& socket, const QByteArray& service) {
+    auto co_socket = qCoro(socket);
+
+    bool okay;
+    {
+        ADBTraceSpan span{"transport", "connect"};
+        okay = co_await co_socket.connectToHost(QHostAddress::LocalHost, 5037);
+    }
+    if(!okay) {
+        qWarning() << "Failed to connect to ADB server";
+        co_return false;
+    }
+
+    ADBTraceSpan span{"transport", "handshake", QString::fromUtf8(service)};
+
+    for(const QByteArray& req : {QByteArray("host:transport-any"), service}) {
+        // Unlike host requests, services only answer with a status, anything after it is already service data.
+        co_await co_socket.write(QString::number(req.size(), 16).rightJustified(4, '0').toUtf8() + req);
+
+        QByteArray status = co_await co_socket.read(4);
+        if(status == "FAIL") {
+            QByteArray len = co_await co_socket.read(4);
+            QByteArray msg = co_await co_socket.read(len.toInt(nullptr, 16));
+            qWarning() << "ADB error:" << QString::fromUtf8(msg);
+            co_return false;
+        } else if(status != "OKAY") {
+            qWarning() << "Protocol error, invalid status" << status;
+            co_return false;
+        }
+    }
+    co_return true;
+}
+
+QCoro::Task<std::unique_ptr<QIODevice>> ADBServerTransport::co_open(QByteArray service) {
+    auto socket = std::make_unique<QTcpSocket>();
+    if(!(co_await openService(*socket, service))) {
+        co_return nullptr;
+    }
+    co_return socket;
+}
+
+QCoro::Task<QString> ADBServerTransport::co_hostQuery(QByteArray request) {
+    ADBTraceSpan span{"transport", "host request", QString::fromUtf8(request)};
+    QTcpSocket socket;
+    auto co_socket = qCoro(socket);
+
+    bool okay = co_await co_socket.connectToHost(QHostAddress::LocalHost, 5037);
+    if(!okay) {
+        qDebug() << "Failed to connect to ADB server";
+        co_return QString();
+    }
+    auto res = co_await sendRequest(socket, request);
+    if(!res) {
+        co_return QString();
+    }
+    co_return QString::fromUtf8(*res);
+}
+
+QCoro::Task<QString> ADBServerTransport::co_state() {
+    co_return co_await co_hostQuery("host:get-state");
+}
+
+QCoro::Task<QString> ADBServerTransport::co_serial() {
+    co_return co_await co_hostQuery("host:get-serialno");
+}
+
+QCoro::Task<QByteArray> ADBStreamIO::read(qint64 maxSize, std::chrono::milliseconds timeout) {
+    // only reads that actually have to wait for the device are worth a span
+    std::optional<ADBTraceSpan> span{};
+    if(ADBTrace::enabled() && m_device.bytesAvailable() == 0) {
+        span.emplace("io", "socket wait");
+    }
+
+    if(auto* socket = qobject_cast<QAbstractSocket*>(&m_device)) {
+        co_return co_await qCoro(*socket).read(maxSize, timeout);
+    }
+
+    if(m_device.isOpen() && m_device.bytesAvailable() == 0 && !m_device.atEnd()) {
+        co_await qCoro(m_device).waitForReadyRead(static_cast<int>(timeout.count()));
+    }
+    co_return m_device.read(maxSize);
+}
+
+QCoro::Task<qint64> ADBStreamIO::write(const QByteArray& data) {
+    if(auto* socket = qobject_cast<QAbstractSocket*>(&m_device)) {
+        co_return co_await qCoro(*socket).write(data);
+    }
+    co_return co_await qCoro(m_device).write(data);
+}
@@ -0,0 +1,63 @@
+/*
+ * Copyright (C) 2025  JCM
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * waydroid-files is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ADB_TRANSPORT_H
+#define ADB_TRANSPORT_H
+
+#include <chrono>
+#include <memory>
+
+#include <QByteArray>
+#include <QIODevice>
+#include <QString>
+
+#include <QCoro/QCoroTask>
+
+// Opens service streams ("sync:", "shell:...") on the device. Whatever carries them, the result is a plain QIODevice.
+class ADBTransport {
+public:
+    virtual ~ADBTransport() = default;
+
+    virtual QCoro::Task<std::unique_ptr<QIODevice>> co_open(QByteArray service) = 0;
+    virtual QCoro::Task<QString> co_state() = 0;
+    virtual QCoro::Task<QString> co_serial() = 0;
+};
+
+// The usual way: through the adb server on localhost:5037, which forwards to whatever device it selects.
+class ADBServerTransport : public ADBTransport {
+public:
+    ADBServerTransport() = default;
+    ~ADBServerTransport() = default;
+
+    QCoro::Task<std::unique_ptr<QIODevice>> co_open(QByteArray service) override;
+    QCoro::Task<QString> co_state() override;
+    QCoro::Task<QString> co_serial() override;
+private:
+    QCoro::Task<QString> co_hostQuery(QByteArray request);
+};
+
+// Awaitable reads and writes that work the same on sockets and on other stream devices.
+class ADBStreamIO {
+public:
+    explicit ADBStreamIO(QIODevice& device) : m_device(device) {}
+
+    QCoro::Task<QByteArray> read(qint64 maxSize, std::chrono::milliseconds timeout = std::chrono::milliseconds{-1});
+    QCoro::Task<qint64> write(const QByteArray& data);
+private:
+    QIODevice& m_device;
+};
+
+#endif
@@ -20,12 +20,31 @@
 
 #include <QCoro/QCoroQml>
 
+#include "adb_archive_model.h"
 #include "adb_client.h"
+#include "adb_duplicate_model.h"
+#include "adb_file_types.h"
 #include "adb_folder_model.h"
+#include "adb_sync_engine.h"
+#include "adb_tar_transfer.h"
+#include "adb_thumbnail_provider.h"
 
 void ADBPlugin::registerTypes(const char *uri) {
     //@uri ADB
     qmlRegisterType<ADBClient>(uri, 1, 0, "ADBClient");
     qmlRegisterType<ADBFolderModel>(uri, 1, 0, "ADBFolderModel");
+    qmlRegisterType<ADBArchiveModel>(uri, 1, 0, "ADBArchiveModel");
+    qmlRegisterType<ADBDuplicateModel>(uri, 1, 0, "ADBDuplicateModel");
+    qmlRegisterType<ADBSyncEngine>(uri, 1, 0, "ADBSyncEngine");
+    qmlRegisterType<ADBTarTransfer>(uri, 1, 0, "ADBTarTransfer");
+    qmlRegisterSingletonType<ADBFileTypes>(uri, 1, 0, "ADBFileTypes", [](QQmlEngine*, QJSEngine*) -> QObject* {
+        return new ADBFileTypes;
+    });
     QCoro::Qml::registerTypes();
 }
+
+void ADBPlugin::initializeEngine(QQmlEngine *engine, const char *uri) {
+    Q_UNUSED(uri);
+    ADBThumbnailScheduler::instance(); // make sure it is created on the main thread
+    engine->addImageProvider("adbthumbnail", new ADBThumbnailProvider);
+}
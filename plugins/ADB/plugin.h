@@ -25,6 +25,7 @@ class ADBPlugin : public QQmlExtensionPlugin {
 
 public:
     void registerTypes(const char *uri);
+    void initializeEngine(QQmlEngine *engine, const char *uri);
 };
 
 #endif
@@ -0,0 +1,732 @@
+/*
+ * Copyright (C) 2025  JCM
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * waydroid-files is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "fake_adbd.h"
+
+#include <algorithm>
+#include <cstring>
+#include <deque>
+#include <map>
+#include <utility>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QProcess>
+#include <QRandomGenerator>
+#include <QTcpSocket>
+#include <QTimer>
+#include <QtEndian>
+
+namespace {
+    constexpr uint32_t AUTH_TOKEN = 1;
+    constexpr uint32_t AUTH_SIGNATURE = 2;
+    constexpr uint32_t AUTH_RSAPUBLICKEY = 3;
+
+    constexpr uint32_t version = 0x01000001;
+    // what an RSA 2048 signature takes
+    constexpr int signatureSize = 256;
+
+    struct [[gnu::packed]] amessage {
+        uint32_t command;
+        uint32_t arg0;
+        uint32_t arg1;
+        uint32_t data_length;
+        uint32_t data_check;
+        uint32_t magic;
+    };
+
+    uint32_t checksum(const QByteArray& payload) {
+        uint32_t sum = 0;
+        for(char c : payload) {
+            sum += static_cast<uint8_t>(c);
+        }
+        return sum;
+    }
+
+    QByteArray le32(uint32_t value) {
+        QByteArray bytes(4, '\0');
+        qToLittleEndian<quint32>(value, bytes.data());
+        return bytes;
+    }
+}
+
+// One device side stream. What it sends goes out as one WRTE at a time, the next only after the host's OKAY.
+class FakeAdbd::Stream {
+public:
+    Stream(Connection& connection, uint32_t localId, uint32_t remoteId) : m_connection(connection), m_localId(localId), m_remoteId(remoteId) {}
+    virtual ~Stream() = default;
+
+    virtual void start() {}
+    // the payload of a WRTE from the host
+    virtual void received(const QByteArray& data) = 0;
+
+    void acknowledged();
+    bool inFlight() const { return m_inFlight; }
+    uint32_t localId() const { return m_localId; }
+    uint32_t remoteId() const { return m_remoteId; }
+protected:
+    // Queues a unit for the host. Units are packed into WRTEs whole and only split if one alone is too large,
+    // so a sync header never straddles two writes.
+    void send(QByteArray data);
+    // once everything queued reached the host
+    void close();
+
+    Connection& m_connection;
+private:
+    void flush();
+
+    uint32_t m_localId;
+    uint32_t m_remoteId;
+    std::deque<QByteArray> m_out{};
+    bool m_inFlight = false;
+    bool m_closing = false;
+};
+
+class FakeAdbd::Connection {
+public:
+    Connection(FakeAdbd& adbd, QTcpSocket* socket);
+    ~Connection();
+
+    void sendMessage(uint32_t command, uint32_t arg0, uint32_t arg1, const QByteArray& payload = {});
+    uint32_t maxData() const { return std::min(m_hostMaxData, m_adbd.m_maxData); }
+    // sends CLSE, the stream is gone after the current event
+    void closeStream(uint32_t localId);
+    void releaseAcks();
+    void acceptKey();
+    void abort() { m_socket->abort(); }
+
+    FakeAdbd& m_adbd;
+private:
+    void readMessages();
+    void handleMessage(const Message& message);
+    void handleAuth(const Message& message);
+    void open(uint32_t remoteId, QByteArray service);
+    void acknowledge(uint32_t localId);
+    void dropStream(uint32_t localId);
+    void sendToken();
+    void sendConnect();
+
+    std::unique_ptr<QTcpSocket> m_socket;
+    QByteArray m_rx{};
+    bool m_connected = false;
+    bool m_keyOffered = false;
+    uint32_t m_hostMaxData = 4096;
+    uint32_t m_nextId = 1;
+    std::map<uint32_t, std::unique_ptr<Stream>> m_streams{};
+    std::vector<std::unique_ptr<Stream>> m_closed{};
+    // streams whose last write from the host has not been acknowledged yet
+    std::vector<uint32_t> m_unacknowledged{};
+};
+
+void FakeAdbd::Stream::send(QByteArray data) {
+    if(data.isEmpty() || m_closing) {
+        return;
+    }
+    m_out.push_back(std::move(data));
+    flush();
+}
+
+void FakeAdbd::Stream::close() {
+    m_closing = true;
+    if(!m_inFlight && m_out.empty()) {
+        m_connection.closeStream(m_localId);
+    }
+}
+
+void FakeAdbd::Stream::flush() {
+    if(m_inFlight || m_out.empty()) {
+        return;
+    }
+    qsizetype maxData = m_connection.maxData();
+    QByteArray chunk{};
+    while(!m_out.empty() && chunk.size() + m_out.front().size() <= maxData) {
+        chunk += m_out.front();
+        m_out.pop_front();
+    }
+    if(chunk.isEmpty()) {
+        chunk = m_out.front().left(maxData);
+        m_out.front().remove(0, maxData);
+    }
+    m_inFlight = true;
+    m_connection.m_adbd.m_bytesSent += chunk.size();
+    m_connection.sendMessage(A_WRTE, m_localId, m_remoteId, chunk);
+}
+
+void FakeAdbd::Stream::acknowledged() {
+    m_inFlight = false;
+    if(!m_out.empty()) {
+        flush();
+    } else if(m_closing) {
+        m_connection.closeStream(m_localId);
+    }
+}
+
+class FakeAdbd::EchoStream : public FakeAdbd::Stream {
+public:
+    using Stream::Stream;
+
+    void received(const QByteArray& data) override { send(data); }
+};
+
+class FakeAdbd::SourceStream : public FakeAdbd::Stream {
+public:
+    SourceStream(Connection& connection, uint32_t localId, uint32_t remoteId, qint64 size) : Stream(connection, localId, remoteId), m_size(size) {}
+
+    void start() override {
+        QByteArray data(static_cast<int>(m_size), '\0');
+        for(qint64 i = 0; i < m_size; i++) {
+            data[i] = static_cast<char>(i % 251);
+        }
+        send(data);
+        close();
+    }
+    void received(const QByteArray&) override {}
+private:
+    qint64 m_size;
+};
+
+// The sync protocol on the host's own filesystem, with lstat semantics like adbd.
+class FakeAdbd::SyncStream : public FakeAdbd::Stream {
+public:
+    using Stream::Stream;
+
+    void received(const QByteArray& data) override {
+        m_in += data;
+        process();
+    }
+private:
+    void process();
+    void handleList(const QByteArray& path);
+    void handleStat(const QByteArray& path);
+    void handleRecv(const QByteArray& path);
+    void handleSend(const QByteArray& argument);
+    void finishSend(uint32_t time);
+    void fail(const QByteArray& message) { send("FAIL" + le32(message.size()) + message); }
+
+    QByteArray m_in{};
+    bool m_sending = false;
+    // the file of the SEND in progress, null if it could not be opened
+    std::unique_ptr<QFile> m_file{};
+    QByteArray m_sendError{};
+    mode_t m_sendMode = 0644;
+};
+
+void FakeAdbd::SyncStream::process() {
+    while(m_in.size() >= 8) {
+        QByteArray id = m_in.left(4);
+        uint32_t length = qFromLittleEndian<quint32>(m_in.constData() + 4);
+        if(m_sending && id == "DONE") {
+            m_in.remove(0, 8);
+            finishSend(length);
+            continue;
+        }
+        if(m_sending != (id == "DATA") || length > 256 * 1024) {
+            fail("unexpected sync request " + id);
+            close();
+            return;
+        }
+        if(m_in.size() < 8 + static_cast<qsizetype>(length)) {
+            return;
+        }
+        QByteArray payload = m_in.mid(8, length);
+        m_in.remove(0, 8 + length);
+
+        if(id == "DATA") {
+            if(m_file && m_file->write(payload) != payload.size()) {
+                m_sendError = m_file->errorString().toUtf8();
+                m_file.reset();
+            }
+        } else if(id == "LIST") {
+            handleList(payload);
+        } else if(id == "STAT") {
+            handleStat(payload);
+        } else if(id == "RECV") {
+            handleRecv(payload);
+        } else if(id == "SEND") {
+            handleSend(payload);
+        } else if(id == "QUIT") {
+            close();
+            return;
+        } else {
+            fail("unknown sync request " + id);
+            close();
+            return;
+        }
+    }
+}
+
+void FakeAdbd::SyncStream::handleList(const QByteArray& path) {
+    // a folder that cannot be read is just empty, like on adbd
+    if(DIR* dir = opendir(path.constData())) {
+        while(dirent* entry = readdir(dir)) {
+            QByteArray name = entry->d_name;
+            struct stat st{};
+            if(lstat((path + '/' + name).constData(), &st) != 0) {
+                continue;
+            }
+            send("DENT" + le32(st.st_mode) + le32(st.st_size) + le32(st.st_mtime) + le32(name.size()) + name);
+        }
+        closedir(dir);
+    }
+    send("DONE" + QByteArray(16, '\0'));
+}
+
+void FakeAdbd::SyncStream::handleStat(const QByteArray& path) {
+    // all zero for a missing file
+    struct stat st{};
+    lstat(path.constData(), &st);
+    send("STAT" + le32(st.st_mode) + le32(st.st_size) + le32(st.st_mtime));
+}
+
+void FakeAdbd::SyncStream::handleRecv(const QByteArray& path) {
+    QFile file{QString::fromUtf8(path)};
+    if(!file.open(QIODevice::ReadOnly)) {
+        fail(file.errorString().toUtf8());
+        return;
+    }
+    while(!file.atEnd()) {
+        QByteArray chunk = file.read(64 * 1024);
+        if(chunk.isEmpty()) {
+            fail(file.errorString().toUtf8());
+            return;
+        }
+        send("DATA" + le32(chunk.size()) + chunk);
+    }
+    send("DONE" + le32(0));
+}
+
+void FakeAdbd::SyncStream::handleSend(const QByteArray& argument) {
+    // "path,mode" with the mode in octal
+    int comma = argument.lastIndexOf(',');
+    bool okay = comma > 0;
+    uint mode = okay ? argument.mid(comma + 1).toUInt(&okay, 8) : 0;
+    m_sending = true;
+    m_sendError.clear();
+    if(!okay) {
+        m_sendError = "invalid SEND argument " + argument;
+        return;
+    }
+    m_sendMode = mode & 07777;
+
+    // like adbd with fixed_push_mkdir, the folders on the way are created
+    QString path = QString::fromUtf8(argument.left(comma));
+    QDir().mkpath(QFileInfo(path).path());
+    m_file = std::make_unique<QFile>(path);
+    if(!m_file->open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        m_sendError = m_file->errorString().toUtf8();
+        m_file.reset();
+    }
+}
+
+void FakeAdbd::SyncStream::finishSend(uint32_t time) {
+    m_sending = false;
+    if(m_file) {
+        QByteArray path = QFile::encodeName(m_file->fileName());
+        m_file->close();
+        m_file.reset();
+        chmod(path.constData(), m_sendMode);
+        timespec times[2] = {{static_cast<time_t>(time), 0}, {static_cast<time_t>(time), 0}};
+        utimensat(AT_FDCWD, path.constData(), times, 0);
+    }
+    if(!m_sendError.isEmpty()) {
+        fail(m_sendError);
+        return;
+    }
+    send("OKAY" + le32(0));
+}
+
+// "shell:" with stdout and stderr merged, "shell,v2,...:" with the packet framing of shell protocol v2.
+// Without a command it is an interactive /bin/sh reading the host's input.
+class FakeAdbd::ShellStream : public FakeAdbd::Stream {
+public:
+    ShellStream(Connection& connection, uint32_t localId, uint32_t remoteId, QByteArray command, bool v2)
+        : Stream(connection, localId, remoteId), m_command(std::move(command)), m_v2(v2) {}
+    ~ShellStream() override {
+        m_process.disconnect();
+        if(m_process.state() != QProcess::NotRunning) {
+            m_process.kill();
+            m_process.waitForFinished(1000);
+        }
+    }
+
+    void start() override;
+    void received(const QByteArray& data) override;
+private:
+    enum PacketId : char {
+        Stdin = 0,
+        Stdout = 1,
+        Stderr = 2,
+        Exit = 3,
+        // from the host, the same id as Exit
+        CloseStdin = 3,
+    };
+
+    void packet(char id, const QByteArray& payload) {
+        QByteArray header(5, id);
+        qToLittleEndian<quint32>(static_cast<quint32>(payload.size()), header.data() + 1);
+        send(header + payload);
+    }
+    void forward(char id, const QByteArray& data) {
+        if(data.isEmpty()) {
+            return;
+        }
+        if(m_v2) {
+            packet(id, data);
+        } else {
+            send(data);
+        }
+    }
+
+    QByteArray m_command;
+    bool m_v2;
+    QProcess m_process{};
+    QByteArray m_in{};
+};
+
+void FakeAdbd::ShellStream::start() {
+    m_process.setProgram("/bin/sh");
+    if(!m_command.isEmpty()) {
+        m_process.setArguments({"-c", QString::fromUtf8(m_command)});
+    }
+    m_process.setProcessChannelMode(m_v2 ? QProcess::SeparateChannels : QProcess::MergedChannels);
+
+    QObject::connect(&m_process, &QProcess::readyReadStandardOutput, &m_process, [this]() {
+        forward(Stdout, m_process.readAllStandardOutput());
+    });
+    QObject::connect(&m_process, &QProcess::readyReadStandardError, &m_process, [this]() {
+        forward(Stderr, m_process.readAllStandardError());
+    });
+    QObject::connect(&m_process, QOverload<int, QProcess::ExitStatus>::of(&QProcess::finished), &m_process, [this](int exitCode, QProcess::ExitStatus) {
+        forward(Stdout, m_process.readAllStandardOutput());
+        forward(Stderr, m_process.readAllStandardError());
+        if(m_v2) {
+            packet(Exit, QByteArray(1, static_cast<char>(exitCode)));
+        }
+        close();
+    });
+    QObject::connect(&m_process, &QProcess::errorOccurred, &m_process, [this](QProcess::ProcessError error) {
+        if(error == QProcess::FailedToStart) {
+            qWarning() << "fake adbd: failed to start a shell:" << m_process.errorString();
+            close();
+        }
+    });
+    m_process.start();
+}
+
+void FakeAdbd::ShellStream::received(const QByteArray& data) {
+    if(!m_v2) {
+        m_process.write(data);
+        return;
+    }
+    m_in += data;
+    while(m_in.size() >= 5) {
+        uint32_t length = qFromLittleEndian<quint32>(m_in.constData() + 1);
+        if(m_in.size() < 5 + static_cast<qsizetype>(length)) {
+            return;
+        }
+        char id = m_in.at(0);
+        QByteArray payload = m_in.mid(5, length);
+        m_in.remove(0, 5 + length);
+        if(id == Stdin) {
+            m_process.write(payload);
+        } else if(id == CloseStdin) {
+            m_process.closeWriteChannel();
+        }
+        // window size changes do not matter without a pty
+    }
+}
+
+FakeAdbd::Connection::Connection(FakeAdbd& adbd, QTcpSocket* socket) : m_adbd(adbd), m_socket(socket) {
+    m_socket->setParent(nullptr);
+    QObject::connect(m_socket.get(), &QTcpSocket::readyRead, m_socket.get(), [this]() {
+        readMessages();
+    });
+    QObject::connect(m_socket.get(), &QTcpSocket::disconnected, &m_adbd, [this]() {
+        // the socket is still inside its signal, it goes once that returned
+        QTimer::singleShot(0, &m_adbd, [adbd = &m_adbd, connection = this]() {
+            adbd->removeConnection(connection);
+        });
+    });
+}
+
+FakeAdbd::Connection::~Connection() {
+    m_socket->disconnect();
+    m_streams.clear();
+    m_closed.clear();
+}
+
+void FakeAdbd::Connection::sendMessage(uint32_t command, uint32_t arg0, uint32_t arg1, const QByteArray& payload) {
+    amessage msg{command, arg0, arg1, static_cast<uint32_t>(payload.size()), checksum(payload), command ^ 0xffffffff};
+    m_socket->write(reinterpret_cast<const char*>(&msg), sizeof(msg));
+    if(!payload.isEmpty()) {
+        m_socket->write(payload);
+    }
+}
+
+void FakeAdbd::Connection::readMessages() {
+    m_rx += m_socket->readAll();
+    while(m_rx.size() >= static_cast<qsizetype>(sizeof(amessage))) {
+        amessage msg;
+        std::memcpy(&msg, m_rx.constData(), sizeof(msg));
+        if(msg.magic != (msg.command ^ 0xffffffff)) {
+            qWarning() << "fake adbd: invalid message from the host" << QString::number(msg.command, 16);
+            m_adbd.m_violations++;
+            m_socket->abort();
+            return;
+        }
+        if(m_rx.size() < static_cast<qsizetype>(sizeof(msg) + msg.data_length)) {
+            return;
+        }
+        Message message{msg.command, msg.arg0, msg.arg1, m_rx.mid(sizeof(msg), msg.data_length)};
+        m_rx.remove(0, sizeof(msg) + msg.data_length);
+        // newer hosts leave the checksum at zero
+        if(msg.data_check != 0 && msg.data_check != checksum(message.payload)) {
+            m_adbd.m_violations++;
+        }
+
+        m_adbd.m_received.push_back(message);
+        emit m_adbd.messageReceived(message.command);
+        handleMessage(message);
+    }
+}
+
+void FakeAdbd::Connection::handleMessage(const Message& message) {
+    switch(message.command) {
+        case A_CNXN:
+            m_hostMaxData = message.arg1;
+            if(m_adbd.m_auth == Auth::None) {
+                sendConnect();
+            } else {
+                sendToken();
+            }
+            break;
+        case A_AUTH:
+            handleAuth(message);
+            break;
+        case A_OPEN:
+            if(m_connected) {
+                QByteArray service = message.payload;
+                if(service.endsWith('\0')) {
+                    service.chop(1);
+                }
+                open(message.arg0, service);
+            }
+            break;
+        case A_WRTE: {
+            auto it = m_streams.find(message.arg1);
+            if(it == m_streams.end()) {
+                sendMessage(A_CLSE, 0, message.arg0);
+                break;
+            }
+            if(std::find(m_unacknowledged.begin(), m_unacknowledged.end(), message.arg1) != m_unacknowledged.end()) {
+                qWarning() << "fake adbd: the host wrote again before its last write was acknowledged";
+                m_adbd.m_violations++;
+            } else {
+                m_unacknowledged.push_back(message.arg1);
+            }
+            it->second->received(message.payload);
+            if(!m_adbd.m_holdAcks) {
+                acknowledge(message.arg1);
+            }
+            break;
+        }
+        case A_OKAY: {
+            auto it = m_streams.find(message.arg1);
+            if(it == m_streams.end()) {
+                break; // closed in the meantime
+            }
+            if(!it->second->inFlight()) {
+                qWarning() << "fake adbd: the host acknowledged a write that was never sent";
+                m_adbd.m_violations++;
+                break;
+            }
+            it->second->acknowledged();
+            break;
+        }
+        case A_CLSE:
+            dropStream(message.arg1);
+            break;
+        default:
+            qWarning() << "fake adbd: unknown message" << QString::number(message.command, 16);
+            m_adbd.m_violations++;
+            break;
+    }
+}
+
+void FakeAdbd::Connection::handleAuth(const Message& message) {
+    if(message.arg0 == AUTH_SIGNATURE) {
+        bool known = m_adbd.m_auth == Auth::Signature || m_adbd.m_keyAccepted;
+        if(known && message.payload.size() == signatureSize) {
+            sendConnect();
+        } else {
+            sendToken();
+        }
+    } else if(message.arg0 == AUTH_RSAPUBLICKEY) {
+        // the device now shows its prompt, acceptKey() taps allow
+        m_adbd.m_publicKey = message.payload.left(message.payload.indexOf('\0'));
+        m_keyOffered = true;
+        if(m_adbd.m_keyAccepted) {
+            sendConnect();
+        }
+    }
+}
+
+void FakeAdbd::Connection::open(uint32_t remoteId, QByteArray service) {
+    uint32_t localId = m_nextId++;
+    std::unique_ptr<Stream> stream{};
+    if(service == "echo:") {
+        stream = std::make_unique<EchoStream>(*this, localId, remoteId);
+    } else if(service.startsWith("source:")) {
+        bool okay = false;
+        qint64 size = service.mid(7).toLongLong(&okay);
+        if(okay && size >= 0) {
+            stream = std::make_unique<SourceStream>(*this, localId, remoteId, size);
+        }
+    } else if(service == "sync:") {
+        stream = std::make_unique<SyncStream>(*this, localId, remoteId);
+    } else if(service.startsWith("shell")) {
+        // "shell:cmd", "shell,v2,raw:cmd"
+        int colon = service.indexOf(':');
+        if(colon > 0) {
+            bool v2 = service.left(colon).split(',').contains("v2");
+            stream = std::make_unique<ShellStream>(*this, localId, remoteId, service.mid(colon + 1), v2);
+        }
+    }
+
+    if(!stream) {
+        sendMessage(A_CLSE, 0, remoteId);
+        return;
+    }
+    sendMessage(A_OKAY, localId, remoteId);
+    Stream* started = stream.get();
+    m_streams.emplace(localId, std::move(stream));
+    started->start();
+}
+
+void FakeAdbd::Connection::acknowledge(uint32_t localId) {
+    m_unacknowledged.erase(std::remove(m_unacknowledged.begin(), m_unacknowledged.end(), localId), m_unacknowledged.end());
+    auto it = m_streams.find(localId);
+    if(it != m_streams.end()) {
+        sendMessage(A_OKAY, localId, it->second->remoteId());
+    }
+}
+
+void FakeAdbd::Connection::releaseAcks() {
+    std::vector<uint32_t> held = std::exchange(m_unacknowledged, {});
+    for(uint32_t localId : held) {
+        acknowledge(localId);
+    }
+}
+
+void FakeAdbd::Connection::acceptKey() {
+    if(m_keyOffered && !m_connected) {
+        sendConnect();
+    }
+}
+
+void FakeAdbd::Connection::closeStream(uint32_t localId) {
+    auto it = m_streams.find(localId);
+    if(it != m_streams.end()) {
+        sendMessage(A_CLSE, localId, it->second->remoteId());
+        dropStream(localId);
+    }
+}
+
+void FakeAdbd::Connection::dropStream(uint32_t localId) {
+    auto it = m_streams.find(localId);
+    if(it == m_streams.end()) {
+        return;
+    }
+    // the stream may be the caller, or its process inside a signal
+    m_closed.push_back(std::move(it->second));
+    m_streams.erase(it);
+    m_unacknowledged.erase(std::remove(m_unacknowledged.begin(), m_unacknowledged.end(), localId), m_unacknowledged.end());
+    QTimer::singleShot(0, m_socket.get(), [this]() {
+        m_closed.clear();
+    });
+}
+
+void FakeAdbd::Connection::sendToken() {
+    QByteArray token(20, '\0');
+    for(char& c : token) {
+        c = static_cast<char>(QRandomGenerator::global()->bounded(256));
+    }
+    sendMessage(A_AUTH, AUTH_TOKEN, 0, token);
+}
+
+void FakeAdbd::Connection::sendConnect() {
+    m_connected = true;
+    sendMessage(A_CNXN, version, m_adbd.m_maxData, "device::ro.product.name=fake;ro.product.model=fake;ro.product.device=fake;features=shell_v2,cmd,fixed_push_mkdir");
+}
+
+FakeAdbd::FakeAdbd(QObject* parent) : QObject(parent) {
+    connect(&m_server, &QTcpServer::newConnection, this, [this]() {
+        while(QTcpSocket* socket = m_server.nextPendingConnection()) {
+            m_connections.push_back(std::make_unique<Connection>(*this, socket));
+        }
+    });
+}
+
+FakeAdbd::~FakeAdbd() {
+    m_connections.clear();
+}
+
+bool FakeAdbd::listen(quint16 port) {
+    if(!m_server.listen(QHostAddress::LocalHost, port)) {
+        qWarning() << "fake adbd: cannot listen:" << m_server.errorString();
+        return false;
+    }
+    return true;
+}
+
+void FakeAdbd::releaseAcks() {
+    for(auto& connection : m_connections) {
+        connection->releaseAcks();
+    }
+}
+
+void FakeAdbd::acceptKey() {
+    m_keyAccepted = true;
+    for(auto& connection : m_connections) {
+        connection->acceptKey();
+    }
+}
+
+void FakeAdbd::disconnectAll() {
+    for(auto& connection : m_connections) {
+        connection->abort();
+    }
+}
+
+int FakeAdbd::count(uint32_t command) const {
+    return static_cast<int>(std::count_if(m_received.begin(), m_received.end(), [command](const Message& message) {
+        return message.command == command;
+    }));
+}
+
+void FakeAdbd::removeConnection(Connection* connection) {
+    auto it = std::find_if(m_connections.begin(), m_connections.end(), [connection](const auto& c) {
+        return c.get() == connection;
+    });
+    if(it != m_connections.end()) {
+        m_connections.erase(it);
+    }
+}
@@ -0,0 +1,109 @@
+/*
+ * Copyright (C) 2025  JCM
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * waydroid-files is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FAKE_ADBD_H
+#define FAKE_ADBD_H
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include <QByteArray>
+#include <QObject>
+#include <QTcpServer>
+
+// The device end of the adbd wire protocol, for tests. The "device" is the machine the tests run on: sync: works on
+// its filesystem and the shell services run /bin/sh, so device paths in a test are just paths below a temporary folder.
+// Besides those it offers "echo:", which sends back what it gets, and "source:<bytes>", which sends a known pattern
+// and closes, to look at flow control from both ends.
+class FakeAdbd : public QObject {
+    Q_OBJECT
+
+public:
+    enum class Auth {
+        None,
+        // any signature of the right size is accepted, the fake does not check it
+        Signature,
+        // signatures are refused until acceptKey(), like a device that does not know the host's key yet
+        PublicKey,
+    };
+
+    struct Message {
+        uint32_t command;
+        uint32_t arg0;
+        uint32_t arg1;
+        QByteArray payload;
+    };
+
+    static constexpr uint32_t A_CNXN = 0x4e584e43;
+    static constexpr uint32_t A_AUTH = 0x48545541;
+    static constexpr uint32_t A_OPEN = 0x4e45504f;
+    static constexpr uint32_t A_OKAY = 0x59414b4f;
+    static constexpr uint32_t A_CLSE = 0x45534c43;
+    static constexpr uint32_t A_WRTE = 0x45545257;
+
+    FakeAdbd(QObject* parent = nullptr);
+    ~FakeAdbd();
+
+    // on localhost only, port 0 picks a free one
+    bool listen(quint16 port = 0);
+    quint16 port() const { return m_server.serverPort(); }
+
+    void setAuth(Auth auth) { m_auth = auth; }
+    // the largest payload the device takes, announced in its CNXN
+    void setMaxData(uint32_t maxData) { m_maxData = maxData; }
+    // keeps the OKAYs for the host's writes back until releaseAcks()
+    void setHoldAcks(bool hold) { m_holdAcks = hold; }
+    void releaseAcks();
+    // answers the authorization prompt for the key the host offered, later connections can sign with it
+    void acceptKey();
+    // drops every connection, as if the device went away
+    void disconnectAll();
+
+    // everything the host sent, in order
+    const std::vector<Message>& received() const { return m_received; }
+    int count(uint32_t command) const;
+    // the key the host offered last
+    QByteArray publicKey() const { return m_publicKey; }
+    // payload bytes sent to the host in WRTE messages
+    qint64 bytesSent() const { return m_bytesSent; }
+    // host writes before the previous one was acknowledged, and acknowledgements for writes never sent
+    int violations() const { return m_violations; }
+signals:
+    void messageReceived(uint32_t command);
+private:
+    class Connection;
+    class Stream;
+    class EchoStream;
+    class SourceStream;
+    class SyncStream;
+    class ShellStream;
+
+    void removeConnection(Connection* connection);
+
+    QTcpServer m_server{};
+    Auth m_auth = Auth::None;
+    uint32_t m_maxData = 256 * 1024;
+    bool m_holdAcks = false;
+    std::vector<std::unique_ptr<Connection>> m_connections{};
+    std::vector<Message> m_received{};
+    QByteArray m_publicKey{};
+    bool m_keyAccepted = false;
+    qint64 m_bytesSent = 0;
+    int m_violations = 0;
+};
+
+#endif
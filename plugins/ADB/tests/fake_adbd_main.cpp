@@ -0,0 +1,67 @@
+/*
+ * Copyright (C) 2025  JCM
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * waydroid-files is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <cstdio>
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDebug>
+
+#include "fake_adbd.h"
+
+// Serves this machine as an adbd device on localhost, to try the direct transport, the CLI or the FUSE mount
+// without a phone. Prints the port once it listens, scripts read it from the first line.
+int main(int argc, char** argv) {
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("fake-adbd");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("A fake adbd that serves this machine's filesystem and shell as the device.");
+    parser.addHelpOption();
+    parser.addOptions({
+        {"port", "Port to listen on, 0 picks a free one.", "port", "0"},
+        {"auth", "Authentication the device asks for: none, signature or key.", "auth", "none"},
+        {"max-data", "Largest payload the device takes.", "bytes", "262144"},
+    });
+    parser.process(app);
+
+    FakeAdbd adbd{};
+    QString auth = parser.value("auth");
+    if(auth == "signature") {
+        adbd.setAuth(FakeAdbd::Auth::Signature);
+    } else if(auth == "key") {
+        // nobody is there to tap allow, every offered key is accepted
+        adbd.setAuth(FakeAdbd::Auth::PublicKey);
+        adbd.acceptKey();
+    } else if(auth != "none") {
+        qWarning() << "Invalid authentication" << auth;
+        return 1;
+    }
+    bool okay = false;
+    uint maxData = parser.value("max-data").toUInt(&okay);
+    if(!okay || maxData == 0) {
+        qWarning() << "Invalid maximum payload" << parser.value("max-data");
+        return 1;
+    }
+    adbd.setMaxData(maxData);
+
+    if(!adbd.listen(parser.value("port").toUShort())) {
+        return 1;
+    }
+    std::printf("%u\n", adbd.port());
+    std::fflush(stdout);
+
+    return app.exec();
+}
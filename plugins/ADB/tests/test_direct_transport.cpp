@@ -0,0 +1,328 @@
+/*
+ * Copyright (C) 2025  JCM
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * waydroid-files is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <algorithm>
+#include <chrono>
+#include <memory>
+
+#include <sys/stat.h>
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QStandardPaths>
+#include <QTemporaryDir>
+#include <QtTest>
+
+#include <QCoro/QCoroTask>
+
+#include "adb_client.h"
+#include "adb_direct_transport.h"
+#include "fake_adbd.h"
+
+// bytes the host keeps unread before it stops acknowledging, ADBDirectStream::maxBuffered
+static constexpr qint64 maxBuffered = 1024 * 1024;
+
+static QByteArray pattern(qint64 size) {
+    QByteArray data(static_cast<int>(size), '\0');
+    for(qint64 i = 0; i < size; i++) {
+        data[i] = static_cast<char>(i % 251);
+    }
+    return data;
+}
+
+// until length bytes arrived or the stream ended
+static QCoro::Task<QByteArray> co_read(QIODevice& device, qint64 length) {
+    ADBStreamIO io{device};
+    QByteArray data{};
+    while(data.size() < length) {
+        QByteArray chunk = co_await io.read(length - data.size(), std::chrono::seconds{5});
+        if(chunk.isEmpty()) {
+            break;
+        }
+        data += chunk;
+    }
+    co_return data;
+}
+
+static QByteArray readExactly(QIODevice& device, qint64 length) {
+    return QCoro::waitFor(co_read(device, length));
+}
+
+static bool writeFile(const QString& path, const QByteArray& data) {
+    QFile file{path};
+    return file.open(QIODevice::WriteOnly) && file.write(data) == data.size();
+}
+
+static QByteArray readFile(const QString& path) {
+    QFile file{path};
+    return file.open(QIODevice::ReadOnly) ? file.readAll() : QByteArray{};
+}
+
+// The direct transport against FakeAdbd: handshake, authentication, flow control both ways and closing streams.
+class TestDirectTransport : public QObject {
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void init();
+    void cleanup();
+
+    void handshake();
+    void refusedService();
+    void signatureAuth();
+    void publicKeyAuth();
+    void hostToDeviceFlowControl();
+    void deviceToHostFlowControl();
+    void deviceClosesStream();
+    void hostClosesStream();
+    void connectionLost();
+    void clientOverSync();
+private:
+    std::unique_ptr<ADBDirectTransport> makeTransport() const {
+        return std::make_unique<ADBDirectTransport>("127.0.0.1", m_adbd->port());
+    }
+    std::unique_ptr<QIODevice> open(ADBDirectTransport& transport, const QByteArray& service) const {
+        return QCoro::waitFor(transport.co_open(service));
+    }
+
+    QTemporaryDir m_home{};
+    std::unique_ptr<FakeAdbd> m_adbd{};
+};
+
+void TestDirectTransport::initTestCase() {
+    QVERIFY(m_home.isValid());
+    // a throwaway key instead of ~/.android/adbkey
+    qputenv("HOME", QFile::encodeName(m_home.path()));
+    QStandardPaths::setTestModeEnabled(true);
+}
+
+void TestDirectTransport::init() {
+    m_adbd = std::make_unique<FakeAdbd>();
+    QVERIFY(m_adbd->listen());
+}
+
+void TestDirectTransport::cleanup() {
+    QCOMPARE(m_adbd->violations(), 0);
+    m_adbd.reset();
+}
+
+void TestDirectTransport::handshake() {
+    auto transport = makeTransport();
+    QCOMPARE(QCoro::waitFor(transport->co_state()), QStringLiteral("device"));
+    QCOMPARE(QCoro::waitFor(transport->co_serial()), QStringLiteral("127.0.0.1:%1").arg(m_adbd->port()));
+
+    QVERIFY(!m_adbd->received().empty());
+    const FakeAdbd::Message& connect = m_adbd->received().front();
+    QCOMPARE(connect.command, FakeAdbd::A_CNXN);
+    QCOMPARE(connect.arg0, 0x01000001u);
+    QVERIFY(connect.payload.startsWith("host::"));
+    QCOMPARE(m_adbd->count(FakeAdbd::A_AUTH), 0);
+
+    // the connection is kept
+    QCOMPARE(QCoro::waitFor(transport->co_state()), QStringLiteral("device"));
+    QCOMPARE(m_adbd->count(FakeAdbd::A_CNXN), 1);
+}
+
+void TestDirectTransport::refusedService() {
+    auto transport = makeTransport();
+    QVERIFY(!open(*transport, "nosuchservice:"));
+
+    // the connection stays usable
+    auto stream = open(*transport, "echo:");
+    QVERIFY(stream);
+    stream->write("ping");
+    QCOMPARE(readExactly(*stream, 4), QByteArray("ping"));
+}
+
+void TestDirectTransport::signatureAuth() {
+#ifndef ADB_WITH_OPENSSL
+    QSKIP("Built without OpenSSL, the host cannot sign");
+#endif
+    m_adbd->setAuth(FakeAdbd::Auth::Signature);
+    auto transport = makeTransport();
+    QCOMPARE(QCoro::waitFor(transport->co_state()), QStringLiteral("device"));
+
+    QCOMPARE(m_adbd->count(FakeAdbd::A_AUTH), 1);
+    auto auth = std::find_if(m_adbd->received().begin(), m_adbd->received().end(), [](const FakeAdbd::Message& message) {
+        return message.command == FakeAdbd::A_AUTH;
+    });
+    QCOMPARE(auth->arg0, 2u); // SIGNATURE
+    QCOMPARE(auth->payload.size(), 256);
+}
+
+void TestDirectTransport::publicKeyAuth() {
+#ifndef ADB_WITH_OPENSSL
+    QSKIP("Built without OpenSSL, the host has no key to offer");
+#endif
+    m_adbd->setAuth(FakeAdbd::Auth::PublicKey);
+    auto transport = makeTransport();
+
+    // the signature is refused, the key is offered and the device waits for its user
+    QCOMPARE(QCoro::waitFor(transport->co_state()), QStringLiteral("unauthorized"));
+    QCOMPARE(m_adbd->count(FakeAdbd::A_AUTH), 2);
+    QVERIFY(!m_adbd->publicKey().isEmpty());
+
+    // once accepted, the waiting connection goes on
+    m_adbd->acceptKey();
+    QCOMPARE(QCoro::waitFor(transport->co_state()), QStringLiteral("device"));
+
+    // and a new one gets in with the signature alone
+    auto second = makeTransport();
+    QCOMPARE(QCoro::waitFor(second->co_state()), QStringLiteral("device"));
+    QCOMPARE(m_adbd->count(FakeAdbd::A_AUTH), 3);
+}
+
+void TestDirectTransport::hostToDeviceFlowControl() {
+    m_adbd->setMaxData(4096);
+    auto transport = makeTransport();
+    auto stream = open(*transport, "echo:");
+    QVERIFY(stream);
+
+    m_adbd->setHoldAcks(true);
+    QByteArray data = pattern(10000);
+    QCOMPARE(stream->write(data), qint64{data.size()});
+
+    // one write of at most the device's payload size, then nothing until it is acknowledged
+    QTRY_COMPARE(m_adbd->count(FakeAdbd::A_WRTE), 1);
+    auto write = std::find_if(m_adbd->received().begin(), m_adbd->received().end(), [](const FakeAdbd::Message& message) {
+        return message.command == FakeAdbd::A_WRTE;
+    });
+    QCOMPARE(write->payload.size(), 4096);
+    QTest::qWait(100);
+    QCOMPARE(m_adbd->count(FakeAdbd::A_WRTE), 1);
+    QCOMPARE(stream->bytesToWrite(), qint64{data.size()});
+
+    m_adbd->releaseAcks();
+    QTRY_COMPARE(m_adbd->count(FakeAdbd::A_WRTE), 2);
+
+    m_adbd->setHoldAcks(false);
+    m_adbd->releaseAcks();
+    QCOMPARE(readExactly(*stream, data.size()), data);
+    QTRY_COMPARE(stream->bytesToWrite(), qint64{0});
+    QCOMPARE(m_adbd->count(FakeAdbd::A_WRTE), 3);
+}
+
+void TestDirectTransport::deviceToHostFlowControl() {
+    constexpr qint64 maxData = 64 * 1024;
+    constexpr qint64 size = 4 * 1024 * 1024;
+    m_adbd->setMaxData(maxData);
+    auto transport = makeTransport();
+    auto stream = open(*transport, "source:" + QByteArray::number(size));
+    QVERIFY(stream);
+
+    // nothing is read, so the host stops acknowledging once enough is waiting
+    QTRY_VERIFY(m_adbd->bytesSent() >= maxBuffered);
+    QTest::qWait(200);
+    QVERIFY(m_adbd->bytesSent() <= maxBuffered + maxData);
+    QVERIFY(!stream->atEnd());
+
+    // reading lets the rest through, intact
+    QCOMPARE(readExactly(*stream, size), pattern(size));
+    QTRY_VERIFY(stream->atEnd());
+    QCOMPARE(m_adbd->bytesSent(), size);
+}
+
+void TestDirectTransport::deviceClosesStream() {
+    auto transport = makeTransport();
+    auto stream = open(*transport, "source:1000");
+    QVERIFY(stream);
+
+    QCOMPARE(readExactly(*stream, 2000), pattern(1000));
+    QTRY_VERIFY(stream->atEnd());
+    QCOMPARE(stream->write("late"), qint64{-1});
+
+    // the host does not answer a close with another one
+    stream.reset();
+    QTest::qWait(50);
+    QCOMPARE(m_adbd->count(FakeAdbd::A_CLSE), 0);
+}
+
+void TestDirectTransport::hostClosesStream() {
+    auto transport = makeTransport();
+    auto stream = open(*transport, "echo:");
+    QVERIFY(stream);
+
+    stream.reset();
+    QTRY_COMPARE(m_adbd->count(FakeAdbd::A_CLSE), 1);
+
+    // other streams on the connection are not affected
+    auto next = open(*transport, "echo:");
+    QVERIFY(next);
+    next->write("pong");
+    QCOMPARE(readExactly(*next, 4), QByteArray("pong"));
+    QCOMPARE(m_adbd->count(FakeAdbd::A_CNXN), 1);
+}
+
+void TestDirectTransport::connectionLost() {
+    auto transport = makeTransport();
+    auto stream = open(*transport, "echo:");
+    QVERIFY(stream);
+
+    m_adbd->disconnectAll();
+    QTRY_VERIFY(stream->atEnd());
+    QCOMPARE(stream->write("gone"), qint64{-1});
+
+    // the next request connects again
+    auto next = open(*transport, "echo:");
+    QVERIFY(next);
+    QCOMPARE(m_adbd->count(FakeAdbd::A_CNXN), 2);
+}
+
+void TestDirectTransport::clientOverSync() {
+    QTemporaryDir device{};
+    QVERIFY(device.isValid());
+    QVERIFY(writeFile(device.filePath("hello.txt"), "hello"));
+    QVERIFY(QDir(device.path()).mkdir("folder"));
+
+    ADBClient client{};
+    client.setDirectAddress(QStringLiteral("127.0.0.1:%1").arg(m_adbd->port()));
+
+    QStringList names{};
+    for(const ADBFileEntry& entry : QCoro::waitFor(client.co_listFiles(device.path()))) {
+        names.append(entry.fileName);
+    }
+    QVERIFY(names.contains("hello.txt"));
+    QVERIFY(names.contains("folder"));
+
+    auto entry = QCoro::waitFor(client.co_stat(device.filePath("hello.txt")));
+    QVERIFY(entry);
+    QVERIFY(S_ISREG(entry->mode));
+    QCOMPARE(entry->size, 5u);
+
+    // larger than one DATA packet and one WRTE
+    QByteArray data = pattern(300 * 1000);
+    QString upload = m_home.filePath("upload.bin");
+    QVERIFY(writeFile(upload, data));
+    QVERIFY(QCoro::waitFor(client.co_pushFile(upload, device.filePath("folder/upload.bin"))));
+    QCOMPARE(readFile(device.filePath("folder/upload.bin")), data);
+
+    QString download = m_home.filePath("download.bin");
+    QVERIFY(QCoro::waitFor(client.co_pullFileTo(device.filePath("folder/upload.bin"), download)));
+    QCOMPARE(readFile(download), data);
+
+    auto output = QCoro::waitFor(client.co_shell("echo hello"));
+    QVERIFY(output);
+    QCOMPARE(*output, QByteArray("hello\n"));
+
+    // through the shell v2 session
+    ADBFileOperationResult made = QCoro::waitFor(client.co_makeDirectory(device.filePath("made")));
+    QVERIFY2(made.ok, qPrintable(made.error));
+    QVERIFY(QFileInfo(device.filePath("made")).isDir());
+}
+
+QTEST_GUILESS_MAIN(TestDirectTransport)
+
+#include "test_direct_transport.moc"
@@ -0,0 +1,107 @@
+#!/bin/sh
+# Mounts fake-adbd's "device" with waydroid-files-fuse and works on it with plain tools, then checks what arrived
+# on the device side. Exits with 77, reported as skipped, where this machine cannot mount FUSE filesystems.
+#
+# Usage: test_fuse_mount.sh <fake-adbd> <waydroid-files-fuse>
+set -eu
+
+fake_adbd=$1
+fuse=$2
+
+if [ ! -c /dev/fuse ] || ! command -v fusermount3 > /dev/null; then
+    echo "FUSE is not available, skipping"
+    exit 77
+fi
+
+work=$(mktemp -d)
+device=$work/device
+mnt=$work/mnt
+adbd_pid=
+fuse_pid=
+
+mounted() {
+    awk -v m="$mnt" '$5 == m { found = 1 } END { exit !found }' /proc/self/mountinfo
+}
+
+cleanup() {
+    if mounted; then
+        fusermount3 -u "$mnt" || true
+    fi
+    if [ -n "$fuse_pid" ]; then
+        wait "$fuse_pid" 2> /dev/null || true
+    fi
+    if [ -n "$adbd_pid" ]; then
+        kill "$adbd_pid" 2> /dev/null || true
+    fi
+    rm -rf "$work"
+}
+trap cleanup EXIT
+
+fail() {
+    echo "FAIL: $*" >&2
+    exit 1
+}
+
+mkdir -p "$device/folder/nested" "$mnt"
+printf 'hello\n' > "$device/hello.txt"
+printf 'deep\n' > "$device/folder/nested/deep.txt"
+
+"$fake_adbd" > "$work/port" &
+adbd_pid=$!
+tries=0
+while [ ! -s "$work/port" ]; do
+    tries=$((tries + 1))
+    [ "$tries" -le 50 ] || fail "fake-adbd did not start"
+    sleep 0.1
+done
+port=$(head -n 1 "$work/port")
+
+"$fuse" --adbd "127.0.0.1:$port" --root "$device" "$mnt" 2> "$work/fuse.log" &
+fuse_pid=$!
+tries=0
+until mounted; do
+    if ! kill -0 "$fuse_pid" 2> /dev/null; then
+        cat "$work/fuse.log" >&2
+        # not allowed to mount here, e.g. in a container
+        if grep -q "^fuse\|fusermount3" "$work/fuse.log"; then
+            fuse_pid=
+            exit 77
+        fi
+        fail "waydroid-files-fuse ended before mounting"
+    fi
+    tries=$((tries + 1))
+    [ "$tries" -le 100 ] || fail "the mount did not appear"
+    sleep 0.1
+done
+
+# readdir and getattr on every folder
+ls -R "$mnt" > "$work/listing"
+grep -qx 'hello.txt' "$work/listing" || fail "hello.txt missing from ls -R"
+grep -qx 'deep.txt' "$work/listing" || fail "folder/nested/deep.txt missing from ls -R"
+
+# whole files and a range in the middle
+[ "$(cat "$mnt/hello.txt")" = hello ] || fail "hello.txt reads back wrong"
+[ "$(cat "$mnt/folder/nested/deep.txt")" = deep ] || fail "deep.txt reads back wrong"
+[ "$(dd if="$mnt/hello.txt" bs=1 skip=2 count=2 2> /dev/null)" = ll ] || fail "reading at an offset"
+
+# a new file larger than one transfer chunk, and an existing one overwritten
+head -c 300000 /dev/urandom > "$work/random"
+cp "$work/random" "$mnt/folder/random.bin"
+cmp -s "$work/random" "$device/folder/random.bin" || fail "the new file did not reach the device intact"
+cmp -s "$work/random" "$mnt/folder/random.bin" || fail "the new file reads back wrong"
+printf 'changed\n' > "$mnt/hello.txt"
+[ "$(cat "$device/hello.txt")" = changed ] || fail "the overwrite did not reach the device"
+[ "$(cat "$mnt/hello.txt")" = changed ] || fail "the overwritten file reads back wrong"
+
+# file management through the shell
+mkdir "$mnt/made"
+[ -d "$device/made" ] || fail "mkdir did not reach the device"
+mv "$mnt/folder/random.bin" "$mnt/made/moved.bin"
+cmp -s "$work/random" "$device/made/moved.bin" || fail "rename did not reach the device"
+rm "$mnt/made/moved.bin"
+[ ! -e "$device/made/moved.bin" ] || fail "unlink did not reach the device"
+if ls "$mnt/made" | grep -q moved; then
+    fail "the removed file is still listed"
+fi
+
+echo "PASS"
@@ -44,23 +44,55 @@ MainView {
 
         onDeviceFound: {
             console.log("Connected to ADB server")
+            StartupTimer.mark("device-found")
 
-            loader.item.text = i18n.tr("Locating home folder...")
-            client.findFirstAccessibleFolder(["/sdcard", "/storage/emulated/0", "/home/phablet", "/"]).then(function(path) {
-                console.log("Found accessible folder: " + path)
-                loader.item.text = i18n.tr("Opening folder %1...").arg(path)
-                model.goTo(path).then(function() {
-                    console.log("Loaded initial folder")
-                    loader.sourceComponent = folderListView
+            client.serial().then(function(serial) {
+                if(serial !== "" && serial === model.deviceSerial && model.homePath !== "") {
+                    // the snapshot belongs to this device, so it is already on screen and only needs refreshing
+                    model.goTo(model.currentPath).then(function() {
+                        console.log("Refreshed folder from last session")
+                        StartupTimer.mark("snapshot-refreshed")
+                    })
+                    return
+                }
+                model.deviceSerial = serial
+
+                setLoadingText(i18n.tr("Locating home folder..."))
+                client.findFirstAccessibleFolder(["/sdcard", "/storage/emulated/0", "/home/phablet", "/"]).then(function(path) {
+                    console.log("Found accessible folder: " + path)
+                    StartupTimer.mark("home-located")
+                    model.homePath = path
+                    setLoadingText(i18n.tr("Opening folder %1...").arg(path))
+                    model.goTo(path).then(function() {
+                        console.log("Loaded initial folder")
+                        StartupTimer.mark("first-listing")
+                        loader.sourceComponent = folderListView
+                    })
                 })
             })
         }
     }
 
+    function setLoadingText(text) {
+        if(loader.sourceComponent === loadingIndicator) {
+            loader.item.text = text
+        }
+    }
+
+    Component.onCompleted: {
+        StartupTimer.mark("qml-loaded")
+        if(model.restoreSnapshot()) {
+            console.log("Showing folder from last session")
+            loader.sourceComponent = folderListView
+            StartupTimer.mark("snapshot-shown")
+        }
+    }
+
     ADBFolderModel {
         id: model
         adbClient: client
         basePath: "/"
+        watching: true
     }
 
     function startTransfer(activeTransfer, importMode) {
@@ -80,10 +112,13 @@ MainView {
     }
     function exportFile(path) {
         console.log("Exporting file", path)
+        var pulledUrl = null
         root.activeTransfer.stateChanged.connect(function() {
             console.log("export transfer state changed: " + root.activeTransfer.state);
             if(root.activeTransfer.state === ContentTransfer.Finalized || root.activeTransfer.state === ContentTransfer.Aborted) {
-                client.cleanupPulledFiles();
+                if(pulledUrl) {
+                    client.releasePulledFile(pulledUrl);
+                }
 
                 finishTransfer()
             }
@@ -95,6 +130,7 @@ MainView {
                 return;
             }
             console.log("Pulled file to " + url);
+            pulledUrl = url;
             root.activeTransfer.items = [ resultComponent.createObject(root, {"url": url}) ];
             root.activeTransfer.state = ContentTransfer.Charged;
         })
@@ -102,13 +138,19 @@ MainView {
     function exportFileSnap(path) {
         console.log("Exporting file", path, "in snap mode")
 
-        client.pullFile(path).then(function(url) {
-            if(!url) {
-                console.log("Pull failed, aborting transfer");
+        SnapHelper.chooseSaveFile(path.split("/").pop()).then(function(hostPath) {
+            if(!hostPath) {
+                console.log("No destination chosen");
                 return;
             }
-            console.log("Pulled file to " + url);
-            SnapHelper.saveFileDialog(url, true)
+            client.pullFileTo(path, hostPath).then(function(success) {
+                if(!success) {
+                    console.log("Pull failed");
+                    return;
+                }
+                console.log("Pulled file to " + hostPath);
+                SnapHelper.showFile(hostPath)
+            })
         })
     }
 
@@ -233,6 +275,16 @@ MainView {
             iconName: "add"
             text: i18n.tr("Upload new file")
         }
+        Action {
+            id: actionSync
+            iconName: "sync"
+            text: i18n.tr("Synchronise folder")
+        }
+        Action {
+            id: actionDuplicates
+            iconName: "edit-copy"
+            text: i18n.tr("Find duplicates")
+        }
     }
 
     Component {
@@ -248,7 +300,12 @@ MainView {
                     return
                 }
 
-                if(mode === "normal") {
+                if(mode === "normal" && /\.(zip|apk|jar|aar|epub|cbz)$/i.test(path)) {
+                    pageStack.push(Qt.resolvedUrl("views/ArchiveView.qml"), {
+                        adbClient: client,
+                        devicePath: path
+                    })
+                } else if(mode === "normal") {
                     pageStack.push(Qt.resolvedUrl("content-hub/FileOpener.qml"), {
                         adbClient: client,
                         devicePath: path,
@@ -268,6 +325,22 @@ MainView {
                 pageStack.push(folderListPage)
             }
 
+            Connections {
+                target: actionSync
+                onTriggered: pageStack.push(Qt.resolvedUrl("views/SyncView.qml"), {
+                    adbClient: client,
+                    devicePath: model.currentPath
+                })
+            }
+
+            Connections {
+                target: actionDuplicates
+                onTriggered: pageStack.push(Qt.resolvedUrl("views/DuplicatesView.qml"), {
+                    adbClient: client,
+                    devicePath: model.currentPath
+                })
+            }
+
             Page {
                 id: folderListPage
                 visible: false
@@ -277,7 +350,7 @@ MainView {
                     folderModel: model
 
                     leadingActionBar.actions: [ actionGoForward, actionGoBack ]
-                    trailingActionBar.actions: root.mode === "normal" ? [actionUploadFile, actionCreateFolder] : [actionCancel, actionSelect, actionCreateFolder]
+                    trailingActionBar.actions: root.mode === "normal" ? [actionUploadFile, actionCreateFolder, actionSync, actionDuplicates] : [actionCancel, actionSelect, actionCreateFolder]
                 }
 
                 FolderListView {
@@ -29,6 +29,16 @@ Page {
     header: PageHeader {
         id: header
         title: i18n.tr("Open with")
+
+        // streams from the device instead of pulling the whole file before anything can play
+        trailingActionBar.actions: [
+            Action {
+                iconName: "media-playback-start"
+                text: i18n.tr("Play")
+                visible: peerPicker.contentType === ContentType.Videos || peerPicker.contentType === ContentType.Music
+                onTriggered: Qt.openUrlExternally(adbClient.streamUrl(root.devicePath))
+            }
+        ]
     }
 
     property var activeTransfer
@@ -40,6 +50,7 @@ Page {
     property bool cleanup: false
 
     property bool transferInProgress: false
+    property url pulledUrl
 
     Component.onCompleted: {
         var contentType = Resolver.resolveContentType(devicePath)
@@ -81,6 +92,7 @@ Page {
                             return;
                         }
                         console.log("Pulled file to " + url);
+                        root.pulledUrl = url;
                         root.activeTransfer.items = [ resultComponent.createObject(root, {"url": url}) ];
                         root.activeTransfer.state = ContentTransfer.Charged;
 
@@ -88,7 +100,9 @@ Page {
                     })
                 }
                 if(root.activeTransfer.state === ContentTransfer.Finalized || root.activeTransfer.state === ContentTransfer.Aborted) {
-                    adbClient.cleanupPulledFiles();
+                    if(root.cleanup && root.pulledUrl.toString() !== "") {
+                        adbClient.releasePulledFile(root.pulledUrl);
+                    }
                     pageStack.pop();
                 }
             })
@@ -0,0 +1,130 @@
+/*
+ * Copyright (C) 2025  JCM
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * waydroid-files is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+import QtQuick 2.7
+import Lomiri.Components 1.3
+
+import ADB 1.0
+
+import "../components"
+
+Page {
+    id: archivePage
+
+    property string devicePath
+    property ADBClient adbClient
+
+    property bool loading: true
+    property bool failed: false
+
+    header: PageHeader {
+        id: header
+        title: archivePage.devicePath.split("/").pop()
+        subtitle: archiveModel.folder
+
+        leadingActionBar.actions: [
+            Action {
+                iconName: "back"
+                text: i18n.tr("Back")
+                onTriggered: {
+                    if(archiveModel.folder === "") {
+                        pageStack.pop()
+                    } else {
+                        var parts = archiveModel.folder.split("/").filter(Boolean)
+                        parts.pop()
+                        archiveModel.folder = parts.join("/")
+                    }
+                }
+            }
+        ]
+        trailingActionBar.actions: [
+            Action {
+                iconName: "external-link"
+                text: i18n.tr("Open with")
+                onTriggered: pageStack.push(Qt.resolvedUrl("../content-hub/FileOpener.qml"), {
+                    adbClient: archivePage.adbClient,
+                    devicePath: archivePage.devicePath,
+                    share: false,
+                    cleanup: true
+                })
+            }
+        ]
+    }
+
+    ADBArchiveModel {
+        id: archiveModel
+        adbClient: archivePage.adbClient
+        path: archivePage.devicePath
+    }
+
+    Component.onCompleted: {
+        archiveModel.load().then(function(success) {
+            archivePage.loading = false
+            archivePage.failed = !success
+        })
+    }
+
+    ActivityIndicator {
+        anchors.centerIn: parent
+        running: archivePage.loading
+    }
+
+    Label {
+        anchors.centerIn: parent
+        visible: archivePage.failed
+        text: i18n.tr("Could not read archive")
+    }
+
+    ScrollView {
+        anchors {
+            top: header.bottom
+            left: parent.left
+            right: parent.right
+            bottom: parent.bottom
+        }
+
+        ListView {
+            anchors.fill: parent
+            model: archiveModel
+
+            delegate: ListItem {
+                height: layout.height
+
+                ListItemLayout {
+                    id: layout
+                    title.text: model.fileName
+                    subtitle.text: model.isBrowsable ? "" : i18n.tr("%1, compressed %2").arg(model.fileSize).arg(model.compressedSize)
+
+                    Icon {
+                        SlotsLayout.position: SlotsLayout.Leading
+                        width: units.gu(4)
+                        height: width
+                        name: model.isBrowsable ? "folder" : "text-x-generic"
+                    }
+
+                    ProgressionSlot {
+                        visible: model.isBrowsable
+                    }
+                }
+
+                onClicked: {
+                    if(model.isBrowsable) {
+                        archiveModel.folder = model.filePath
+                    }
+                }
+            }
+        }
+    }
+}
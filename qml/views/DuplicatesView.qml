@@ -0,0 +1,190 @@
+/*
+ * Copyright (C) 2025  JCM
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * waydroid-files is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+import QtQuick 2.7
+import QtQuick.Layouts 1.3
+import Lomiri.Components 1.3
+import Lomiri.Components.Popups 1.3
+
+import ADB 1.0
+
+Page {
+    id: duplicatesPage
+
+    property ADBClient adbClient
+    property string devicePath
+
+    property bool scanned: false
+
+    header: PageHeader {
+        id: header
+        title: i18n.tr("Duplicate files")
+        subtitle: duplicatesPage.devicePath
+
+        leadingActionBar.actions: [
+            Action {
+                iconName: "back"
+                text: i18n.tr("Back")
+                enabled: !duplicateModel.running
+                onTriggered: pageStack.pop()
+            }
+        ]
+        trailingActionBar.actions: [
+            Action {
+                iconName: "delete"
+                text: i18n.tr("Delete selected")
+                enabled: !duplicateModel.running && duplicateModel.selectionCount > 0
+                onTriggered: PopupUtils.open(confirmDialog)
+            },
+            Action {
+                iconName: "reload"
+                text: i18n.tr("Search again")
+                enabled: !duplicateModel.running
+                onTriggered: scan()
+            }
+        ]
+    }
+
+    ADBDuplicateModel {
+        id: duplicateModel
+        adbClient: duplicatesPage.adbClient
+        path: duplicatesPage.devicePath
+    }
+
+    function scan() {
+        statusLabel.text = ""
+        duplicateModel.scan().then(function(success) {
+            duplicatesPage.scanned = true
+            if(!success) {
+                statusLabel.text = i18n.tr("Could not list the folder")
+            }
+        })
+    }
+
+    Component.onCompleted: scan()
+
+    Component {
+        id: confirmDialog
+
+        Dialog {
+            id: dialog
+            title: i18n.tr("Delete %1 files?").arg(duplicateModel.selectionCount)
+            text: i18n.tr("This frees %1 on the device and can not be undone.").arg(duplicateModel.selectedSize)
+
+            Button {
+                text: i18n.tr("Delete")
+                color: theme.palette.normal.negative
+                onClicked: {
+                    PopupUtils.close(dialog)
+                    duplicateModel.removeSelected().then(function(result) {
+                        statusLabel.text = result.failed && result.failed.length > 0
+                            ? i18n.tr("%1 files could not be deleted").arg(result.failed.length) : ""
+                    })
+                }
+            }
+            Button {
+                text: i18n.tr("Cancel")
+                onClicked: PopupUtils.close(dialog)
+            }
+        }
+    }
+
+    ColumnLayout {
+        id: status
+        anchors {
+            top: header.bottom
+            left: parent.left
+            right: parent.right
+            margins: units.gu(2)
+        }
+        spacing: units.gu(1)
+
+        Label {
+            Layout.fillWidth: true
+            wrapMode: Text.Wrap
+            text: {
+                switch(duplicateModel.stage) {
+                    case ADBDuplicateModel.Listing:
+                        return i18n.tr("Listing files…")
+                    case ADBDuplicateModel.Prefiltering:
+                        return i18n.tr("Comparing the start and end of large files…")
+                    case ADBDuplicateModel.Hashing:
+                        return i18n.tr("Comparing contents…")
+                    default:
+                        return duplicatesPage.scanned
+                            ? i18n.tr("%1 groups of duplicates, %2 selected to delete").arg(duplicateModel.groupCount).arg(duplicateModel.selectedSize)
+                            : ""
+                }
+            }
+        }
+
+        ProgressBar {
+            Layout.fillWidth: true
+            visible: duplicateModel.running
+            indeterminate: duplicateModel.total === 0
+            minimumValue: 0
+            maximumValue: Math.max(duplicateModel.total, 1)
+            value: duplicateModel.done
+        }
+
+        Label {
+            id: statusLabel
+            Layout.fillWidth: true
+            visible: text !== ""
+            wrapMode: Text.Wrap
+        }
+    }
+
+    ScrollView {
+        anchors {
+            top: status.bottom
+            topMargin: units.gu(1)
+            left: parent.left
+            right: parent.right
+            bottom: parent.bottom
+        }
+
+        ListView {
+            anchors.fill: parent
+            model: duplicateModel
+
+            section.property: "group"
+            section.delegate: ListItem {
+                height: units.gu(1)
+                divider.visible: false
+            }
+
+            delegate: ListItem {
+                height: layout.height
+
+                ListItemLayout {
+                    id: layout
+                    title.text: model.fileName
+                    subtitle.text: model.folder
+                    summary.text: model.fileSize + ", " + Qt.formatDateTime(model.modified)
+
+                    CheckBox {
+                        SlotsLayout.position: SlotsLayout.Leading
+                        checked: model.isSelected
+                        enabled: !duplicateModel.running
+                        onClicked: duplicateModel.setSelected(index, checked)
+                    }
+                }
+
+                onClicked: duplicateModel.setSelected(index, !model.isSelected)
+            }
+        }
+    }
+}
@@ -80,7 +80,7 @@ ListItem {
                 sourceSize: Qt.size(image.width, image.height)
                 visible: status == Image.Ready
 
-                source: del.isImage || del.isVideo ? "image://thumbnailer/file://" + delegate.path : ""
+                source: del.isImage || del.isVideo ? "image://adbthumbnail/" + encodeURIComponent(del.path) : ""
                 fillMode: Image.PreserveAspectFit
                 asynchronous: true
             }
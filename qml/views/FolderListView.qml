@@ -39,6 +39,19 @@ ScrollView {
         model: folderModel
         boundsBehavior: Flickable.DragOverBounds
 
+        // Thumbnails of the rows on screen are fetched before those of rows that already scrolled past
+        function updateVisibleRange() {
+            folderModel.setVisibleRange(root.indexAt(0, root.contentY), root.indexAt(0, root.contentY + root.height - 1))
+        }
+        onContentYChanged: visibleRangeTimer.restart()
+        onCountChanged: visibleRangeTimer.restart()
+
+        Timer {
+            id: visibleRangeTimer
+            interval: 50
+            onTriggered: root.updateVisibleRange()
+        }
+
         PullToRefresh {
             onRefresh: {
                 refreshing = true
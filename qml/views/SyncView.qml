@@ -0,0 +1,149 @@
+/*
+ * Copyright (C) 2025  JCM
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * waydroid-files is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+import QtQuick 2.7
+import QtQuick.Layouts 1.3
+import Lomiri.Components 1.3
+
+import ADB 1.0
+
+Page {
+    id: syncPage
+
+    property ADBClient adbClient
+    property string devicePath
+
+    header: PageHeader {
+        id: header
+        title: i18n.tr("Synchronise folder")
+
+        leadingActionBar.actions: [
+            Action {
+                iconName: "back"
+                text: i18n.tr("Back")
+                enabled: !engine.running
+                onTriggered: pageStack.pop()
+            }
+        ]
+    }
+
+    ADBSyncEngine {
+        id: engine
+        adbClient: syncPage.adbClient
+        devicePath: deviceField.text
+        hostPath: hostField.text
+        conflictPolicy: [ADBSyncEngine.ReportConflicts, ADBSyncEngine.PreferHost, ADBSyncEngine.PreferDevice, ADBSyncEngine.PreferNewer][policySelector.selectedIndex]
+        propagateDeletions: deletionsSwitch.checked
+    }
+
+    function describe(result) {
+        var count = function(key) { return result[key] ? result[key].length : 0 }
+        return i18n.tr("%1 pushed, %2 pulled, %3 deleted, %4 conflicts, %5 failed")
+            .arg(count("pushed")).arg(count("pulled"))
+            .arg(count("deletedOnHost") + count("deletedOnDevice"))
+            .arg(count("conflicts")).arg(count("failed"))
+    }
+
+    Flickable {
+        anchors {
+            top: header.bottom
+            left: parent.left
+            right: parent.right
+            bottom: parent.bottom
+            margins: units.gu(2)
+        }
+        contentHeight: column.height
+
+        ColumnLayout {
+            id: column
+            width: parent.width
+            spacing: units.gu(1)
+
+            Label {
+                text: i18n.tr("Folder on the device")
+            }
+            TextField {
+                id: deviceField
+                Layout.fillWidth: true
+                text: syncPage.devicePath
+                enabled: !engine.running
+            }
+
+            Label {
+                text: i18n.tr("Folder on this computer")
+            }
+            TextField {
+                id: hostField
+                Layout.fillWidth: true
+                placeholderText: "/home/phablet/Documents"
+                enabled: !engine.running
+            }
+
+            OptionSelector {
+                id: policySelector
+                Layout.fillWidth: true
+                text: i18n.tr("When both sides changed")
+                enabled: !engine.running
+                model: [
+                    i18n.tr("Report the conflict"),
+                    i18n.tr("Keep this computer's version"),
+                    i18n.tr("Keep the device's version"),
+                    i18n.tr("Keep the newer version")
+                ]
+            }
+
+            RowLayout {
+                Layout.fillWidth: true
+                Label {
+                    Layout.fillWidth: true
+                    text: i18n.tr("Apply deletions to the other side")
+                }
+                Switch {
+                    id: deletionsSwitch
+                    checked: true
+                    enabled: !engine.running
+                }
+            }
+
+            Button {
+                Layout.fillWidth: true
+                text: i18n.tr("Synchronise")
+                color: theme.palette.normal.positive
+                enabled: !engine.running && hostField.text !== "" && deviceField.text !== ""
+                onClicked: {
+                    resultLabel.text = ""
+                    engine.sync().then(function(result) {
+                        resultLabel.text = Object.keys(result).length === 0 ? i18n.tr("Synchronisation failed") : describe(result)
+                    })
+                }
+            }
+
+            ProgressBar {
+                Layout.fillWidth: true
+                visible: engine.running
+                indeterminate: engine.total === 0
+                minimumValue: 0
+                maximumValue: Math.max(engine.total, 1)
+                value: engine.done
+            }
+
+            Label {
+                id: resultLabel
+                Layout.fillWidth: true
+                wrapMode: Text.Wrap
+            }
+        }
+    }
+}
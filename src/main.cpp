@@ -23,15 +23,19 @@
 
 #include "patharrowbackground.h"
 #include "snaphelper.h"
+#include "startuptimer.h"
 
 int main(int argc, char *argv[])
 {
+    StartupTimer::start();
+
     QGuiApplication *app = new QGuiApplication(argc, (char**)argv);
     app->setApplicationName("waydroid-files.jcm");
 
     qDebug() << "Starting app from main.cpp";
 
     qmlRegisterType<PathArrowBackground>("waydroidfiles.jcm", 1, 0, "PathArrowBackground");
+    qmlRegisterSingletonType<StartupTimer>("waydroidfiles.jcm", 1, 0, "StartupTimer", [](QQmlEngine *engine, QJSEngine *scriptEngine) -> QObject* {return new StartupTimer;});
     qmlRegisterSingletonType<SnapHelper>("waydroidfiles.jcm", 1, 0, "SnapHelper", [](QQmlEngine *engine, QJSEngine *scriptEngine) -> QObject* {return new SnapHelper;});
 
     QQuickView *view = new QQuickView();
@@ -1,46 +1,76 @@
 #include "patharrowbackground.h"
 
-#include <QPainter>
-#include <QBrush>
+#include <algorithm>
+
+#include <QSGGeometryNode>
+#include <QSGVertexColorMaterial>
+
+namespace {
+    // notch on the left (two triangles), body, point on the right
+    constexpr int vertexCount = 5 * 3;
+}
 
 PathArrowBackground::PathArrowBackground(QQuickItem *parent)
-    : QQuickPaintedItem(parent)
+    : QQuickItem(parent)
     , m_color(Qt::white)
     , m_arrowWidth(16)
 {
+    setFlag(ItemHasContents, true);
+
     connect(this, SIGNAL(colorChanged()), this, SLOT(update()));
     connect(this, SIGNAL(arrowWidthChanged()), this, SLOT(update()));
 }
 
-void PathArrowBackground::paint(QPainter *painter)
+void PathArrowBackground::geometryChanged(const QRectF &newGeometry, const QRectF &oldGeometry)
 {
-    QBrush brush(m_color);
+    QQuickItem::geometryChanged(newGeometry, oldGeometry);
+    if (newGeometry.size() != oldGeometry.size())
+        update();
+}
 
-    painter->setBrush(brush);
-    painter->setPen(Qt::NoPen);
-    painter->setRenderHint(QPainter::Antialiasing);
+QSGNode *PathArrowBackground::updatePaintNode(QSGNode *oldNode, UpdatePaintNodeData *)
+{
+    if (width() <= 0 || height() <= 0) {
+        delete oldNode;
+        return nullptr;
+    }
 
-    const QPointF topLeftPoints[3] = {
-        QPointF(boundingRect().left() - 1, 0),
-        QPointF(boundingRect().left() + m_arrowWidth, 0),
-        QPointF(boundingRect().left() + m_arrowWidth, boundingRect().top() + boundingRect().height() * 0.5)
-    };
+    QSGGeometryNode *node = static_cast<QSGGeometryNode *>(oldNode);
+    if (!node) {
+        node = new QSGGeometryNode;
+        QSGGeometry *geometry = new QSGGeometry(QSGGeometry::defaultAttributes_ColoredPoint2D(), vertexCount);
+        geometry->setDrawingMode(QSGGeometry::DrawTriangles);
+        node->setGeometry(geometry);
+        node->setFlag(QSGNode::OwnsGeometry);
+        node->setMaterial(new QSGVertexColorMaterial);
+        node->setFlag(QSGNode::OwnsMaterial);
+    }
 
-    const QPointF bottomLeftPoints[3] = {
-        QPointF(boundingRect().left() - 1, boundingRect().bottom()),
-        QPointF(boundingRect().left() + m_arrowWidth, boundingRect().bottom()),
-        QPointF(boundingRect().left() + m_arrowWidth, boundingRect().top() + boundingRect().height() * 0.5)
-    };
+    const float w = width();
+    const float h = height();
+    const float a = std::min<float>(m_arrowWidth, w / 2);
+    const float middle = h / 2;
+
+    // the material expects premultiplied colours
+    const QColor c = m_color.toRgb();
+    const uchar alpha = c.alpha();
+    const uchar r = c.red() * alpha / 255;
+    const uchar g = c.green() * alpha / 255;
+    const uchar b = c.blue() * alpha / 255;
 
-    const QPointF rightPoints[3] = {
-        QPointF(boundingRect().right() - m_arrowWidth - 1, 0),
-        QPointF(boundingRect().right(), boundingRect().top() + boundingRect().height() * 0.5),
-        QPointF(boundingRect().right() - m_arrowWidth - 1, boundingRect().bottom()),
+    // neighbouring triangles share their edges exactly, so no seams show between them
+    const QPointF points[vertexCount] = {
+        {0, 0}, {a, 0}, {a, middle},
+        {0, h}, {a, h}, {a, middle},
+        {a, 0}, {w - a, 0}, {w - a, h},
+        {a, 0}, {w - a, h}, {a, h},
+        {w - a, 0}, {w, middle}, {w - a, h},
     };
 
-    painter->drawConvexPolygon(topLeftPoints, 3);
-    painter->drawConvexPolygon(bottomLeftPoints, 3);
-    painter->drawConvexPolygon(rightPoints, 3);
+    QSGGeometry::ColoredPoint2D *vertices = node->geometry()->vertexDataAsColoredPoint2D();
+    for (int i = 0; i < vertexCount; ++i)
+        vertices[i].set(points[i].x(), points[i].y(), r, g, b, alpha);
+    node->markDirty(QSGNode::DirtyGeometry);
 
-    painter->drawRect(m_arrowWidth, 0, boundingRect().width() - m_arrowWidth * 2, boundingRect().height());
+    return node;
 }
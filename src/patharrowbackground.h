@@ -1,9 +1,12 @@
 #ifndef PATHARROWBACKGROUND_H
 #define PATHARROWBACKGROUND_H
 
-#include <QQuickPaintedItem>
+#include <QColor>
+#include <QQuickItem>
 
-class PathArrowBackground : public QQuickPaintedItem
+// Breadcrumb segment shape, drawn as a handful of vertex coloured triangles instead of a painted texture.
+// Since the colour is part of the vertices, all segments share one material and the renderer batches them.
+class PathArrowBackground : public QQuickItem
 {
     Q_OBJECT
     Q_PROPERTY(QColor color MEMBER m_color NOTIFY colorChanged)
@@ -17,7 +20,8 @@ Q_SIGNALS:
     void arrowWidthChanged();
 
 protected:
-    void paint(QPainter *painter) override;
+    QSGNode *updatePaintNode(QSGNode *oldNode, UpdatePaintNodeData *data) override;
+    void geometryChanged(const QRectF &newGeometry, const QRectF &oldGeometry) override;
 
 private:
     QColor m_color;
@@ -21,7 +21,7 @@ bool SnapHelper::isSnap() const {
     return std::getenv("SNAP") != nullptr;
 }
 
-QCoro::Task<bool> SnapHelper::co_saveFileDialog(QUrl file, bool show) {
+QCoro::Task<QString> SnapHelper::co_chooseSaveFile(QString name) {
     QDBusInterface fileChooser("org.freedesktop.portal.Desktop",
                          "/org/freedesktop/portal/desktop",
                           "org.freedesktop.portal.FileChooser",
@@ -29,7 +29,7 @@ QCoro::Task<bool> SnapHelper::co_saveFileDialog(QUrl file, bool show) {
 
     auto co_reply = qCoro(fileChooser.asyncCall("SaveFile",
         "", "Save File", QVariantMap{
-            {"current_name", file.fileName().split('/').last()}
+            {"current_name", name}
         }));
     QDBusReply<QDBusObjectPath> reply = co_await co_reply.waitForFinished();
     QDBusObjectPath requestPath = reply.value();
@@ -43,38 +43,27 @@ QCoro::Task<bool> SnapHelper::co_saveFileDialog(QUrl file, bool show) {
 
     auto [response, results] = co_await qCoro(&proxy, &ResponseProxy::signal);
     if(response != 0) {
-        co_return false;
+        co_return QString();
     }
     if(!results.contains("uris") || results["uris"].toStringList().isEmpty()) {
         qWarning() << "No uris returned from file save dialog";
-        co_return false;
+        co_return QString();
     }
 
     QString savedUrlStr = results["uris"].toStringList().first();
     QString savedFile = QUrl{savedUrlStr}.toLocalFile();
     if(savedFile.isEmpty()) {
         qWarning() << "Failed to get saved file path from" << savedUrlStr;
-        co_return false;
-    }
-    if(QFile::exists(savedFile)) {
-        if(!QFile::remove(savedFile)) {
-            qWarning() << "Failed to remove existing file" << savedFile;
-            co_return false;
-        }
-    }
-    if(!QFile::rename(file.toLocalFile(), savedFile)) {
-        qWarning() << "Failed to move" << file.toLocalFile() << "to" << savedFile;
-        co_return false;
-    }
-
-    if(!show) {
-        co_return true;
+        co_return QString();
     }
+    co_return savedFile;
+}
 
-    int fd = open(savedFile.toLocal8Bit().data(), O_RDONLY);
+bool SnapHelper::showFile(QString path) {
+    int fd = open(path.toLocal8Bit().data(), O_RDONLY);
     if(fd == -1) {
-        qWarning() << "Failed to open saved file descriptor for" << savedFile;
-        co_return false;
+        qWarning() << "Failed to open saved file descriptor for" << path;
+        return false;
     }
     QDBusInterface openURI("org.freedesktop.portal.Desktop",
                            "/org/freedesktop/portal/desktop",
@@ -83,5 +72,5 @@ QCoro::Task<bool> SnapHelper::co_saveFileDialog(QUrl file, bool show) {
     openURI.asyncCall("OpenDirectory", "", QVariant::fromValue(QDBusUnixFileDescriptor{fd}), QVariantMap{});
     close(fd);
 
-    co_return true;
+    return true;
 }
@@ -33,10 +33,11 @@ public:
 
     Q_PROPERTY(bool isSnap READ isSnap CONSTANT)
 
-    QCoro::Task<bool> co_saveFileDialog(QUrl file, bool show);
-    Q_INVOKABLE QCoro::QmlTask saveFileDialog(QUrl file, bool show) {
-        return co_saveFileDialog(file, show);
+    QCoro::Task<QString> co_chooseSaveFile(QString name);
+    Q_INVOKABLE QCoro::QmlTask chooseSaveFile(QString name) {
+        return co_chooseSaveFile(name);
     }
+    Q_INVOKABLE bool showFile(QString path);
 
     bool isSnap() const;
 };
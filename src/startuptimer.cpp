@@ -0,0 +1,19 @@
+#include "startuptimer.h"
+
+#include <QDebug>
+
+QElapsedTimer StartupTimer::s_timer;
+qint64 StartupTimer::s_lastMark = 0;
+
+void StartupTimer::start() {
+    s_timer.start();
+}
+
+void StartupTimer::mark(const QString& phase) {
+    if(!s_timer.isValid()) {
+        return;
+    }
+    qint64 now = s_timer.elapsed();
+    qInfo().nospace() << "Startup phase " << phase << " reached after " << now << " ms (+" << (now - s_lastMark) << " ms)";
+    s_lastMark = now;
+}
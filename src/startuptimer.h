@@ -0,0 +1,25 @@
+#ifndef STARTUPTIMER_H
+#define STARTUPTIMER_H
+
+#include <QElapsedTimer>
+#include <QObject>
+
+// Logs how long each startup phase took, measured from the start of main().
+class StartupTimer : public QObject
+{
+    Q_OBJECT
+
+public:
+    StartupTimer() = default;
+    ~StartupTimer() = default;
+
+    static void start();
+
+    Q_INVOKABLE void mark(const QString& phase);
+
+private:
+    static QElapsedTimer s_timer;
+    static qint64 s_lastMark;
+};
+
+#endif // STARTUPTIMER_H